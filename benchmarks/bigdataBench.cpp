@@ -0,0 +1,301 @@
+#include <benchmark/benchmark.h>
+#include <bits/stdc++.h>
+#include "../common/corpus.h"
+#include "../common/file_chunks.h"
+#include "../common/tokenizer.h"
+#include "../common/word_table.h"
+#include "../common/work_pool.h"
+#include "../invertedIndex/dictionary.h"
+#include "../invertedIndex/query.h"
+#include "../invertedIndex/ranking.h"
+#include "../invertedIndex/search.h"
+#include "../invertedIndex/segment.h"
+using namespace std;
+
+// Micro and macro benchmarks over fixed synthetic corpora (common/corpus.h
+// with fixed seeds), so numbers are comparable across commits. Run with
+//   bigdataBench --benchmark_out=results.json --benchmark_out_format=json
+// or `cmake --build <dir> --target bench`. Throughput is reported as
+// bytes_per_second; query benchmarks add p50_us and p99_us counters, and
+// BM_Tokenize reports the heap allocations the tokenizer makes per pass.
+
+// Heap allocations of the calling thread, counted by the operator new in
+// countAllocations.cpp (linked into this binary only)
+extern thread_local uint64_t thread_allocations;
+
+namespace {
+
+constexpr uint64_t kSeed = 42;
+constexpr size_t kVocabulary = 50000;
+constexpr size_t kCorpusBytes = 16 << 20;
+constexpr size_t kNumDocs = 64;
+
+const vector<string>& vocabulary() {
+    static const vector<string> words = synthetic_vocabulary(kVocabulary, kSeed);
+    return words;
+}
+
+const string& corpus() {
+    static const string text = random_text(kCorpusBytes, vocabulary(), kSeed + 1);
+    return text;
+}
+
+// The corpus split into kNumDocs documents at word boundaries
+const vector<string_view>& documents() {
+    static const vector<string_view> docs = [] {
+        vector<string_view> out;
+        string_view text = corpus();
+        size_t begin = 0;
+        for (size_t d = 1; d <= kNumDocs; ++d) {
+            size_t end = d == kNumDocs ? text.size() : text.size() * d / kNumDocs;
+            while (end < text.size() && !tok::is_space(text[end])) ++end;
+            out.push_back(text.substr(begin, end - begin));
+            begin = end;
+        }
+        return out;
+    }();
+    return docs;
+}
+
+const vector<string>& tokens() {
+    static const vector<string> out = [] {
+        vector<string> words;
+        tok::Tokenizer tokenizer;
+        tokenizer.for_each_word(corpus(), [&](string_view w) { words.emplace_back(w); });
+        return words;
+    }();
+    return out;
+}
+
+struct Posting {
+    uint32_t docId;
+    uint32_t frequency;
+    vector<uint64_t> positions;
+};
+
+using PositionalIndex = unordered_map<string, vector<Posting>>;
+
+// Positional index of documents() plus the token count of each document
+const PositionalIndex& positionalIndex(vector<uint32_t>* docLengths = nullptr) {
+    static vector<uint32_t> lengths;
+    static const PositionalIndex index = [] {
+        PositionalIndex out;
+        tok::Tokenizer tokenizer;
+        for (uint32_t d = 0; d < documents().size(); ++d) {
+            uint64_t position = 0;
+            tokenizer.for_each_word(documents()[d], [&](string_view w) {
+                auto& postings = out[string(w)];
+                if (postings.empty() || postings.back().docId != d) postings.push_back({d, 0, {}});
+                postings.back().frequency++;
+                postings.back().positions.push_back(position++);
+            });
+            lengths.push_back(uint32_t(position));
+        }
+        return out;
+    }();
+    if (docLengths) *docLengths = lengths;
+    return index;
+}
+
+string tempPath(const string& name) {
+    return (filesystem::temp_directory_path() / ("bigdataBench_" + name)).string();
+}
+
+// Segment of positionalIndex(), written once per process
+const segment::SegmentReader& segmentReader() {
+    static segment::SegmentReader reader;
+    static bool opened = [] {
+        vector<uint32_t> lengths;
+        const PositionalIndex& index = positionalIndex(&lengths);
+        string path = tempPath("query.seg");
+        return segment::writeSegment(path, index, lengths) && reader.open(path);
+    }();
+    if (!opened) throw runtime_error("could not write the query segment");
+    return reader;
+}
+
+// Two-term queries; one term in four is drawn from the 100 most common words
+// so some lists are long
+vector<vector<string>> queryTerms(size_t n) {
+    mt19937_64 gen(kSeed + 2);
+    uniform_int_distribution<size_t> any(0, kVocabulary - 1), common(0, 99);
+    vector<vector<string>> queries(n);
+    for (auto& q : queries) {
+        for (int t = 0; t < 2; ++t) q.push_back(vocabulary()[gen() % 4 == 0 ? common(gen) : any(gen)]);
+    }
+    return queries;
+}
+
+// Times fn(query) once per iteration and reports latency percentiles
+template <class Fn>
+void runQueries(benchmark::State& state, Fn&& fn) {
+    vector<vector<string>> queries = queryTerms(1000);
+    vector<double> micros;
+    size_t i = 0;
+    for (auto _ : state) {
+        auto start = chrono::steady_clock::now();
+        fn(queries[i++ % queries.size()]);
+        micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+    }
+    sort(micros.begin(), micros.end());
+    auto percentile = [&](double p) { return micros[min(micros.size() - 1, size_t(p * micros.size()))]; };
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p99_us"] = percentile(0.99);
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+
+// ---- Micro benchmarks ----
+
+void BM_Tokenize(benchmark::State& state) {
+    tok::Tokenizer tokenizer(tok::Kernel(state.range(0)));
+    state.SetLabel(tokenizer.kernel_name());
+    // One pass first so the tokenizer's scratch space is already sized; the
+    // counter then covers only for_each_word with a visitor that allocates nothing
+    size_t count = 0;
+    tokenizer.for_each_word(corpus(), [&](string_view w) { count += w.size(); });
+    uint64_t allocations = thread_allocations;
+    for (auto _ : state) {
+        count = 0;
+        tokenizer.for_each_word(corpus(), [&](string_view w) { count += w.size(); });
+        benchmark::DoNotOptimize(count);
+    }
+    allocations = thread_allocations - allocations;
+    state.counters["allocs_per_pass"] = double(allocations) / double(state.iterations());
+    state.SetBytesProcessed(int64_t(state.iterations() * corpus().size()));
+}
+BENCHMARK(BM_Tokenize)
+    ->Arg(int(tok::Kernel::Scalar))
+    ->Arg(int(tok::Kernel::SSE42))
+    ->Arg(int(tok::Kernel::AVX2))
+    ->Unit(benchmark::kMillisecond);
+
+void BM_WordTableInsert(benchmark::State& state) {
+    for (auto _ : state) {
+        WordTable<uint32_t> table;
+        for (const string& w : tokens()) table.add(w);
+        benchmark::DoNotOptimize(table.size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations() * tokens().size()));
+    state.SetBytesProcessed(int64_t(state.iterations() * corpus().size()));
+}
+BENCHMARK(BM_WordTableInsert)->Unit(benchmark::kMillisecond);
+
+void BM_DictionaryInsert(benchmark::State& state) {
+    for (auto _ : state) {
+        dictionary::LocalIndex index;
+        tok::Tokenizer tokenizer;
+        for (uint32_t d = 0; d < documents().size(); ++d) {
+            tokenizer.for_each_word(documents()[d], [&](string_view w) { index.add(w, d); });
+        }
+        benchmark::DoNotOptimize(index.postings.size());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * corpus().size()));
+}
+BENCHMARK(BM_DictionaryInsert)->Unit(benchmark::kMillisecond);
+
+// Merge of state.range(0) per-thread word tables into one
+void BM_WordTableMerge(benchmark::State& state) {
+    size_t parts = size_t(state.range(0));
+    vector<WordTable<uint32_t>> tables(parts);
+    for (size_t i = 0; i < tokens().size(); ++i) tables[i * parts / tokens().size()].add(tokens()[i]);
+    for (auto _ : state) {
+        WordTable<uint64_t> merged;
+        for (const auto& table : tables) merged.merge(table);
+        benchmark::DoNotOptimize(merged.size());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * corpus().size()));
+}
+BENCHMARK(BM_WordTableMerge)->Arg(2)->Arg(8)->Unit(benchmark::kMillisecond);
+
+// dictionary::merge of state.range(0) local indexes (one slice of documents
+// each); the locals are rebuilt outside the timed region
+void BM_DictionaryMerge(benchmark::State& state) {
+    size_t parts = size_t(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        vector<dictionary::LocalIndex> locals(parts);
+        tok::Tokenizer tokenizer;
+        for (uint32_t d = 0; d < documents().size(); ++d) {
+            auto& local = locals[d * parts / documents().size()];
+            tokenizer.for_each_word(documents()[d], [&](string_view w) { local.add(w, d); });
+        }
+        dictionary::GlobalIndex global;
+        state.ResumeTiming();
+        dictionary::merge(locals, global, parts);
+        benchmark::DoNotOptimize(global.postings.size());
+    }
+}
+BENCHMARK(BM_DictionaryMerge)->Arg(2)->Arg(8)->Unit(benchmark::kMillisecond);
+
+void BM_SerializeSegment(benchmark::State& state) {
+    vector<uint32_t> lengths;
+    const PositionalIndex& index = positionalIndex(&lengths);
+    bool withPositions = state.range(0) != 0;
+    string path = tempPath("serialize.seg");
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        if (!segment::writeSegment(path, index, lengths, withPositions)) {
+            state.SkipWithError("could not write the segment");
+            break;
+        }
+        bytes += filesystem::file_size(path);
+    }
+    state.SetBytesProcessed(int64_t(bytes));
+    state.SetLabel(withPositions ? "positions" : "no positions");
+    filesystem::remove(path);
+}
+BENCHMARK(BM_SerializeSegment)->Arg(1)->Arg(0)->Unit(benchmark::kMillisecond);
+
+void BM_QueryAnd(benchmark::State& state) {
+    const segment::SegmentReader& reader = segmentReader();
+    runQueries(state, [&](const vector<string>& terms) {
+        query::Query q;
+        for (const string& t : terms) query::addTerm(q, t);
+        benchmark::DoNotOptimize(search::evaluate(reader, q));
+    });
+}
+BENCHMARK(BM_QueryAnd);
+
+void BM_QueryTopK(benchmark::State& state) {
+    const segment::SegmentReader& reader = segmentReader();
+    runQueries(state, [&](const vector<string>& terms) {
+        benchmark::DoNotOptimize(ranking::topK(reader, terms, 10));
+    });
+}
+BENCHMARK(BM_QueryTopK);
+
+// ---- Macro benchmark ----
+
+// Whole boolean index build as invertedIndex.cpp does it: chunked files on
+// the work-stealing pool, per-thread dictionaries, parallel merge
+void BM_BuildBooleanIndex(benchmark::State& state) {
+    size_t numThreads = size_t(state.range(0));
+    static const vector<string> files = [] {
+        vector<string> paths;
+        for (size_t d = 0; d < documents().size(); ++d) {
+            paths.push_back(tempPath("doc" + to_string(d) + ".txt"));
+            ofstream(paths.back(), ios::binary) << documents()[d];
+        }
+        return paths;
+    }();
+    for (auto _ : state) {
+        vector<FileChunk> chunks = plan_chunks(files, 1 << 20);
+        vector<dictionary::LocalIndex> locals(numThreads);
+        run_work_stealing(chunks.size(), numThreads, [&](size_t task, size_t worker) {
+            thread_local string buffer;
+            if (!read_chunk(files[chunks[task].file], chunks[task], buffer)) return;
+            tok::thread_tokenizer().for_each_word(buffer, [&](string_view w) {
+                locals[worker].add(w, uint32_t(chunks[task].file));
+            });
+        });
+        dictionary::GlobalIndex global;
+        dictionary::merge(locals, global, numThreads);
+        benchmark::DoNotOptimize(global.postings.size());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations() * corpus().size()));
+}
+BENCHMARK(BM_BuildBooleanIndex)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
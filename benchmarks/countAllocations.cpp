@@ -0,0 +1,16 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Global operator new that counts the heap allocations of each thread, so
+// bigdataBench can report how many a code path makes. Kept in its own
+// translation unit so no caller sees new and free side by side.
+thread_local uint64_t thread_allocations = 0;
+
+void* operator new(std::size_t size) {
+    thread_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Seeded synthetic text shared by fileGen and the benchmarks. The same seed
+// and vocabulary always give the same bytes, so benchmark inputs are
+// reproducible across machines and commits.
+
+// n distinct lowercase pseudo-words of 2 to 12 letters.
+inline std::vector<std::string> synthetic_vocabulary(size_t n, uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<int> length(2, 12);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> words;
+    words.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        // A base-26 suffix of the index keeps every word distinct
+        std::string word;
+        for (int j = length(gen); j > 0; --j) word += char(letter(gen));
+        for (size_t k = i; k > 0; k /= 26) word += char('a' + k % 26);
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+// Appends about `bytes` bytes of words drawn uniformly from `words`, separated
+// by spaces, with a line break after roughly one word in 15 (fileGen's
+// format). Stops at the first word boundary at or past `bytes`.
+inline void append_random_text(std::string& out, size_t bytes, const std::vector<std::string>& words,
+                               std::mt19937_64& gen) {
+    std::uniform_int_distribution<size_t> pick(0, words.size() - 1);
+    size_t target = out.size() + bytes;
+    while (out.size() < target) {
+        out += words[pick(gen)];
+        out += ' ';
+        if (gen() % 15 == 0) out += '\n';
+    }
+}
+
+inline std::string random_text(size_t bytes, const std::vector<std::string>& words, uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::string out;
+    out.reserve(bytes + 64);
+    append_random_text(out, bytes, words, gen);
+    return out;
+}
+
+// Mixes a seed with a stream id (splitmix64), so every block of a generated
+// file gets its own generator no matter which thread writes it.
+inline uint64_t derive_seed(uint64_t seed, uint64_t stream) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull * (stream + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Draws indices in [0, n) uniformly, or with Zipf probabilities 1 / (i+1)^s
+// when s > 0. Zipf uses Vose's alias table: O(1) per draw after an O(n) build.
+class WordSampler {
+public:
+    WordSampler(size_t n, double zipf_s) : n_(n) {
+        if (zipf_s <= 0 || n == 0) return;
+        std::vector<double> weight(n);
+        double total = 0;
+        for (size_t i = 0; i < n; ++i) total += weight[i] = std::pow(double(i + 1), -zipf_s);
+        for (auto& w : weight) w *= double(n) / total;
+
+        prob_.assign(n, 1.0);
+        alias_.resize(n);
+        std::vector<uint32_t> small, large;
+        for (size_t i = 0; i < n; ++i) (weight[i] < 1.0 ? small : large).push_back(uint32_t(i));
+        while (!small.empty() && !large.empty()) {
+            uint32_t s = small.back(), l = large.back();
+            small.pop_back();
+            prob_[s] = weight[s];
+            alias_[s] = l;
+            weight[l] -= 1.0 - weight[s];
+            if (weight[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Leftovers are 1.0 up to rounding
+    }
+
+    template <class Gen>
+    size_t operator()(Gen& gen) const {
+        uint64_t r = gen();
+        size_t i = size_t((unsigned __int128)(r) * n_ >> 64);
+        if (prob_.empty()) return i;
+        double u = double(gen() >> 11) * 0x1.0p-53;
+        return u < prob_[i] ? i : alias_[i];
+    }
+
+private:
+    size_t n_;
+    std::vector<double> prob_;
+    std::vector<uint32_t> alias_;
+};
+
+// Fills exactly `bytes` bytes with sampled words in fileGen's format and pads
+// the tail with spaces, so blocks can be written side by side and no word
+// ever crosses a block boundary.
+template <class Gen>
+void fill_block(char* out, size_t bytes, const std::vector<std::string>& words,
+                const WordSampler& sampler, Gen& gen) {
+    size_t used = 0;
+    while (true) {
+        const std::string& word = words[sampler(gen)];
+        if (used + word.size() + 1 > bytes) break;
+        std::memcpy(out + used, word.data(), word.size());
+        used += word.size();
+        out[used++] = gen() % 15 == 0 ? '\n' : ' ';
+    }
+    std::memset(out + used, ' ', bytes - used);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Byte range [begin, end) of files[file]. Ranges never cut a word in two.
+struct FileChunk {
+    size_t file;
+    uint64_t begin;
+    uint64_t end;
+};
+
+constexpr uint64_t kDefaultChunkBytes = uint64_t(32) << 20;
+
+// Moves pos forward until the byte before it is a boundary (whitespace, or
+// '\n' when whole_lines is set). Reads a small window with pread, so cutting
+// a 1 GB file costs a few kilobytes of I/O.
+inline uint64_t snap_to_boundary(int fd, uint64_t pos, uint64_t size, bool whole_lines) {
+    char window[4096];
+    while (pos > 0 && pos < size) {
+        // window[i] is the byte before pos + i
+        ssize_t n = pread(fd, window, sizeof(window), off_t(pos - 1));
+        if (n <= 0) break;
+        for (ssize_t i = 0; i < n; ++i) {
+            unsigned char c = static_cast<unsigned char>(window[i]);
+            if (whole_lines ? c == '\n' : std::isspace(c) != 0) return std::min(pos + i, size);
+        }
+        pos += uint64_t(n);
+    }
+    return std::min(pos, size);
+}
+
+// Splits every file into ranges of about chunk_bytes, in file order and then
+// offset order. Empty files get one empty chunk so they still count as
+// documents; files that cannot be opened get none.
+inline std::vector<FileChunk> plan_chunks(const std::vector<std::string>& files,
+                                          uint64_t chunk_bytes = kDefaultChunkBytes,
+                                          bool whole_lines = false) {
+    std::vector<FileChunk> chunks;
+    chunk_bytes = std::max<uint64_t>(1, chunk_bytes);
+    for (size_t f = 0; f < files.size(); ++f) {
+        int fd = ::open(files[f].c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            continue;
+        }
+        uint64_t size = uint64_t(st.st_size);
+        uint64_t begin = 0;
+        do {
+            uint64_t end = begin + chunk_bytes >= size
+                               ? size
+                               : snap_to_boundary(fd, begin + chunk_bytes, size, whole_lines);
+            chunks.push_back({f, begin, end});
+            begin = end;
+        } while (begin < size);
+        ::close(fd);
+    }
+    return chunks;
+}
+
+// Reads a whole chunk into out with pread
+inline bool read_chunk(const std::string& path, const FileChunk& chunk, std::string& out) {
+    out.resize(chunk.end - chunk.begin);
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = pread(fd, out.data() + done, out.size() - done, off_t(chunk.begin + done));
+        if (n <= 0) break;
+        done += size_t(n);
+    }
+    ::close(fd);
+    out.resize(done);
+    return done == chunk.end - chunk.begin;
+}
@@ -0,0 +1,230 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <errno.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+// Lightweight per-thread instrumentation for the word count and index
+// builder programs.
+//
+// Off unless one of these environment variables is set:
+//   BIGDATA_STATS=summary.json   per-thread and total counters, stage times
+//                                and peak RSS, written at exit
+//   BIGDATA_TRACE=trace.json     every stage scope as a Chrome trace event
+//                                (chrome://tracing or ui.perfetto.dev)
+// When both are unset every hook is one predictable branch; compiling with
+// -DINSTRUMENT_OFF removes them entirely.
+//
+// Stage scopes may nest: a lock wait inside a tokenize scope counts in both.
+// Where tokenizing and inserting happen in the same pass, the time is
+// reported as tokenize.
+namespace instr {
+
+enum class Stage { Read, Tokenize, Insert, Merge, Serialize, LockWait, Count };
+
+inline const char* stage_name(Stage s) {
+    static const char* names[] = {"read", "tokenize", "insert", "merge", "serialize", "lock_wait"};
+    return names[size_t(s)];
+}
+
+constexpr size_t kStages = size_t(Stage::Count);
+// Trace events kept per thread; later scopes are still timed, only not traced
+constexpr size_t kMaxTraceEvents = 1 << 20;
+
+struct TraceEvent {
+    Stage stage;
+    int64_t begin_ns;
+    int64_t end_ns;
+};
+
+struct ThreadStats {
+    size_t tid = 0;
+    std::string name;
+    uint64_t bytes_read = 0;
+    uint64_t tokens = 0;
+    uint64_t unique_keys = 0;
+    int64_t stage_ns[kStages] = {};
+    std::vector<TraceEvent> events;
+};
+
+namespace detail {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+    const char* stats_path = std::getenv("BIGDATA_STATS");
+    const char* trace_path = std::getenv("BIGDATA_TRACE");
+    bool on = (stats_path && *stats_path) || (trace_path && *trace_path);
+    bool trace = trace_path && *trace_path;
+};
+
+inline const Config config;
+
+// Owns every thread's stats so they outlive the threads; writes the outputs
+// when the program exits
+class Registry {
+public:
+    Registry() : start_(Clock::now()), main_(std::this_thread::get_id()) {}
+    ~Registry() { write(); }
+
+    ThreadStats* add_thread() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads_.push_back(std::make_unique<ThreadStats>());
+        ThreadStats* stats = threads_.back().get();
+        stats->tid = threads_.size() - 1;
+        stats->name = std::this_thread::get_id() == main_ ? "main" : "thread " + std::to_string(stats->tid);
+        return stats;
+    }
+
+    int64_t now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+    }
+
+private:
+    static void json_string(std::ostream& out, const std::string& s) {
+        out << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << '"';
+    }
+
+    static void counters(std::ostream& out, const ThreadStats& t) {
+        out << "\"bytes_read\": " << t.bytes_read << ", \"tokens\": " << t.tokens
+            << ", \"unique_keys\": " << t.unique_keys;
+        for (size_t s = 0; s < kStages; ++s) {
+            out << ", \"" << stage_name(Stage(s)) << "_ms\": " << t.stage_ns[s] / 1e6;
+        }
+    }
+
+    void write() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        double wall_ms = now_ns() / 1e6;
+        if (config.stats_path && *config.stats_path) {
+            rusage usage{};
+            getrusage(RUSAGE_SELF, &usage);
+            ThreadStats total;
+            for (const auto& t : threads_) {
+                total.bytes_read += t->bytes_read;
+                total.tokens += t->tokens;
+                total.unique_keys += t->unique_keys;
+                for (size_t s = 0; s < kStages; ++s) total.stage_ns[s] += t->stage_ns[s];
+            }
+            std::ofstream out(config.stats_path);
+            out << "{\n  \"program\": ";
+            json_string(out, program_invocation_short_name);
+            out << ",\n  \"wall_ms\": " << wall_ms << ",\n  \"peak_rss_kb\": " << usage.ru_maxrss
+                << ",\n  \"totals\": {";
+            counters(out, total);
+            out << "},\n  \"threads\": [";
+            for (size_t i = 0; i < threads_.size(); ++i) {
+                out << (i ? ",\n" : "\n") << "    {\"tid\": " << threads_[i]->tid << ", \"name\": ";
+                json_string(out, threads_[i]->name);
+                out << ", ";
+                counters(out, *threads_[i]);
+                out << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+        if (config.trace) {
+            std::ofstream out(config.trace_path);
+            out << "{\"traceEvents\": [";
+            bool first = true;
+            for (const auto& t : threads_) {
+                out << (first ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+                    << t->tid << ", \"args\": {\"name\": ";
+                json_string(out, t->name);
+                out << "}}";
+                first = false;
+                for (const TraceEvent& e : t->events) {
+                    out << ",\n{\"name\": \"" << stage_name(e.stage) << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                        << t->tid << ", \"ts\": " << e.begin_ns / 1e3 << ", \"dur\": "
+                        << (e.end_ns - e.begin_ns) / 1e3 << "}";
+                }
+            }
+            out << "\n]}\n";
+        }
+    }
+
+    Clock::time_point start_;
+    std::thread::id main_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ThreadStats>> threads_;
+};
+
+// Created during static initialization so wall time starts with the process
+inline Registry registry;
+
+}  // namespace detail
+
+inline bool enabled() {
+#ifdef INSTRUMENT_OFF
+    return false;
+#else
+    return detail::config.on;
+#endif
+}
+
+// Stats of the calling thread (registered on first use)
+inline ThreadStats& local() {
+    thread_local ThreadStats* stats = detail::registry.add_thread();
+    return *stats;
+}
+
+inline void set_thread_name(const std::string& name) {
+    if (enabled()) local().name = name;
+}
+inline void add_bytes(uint64_t n) {
+    if (enabled()) local().bytes_read += n;
+}
+inline void add_tokens(uint64_t n) {
+    if (enabled()) local().tokens += n;
+}
+inline void add_unique_keys(uint64_t n) {
+    if (enabled()) local().unique_keys += n;
+}
+
+// Times the enclosing block as one stage of the calling thread
+class Scope {
+public:
+    explicit Scope(Stage stage) : stage_(stage) {
+        if (enabled()) begin_ = detail::registry.now_ns();
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+    ~Scope() {
+        if (begin_ < 0) return;
+        int64_t end = detail::registry.now_ns();
+        ThreadStats& stats = local();
+        stats.stage_ns[size_t(stage_)] += end - begin_;
+        if (detail::config.trace && stats.events.size() < kMaxTraceEvents) {
+            stats.events.push_back({stage_, begin_, end});
+        }
+    }
+
+private:
+    Stage stage_;
+    int64_t begin_ = -1;
+};
+
+// Locks m, counting the time spent waiting for it as lock_wait
+template <class Mutex>
+std::unique_lock<Mutex> timed_lock(Mutex& m) {
+    if (!enabled()) return std::unique_lock<Mutex>(m);
+    std::unique_lock<Mutex> lock(m, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        Scope wait(Stage::LockWait);
+        lock.lock();
+    }
+    return lock;
+}
+
+}  // namespace instr
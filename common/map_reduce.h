@@ -0,0 +1,1116 @@
+#pragma once
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "file_chunks.h"
+#include "instrument.h"
+#include "word_table.h"
+
+// Local multi-process MapReduce runtime.
+//
+// A coordinator hands out tasks over a stream socket to worker processes,
+// which may run on this machine or on others ("unix:/path" or
+// "tcp:host:port"). Input files, the output directory and each worker's
+// scratch directory are plain paths, so across machines the input and
+// output must be on a shared file system; the shuffle itself goes over
+// sockets.
+//
+//   map task     reads one chunk of the input (plan_chunks), folds every
+//                emitted record into a hash table keyed by the record key
+//                (the map-side combiner) and spills the table whenever it
+//                outgrows the memory budget: records are hash-partitioned
+//                and each partition is written sorted by key. Several spills
+//                are merged into one map output file with a segment per
+//                partition.
+//   shuffle      each worker serves the segments of its map outputs from a
+//                socket of its own; reducer r fetches segment r of every map
+//                output to local runs.
+//   reduce task  streams a k-way merge of its runs (at most kMergeFactor
+//                open at a time, extra passes otherwise), folding equal keys
+//                with the job's combiner, and writes part-NNNNN.
+//
+// A job type supplies the record logic:
+//   using Input, Value;                            what map emits / what is stored per key
+//   void map(text, doc, emit) const;               emit(key, hash, Input) per record
+//   static Value make(const Input&);               first record of a key
+//   static size_t accumulate(Value&, const Input&) fold a record; returns bytes added
+//   static void combine(Value&, Value&&);          fold two partial values
+//   static size_t bytes(const Value&);             heap bytes of a value
+//   static void encode(const Value&, std::string&);
+//   static Value decode(std::string_view);
+//   void write(key, const Value&, std::string& out) const;   one output line
+//
+// Wire protocol: every message is a 4-byte little-endian length and text.
+//   worker -> coordinator  HELLO <shuffle address> | NEXT |
+//                          DONE MAP <task> <spills> <records> <bytes> |
+//                          DONE REDUCE <r> <records> | FAILED <MAP|REDUCE> <id> <why>
+//   coordinator -> worker  JOB <name> <partitions> <memory>\n<output dir>\n<file>... |
+//                          MAP <task> <file> <begin> <end> |
+//                          REDUCE <r>\n<task> <address>... | EXIT
+//   reducer -> worker      SEGMENT <task> <partition>, answered with an
+//                          8-byte length (UINT64_MAX if missing) and the bytes
+namespace mr {
+
+constexpr size_t kMergeFactor = 64;
+constexpr size_t kIoBuffer = 1 << 20;
+
+// ---- Sockets and framing ----
+
+inline bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+inline bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+inline bool send_message(int fd, std::string_view message) {
+    std::string frame(4, '\0');
+    uint32_t n = uint32_t(message.size());
+    std::memcpy(frame.data(), &n, 4);
+    frame += message;
+    return write_all(fd, frame.data(), frame.size());
+}
+
+inline bool recv_message(int fd, std::string& message) {
+    uint32_t n;
+    if (!read_all(fd, reinterpret_cast<char*>(&n), 4)) return false;
+    message.resize(n);
+    return read_all(fd, message.data(), n);
+}
+
+// "tcp:host:port" -> host, port
+inline bool split_tcp(std::string_view rest, std::string& host, std::string& port) {
+    size_t colon = rest.rfind(':');
+    if (colon == std::string_view::npos) return false;
+    host = rest.substr(0, colon);
+    port = rest.substr(colon + 1);
+    return true;
+}
+
+// Listening socket for address; bound gets the address clients should use
+// (with the real port when "tcp:host:0" asked for any). -1 on failure.
+inline int listen_on(const std::string& address, std::string& bound) {
+    if (address.rfind("unix:", 0) == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return -1;
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ::unlink(path.c_str());
+        if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 128) != 0) {
+            if (fd >= 0) ::close(fd);
+            return -1;
+        }
+        bound = address;
+        return fd;
+    }
+    std::string host, port;
+    if (address.rfind("tcp:", 0) != 0 || !split_tcp(std::string_view(address).substr(4), host, port)) return -1;
+    addrinfo hints{}, *info = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0) return -1;
+    int fd = ::socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+    int one = 1;
+    if (fd >= 0) ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    bool ok = fd >= 0 && ::bind(fd, info->ai_addr, info->ai_addrlen) == 0 && ::listen(fd, 128) == 0;
+    ::freeaddrinfo(info);
+    if (!ok) {
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    sockaddr_in addr{};
+    socklen_t len = sizeof(addr);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+    bound = "tcp:" + host + ":" + std::to_string(ntohs(addr.sin_port));
+    return fd;
+}
+
+inline int connect_to(const std::string& address) {
+    if (address.rfind("unix:", 0) == 0) {
+        std::string path = address.substr(5);
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return -1;
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    std::string host, port;
+    if (address.rfind("tcp:", 0) != 0 || !split_tcp(std::string_view(address).substr(4), host, port)) return -1;
+    addrinfo hints{}, *info = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0) return -1;
+    int fd = ::socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+    bool ok = fd >= 0 && ::connect(fd, info->ai_addr, info->ai_addrlen) == 0;
+    ::freeaddrinfo(info);
+    if (!ok) {
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// ---- Records and run files ----
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+inline bool get_varint(std::string_view& in, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        unsigned char c = static_cast<unsigned char>(in[0]);
+        in.remove_prefix(1);
+        v |= uint64_t(c & 0x7F) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+// Partition of a key; every process computes the same one
+inline size_t partition_of(uint64_t hash, size_t partitions) { return size_t((hash >> 32) % partitions); }
+
+// Appends records (varint key length, key, varint value length, value) to a
+// file through a buffer
+class RecordWriter {
+public:
+    RecordWriter() = default;
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+    ~RecordWriter() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    // The first skip bytes are left for a header
+    bool open(const std::string& path, uint64_t skip = 0) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        position_ = skip;
+        ok_ = fd_ >= 0 && (skip == 0 || ::lseek(fd_, off_t(skip), SEEK_SET) == off_t(skip));
+        return ok_;
+    }
+
+    void add(std::string_view key, std::string_view value) {
+        size_t before = buffer_.size();
+        put_varint(buffer_, key.size());
+        buffer_ += key;
+        put_varint(buffer_, value.size());
+        buffer_ += value;
+        position_ += buffer_.size() - before;
+        ++records_;
+        if (buffer_.size() >= kIoBuffer) flush();
+    }
+
+    void append(std::string_view bytes) {
+        buffer_ += bytes;
+        position_ += bytes.size();
+        if (buffer_.size() >= kIoBuffer) flush();
+    }
+
+    bool write_at(uint64_t offset, std::string_view bytes) {
+        ok_ = ok_ && ::pwrite(fd_, bytes.data(), bytes.size(), off_t(offset)) == ssize_t(bytes.size());
+        return ok_;
+    }
+
+    bool finish() {
+        flush();
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        return ok_;
+    }
+
+    uint64_t position() const { return position_; }
+    uint64_t records() const { return records_; }
+
+private:
+    void flush() {
+        instr::Scope scope(instr::Stage::Serialize);
+        ok_ = ok_ && write_all(fd_, buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    int fd_ = -1;
+    bool ok_ = false;
+    std::string buffer_;
+    uint64_t position_ = 0;
+    uint64_t records_ = 0;
+};
+
+// Map output file: magic, partition count, partitions + 1 offsets and the
+// segments; segment p is [offsets[p], offsets[p + 1]), sorted by key
+constexpr char kRunMagic[8] = {'M', 'R', 'R', 'U', 'N', '\0', '\0', '\1'};
+
+inline uint64_t run_header_bytes(size_t partitions) { return sizeof(kRunMagic) + 4 + 8 * (partitions + 1); }
+
+class RunWriter {
+public:
+    bool open(const std::string& path, size_t partitions) {
+        offsets_.assign(partitions + 1, run_header_bytes(partitions));
+        current_ = 0;
+        return out_.open(path, run_header_bytes(partitions));
+    }
+
+    // Partitions must come in increasing order
+    void add(size_t partition, std::string_view key, std::string_view value) {
+        advance(partition);
+        out_.add(key, value);
+    }
+
+    bool finish() {
+        advance(offsets_.size() - 1);
+        std::string header(kRunMagic, sizeof(kRunMagic));
+        uint32_t partitions = uint32_t(offsets_.size() - 1);
+        header.append(reinterpret_cast<const char*>(&partitions), 4);
+        header.append(reinterpret_cast<const char*>(offsets_.data()), 8 * offsets_.size());
+        bool ok = out_.write_at(0, header);
+        return out_.finish() && ok;
+    }
+
+    uint64_t records() const { return out_.records(); }
+
+private:
+    // Closes the partitions before p
+    void advance(size_t p) {
+        while (current_ < p) offsets_[++current_] = out_.position();
+    }
+
+    RecordWriter out_;
+    std::vector<uint64_t> offsets_;
+    size_t current_ = 0;
+};
+
+// Segment offsets of a map output file
+inline std::optional<std::vector<uint64_t>> read_run_offsets(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return std::nullopt;
+    char head[sizeof(kRunMagic) + 4];
+    std::optional<std::vector<uint64_t>> offsets;
+    if (::pread(fd, head, sizeof(head), 0) == ssize_t(sizeof(head)) &&
+        std::memcmp(head, kRunMagic, sizeof(kRunMagic)) == 0) {
+        uint32_t partitions;
+        std::memcpy(&partitions, head + sizeof(kRunMagic), 4);
+        std::vector<uint64_t> v(size_t(partitions) + 1);
+        ssize_t bytes = ssize_t(8 * v.size());
+        if (::pread(fd, v.data(), size_t(bytes), off_t(sizeof(head))) == bytes) offsets = std::move(v);
+    }
+    ::close(fd);
+    return offsets;
+}
+
+// Reads the records of [begin, end) of a file in order. key() and value()
+// point into the reader's buffer and stay valid until the next next().
+class SegmentReader {
+public:
+    static constexpr size_t kBuffer = 64 << 10;
+
+    SegmentReader() = default;
+    SegmentReader(const SegmentReader&) = delete;
+    SegmentReader& operator=(const SegmentReader&) = delete;
+    SegmentReader(SegmentReader&& other) noexcept { *this = std::move(other); }
+    SegmentReader& operator=(SegmentReader&& other) noexcept {
+        std::swap(fd_, other.fd_);
+        pos_ = other.pos_;
+        end_ = other.end_;
+        buffer_ = std::move(other.buffer_);
+        start_ = other.start_;
+        record_ = other.record_;
+        key_ = other.key_;
+        value_ = other.value_;
+        return *this;
+    }
+    ~SegmentReader() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool open(const std::string& path, uint64_t begin, uint64_t end) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        pos_ = begin;
+        end_ = end;
+        return fd_ >= 0;
+    }
+
+    bool next() {
+        // fill() drops what precedes record_ and shifts the rest, so the
+        // parts of the record are kept as offsets from record_
+        record_ = start_;
+        uint64_t key_size, value_size;
+        if (!varint(key_size) || !fill(key_size)) return false;
+        size_t key_at = start_ - record_;
+        start_ += key_size;
+        if (!varint(value_size) || !fill(value_size)) return false;
+        size_t value_at = start_ - record_;
+        start_ += value_size;
+        key_ = std::string_view(buffer_).substr(record_ + key_at, key_size);
+        value_ = std::string_view(buffer_).substr(record_ + value_at, value_size);
+        return true;
+    }
+
+    std::string_view key() const { return key_; }
+    std::string_view value() const { return value_; }
+
+private:
+    // Makes at least need bytes available from start_; the current record
+    // (from record_) is kept in the buffer
+    bool fill(size_t need) {
+        if (buffer_.size() - start_ >= need) return true;
+        if (record_ > 0) {
+            buffer_.erase(0, record_);
+            start_ -= record_;
+            record_ = 0;
+        }
+        while (buffer_.size() - start_ < need) {
+            size_t want = std::max(kBuffer, need - (buffer_.size() - start_));
+            want = size_t(std::min<uint64_t>(want, end_ - pos_));
+            if (want == 0) return false;
+            size_t old = buffer_.size();
+            buffer_.resize(old + want);
+            ssize_t n = ::pread(fd_, buffer_.data() + old, want, off_t(pos_));
+            if (n <= 0) {
+                buffer_.resize(old);
+                return false;
+            }
+            buffer_.resize(old + size_t(n));
+            pos_ += uint64_t(n);
+        }
+        return true;
+    }
+
+    bool varint(uint64_t& v) {
+        fill(10);  // may be fewer at the end of the segment
+        std::string_view in = std::string_view(buffer_).substr(start_);
+        size_t before = in.size();
+        if (in.empty() || !get_varint(in, v)) return false;
+        start_ += before - in.size();
+        return true;
+    }
+
+    int fd_ = -1;
+    uint64_t pos_ = 0, end_ = 0;
+    std::string buffer_;
+    size_t start_ = 0;   // next unread byte of buffer_
+    size_t record_ = 0;  // first byte of the record being read
+    std::string_view key_, value_;
+};
+
+// K-way merge of sorted segments: fn(key, value) once per distinct key, in
+// key order, with the values of every segment folded by Job::combine
+template <class Job, class Fn>
+void merge_segments(std::vector<SegmentReader>& readers, Fn&& fn) {
+    instr::Scope scope(instr::Stage::Merge);
+    auto later = [&](size_t a, size_t b) {
+        int c = readers[a].key().compare(readers[b].key());
+        return c != 0 ? c > 0 : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+    for (size_t r = 0; r < readers.size(); ++r) {
+        if (readers[r].next()) heap.push(r);
+    }
+    std::string key;
+    while (!heap.empty()) {
+        size_t r = heap.top();
+        heap.pop();
+        key.assign(readers[r].key());
+        typename Job::Value value = Job::decode(readers[r].value());
+        if (readers[r].next()) heap.push(r);
+        while (!heap.empty() && readers[heap.top()].key() == key) {
+            size_t s = heap.top();
+            heap.pop();
+            Job::combine(value, Job::decode(readers[s].value()));
+            if (readers[s].next()) heap.push(s);
+        }
+        fn(std::string_view(key), value);
+    }
+}
+
+// ---- Map side ----
+
+// Map-side combiner: key -> value folded as records arrive, so a chunk with
+// a million "the" spills one record for it
+template <class Job>
+class Combiner {
+public:
+    using Value = typename Job::Value;
+    // Slot, arena and bookkeeping per key, roughly
+    static constexpr size_t kEntryBytes = 48;
+
+    void add(std::string_view key, uint64_t hash, const typename Job::Input& input) {
+        uint32_t& id = ids_.value_hashed(key, hash);
+        if (id == 0) {
+            values_.push_back(Job::make(input));
+            id = uint32_t(values_.size());
+            bytes_ += key.size() + kEntryBytes + sizeof(Value) + Job::bytes(values_.back());
+        } else {
+            bytes_ += Job::accumulate(values_[id - 1], input);
+        }
+    }
+
+    size_t bytes() const { return bytes_; }
+    bool empty() const { return values_.empty(); }
+
+    // Writes the table as one sorted segment per partition and empties it.
+    // Returns the records written, or nothing if the file failed.
+    std::optional<uint64_t> spill(const std::string& path, size_t partitions) {
+        struct Entry {
+            std::string_view key;
+            uint32_t id;
+        };
+        std::vector<std::vector<Entry>> parts(partitions);
+        ids_.for_each_hashed([&](std::string_view key, uint64_t hash, uint32_t id) {
+            parts[partition_of(hash, partitions)].push_back({key, id - 1});
+        });
+        RunWriter out;
+        bool ok = out.open(path, partitions);
+        std::string encoded;
+        for (size_t p = 0; p < partitions && ok; ++p) {
+            {
+                instr::Scope scope(instr::Stage::Merge);
+                std::sort(parts[p].begin(), parts[p].end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+            }
+            for (const Entry& e : parts[p]) {
+                encoded.clear();
+                Job::encode(values_[e.id], encoded);
+                out.add(p, e.key, encoded);
+            }
+        }
+        ok = out.finish() && ok;
+        ids_ = WordTable<uint32_t>();
+        values_.clear();
+        bytes_ = 0;
+        if (!ok) return std::nullopt;
+        return out.records();
+    }
+
+private:
+    WordTable<uint32_t> ids_;  // key -> index into values_ + 1
+    std::vector<Value> values_;
+    size_t bytes_ = 0;
+};
+
+// ---- Worker ----
+
+class Worker {
+public:
+    Worker() = default;
+    Worker(const Worker&) = delete;
+    Worker& operator=(const Worker&) = delete;
+    ~Worker() {
+        stop_server();
+        if (fd_ >= 0) ::close(fd_);
+        std::error_code error;
+        if (!dir_.empty()) std::filesystem::remove_all(dir_, error);
+    }
+
+    // Connects to the coordinator, starts the shuffle server and learns the
+    // job. scratch is where this worker's dir goes.
+    bool connect(const std::string& coordinator, const std::string& scratch, std::string& error) {
+        fd_ = connect_to(coordinator);
+        if (fd_ < 0) {
+            error = "cannot connect to " + coordinator;
+            return false;
+        }
+        dir_ = (std::filesystem::path(scratch) / ("w" + std::to_string(::getpid()))).string();
+        std::error_code ec;
+        std::filesystem::create_directories(dir_, ec);
+        // The shuffle server listens where the coordinator connection comes from
+        std::string shuffle = "unix:" + dir_ + "/shuffle.sock";
+        if (coordinator.rfind("tcp:", 0) == 0) {
+            sockaddr_in local{};
+            socklen_t len = sizeof(local);
+            ::getsockname(fd_, reinterpret_cast<sockaddr*>(&local), &len);
+            char ip[INET_ADDRSTRLEN] = "127.0.0.1";
+            ::inet_ntop(AF_INET, &local.sin_addr, ip, sizeof(ip));
+            shuffle = std::string("tcp:") + ip + ":0";
+        }
+        listen_fd_ = listen_on(shuffle, shuffle_address_);
+        if (listen_fd_ < 0) {
+            error = "cannot listen on " + shuffle;
+            return false;
+        }
+        server_ = std::thread([this] { serve_shuffle(); });
+
+        std::string reply;
+        if (!send_message(fd_, "HELLO " + shuffle_address_) || !recv_message(fd_, reply)) {
+            error = "coordinator closed the connection";
+            return false;
+        }
+        std::istringstream in(reply);
+        std::string word, line;
+        in >> word >> job_ >> partitions_ >> memory_;
+        std::getline(in, line);
+        std::getline(in, output_dir_);
+        while (std::getline(in, line)) files_.push_back(line);
+        if (word != "JOB" || partitions_ == 0) {
+            error = "unexpected reply: " + reply.substr(0, 40);
+            return false;
+        }
+        return true;
+    }
+
+    const std::string& job() const { return job_; }
+    const std::vector<std::string>& files() const { return files_; }
+
+    // Runs tasks until the coordinator says EXIT. false if it went away.
+    template <class Job>
+    bool run(const Job& job) {
+        std::string task;
+        for (;;) {
+            if (!send_message(fd_, "NEXT") || !recv_message(fd_, task)) return false;
+            std::istringstream in(task);
+            std::string kind;
+            in >> kind;
+            std::string report;
+            if (kind == "EXIT") return true;
+            if (kind == "MAP") {
+                size_t id;
+                FileChunk chunk;
+                in >> id >> chunk.file >> chunk.begin >> chunk.end;
+                report = map_task(job, id, chunk);
+            } else if (kind == "REDUCE") {
+                size_t r;
+                in >> r;
+                std::vector<std::pair<size_t, std::string>> sources;
+                size_t m;
+                std::string address;
+                while (in >> m >> address) sources.push_back({m, address});
+                report = reduce_task(job, r, sources);
+            } else {
+                return false;
+            }
+            if (!send_message(fd_, report)) return false;
+        }
+    }
+
+private:
+    std::string map_output(size_t task) const { return dir_ + "/map-" + std::to_string(task) + ".out"; }
+
+    template <class Job>
+    std::string map_task(const Job& job, size_t task, const FileChunk& chunk) {
+        std::string fail = "FAILED MAP " + std::to_string(task) + " ";
+        if (chunk.file >= files_.size()) return fail + "bad file";
+        thread_local std::string text;
+        {
+            instr::Scope scope(instr::Stage::Read);
+            if (!read_chunk(files_[chunk.file], chunk, text)) return fail + "cannot read " + files_[chunk.file];
+        }
+        instr::add_bytes(text.size());
+
+        Combiner<Job> combiner;
+        std::vector<std::string> spills;
+        uint64_t tokens = 0;
+        bool ok = true;
+        auto spill_path = [&] { return map_output(task) + ".spill" + std::to_string(spills.size()); };
+        {
+            instr::Scope scope(instr::Stage::Tokenize);
+            job.map(text, uint32_t(chunk.file), [&](std::string_view key, uint64_t hash, const typename Job::Input& v) {
+                combiner.add(key, hash, v);
+                ++tokens;
+                if (combiner.bytes() > memory_) {
+                    std::string path = spill_path();
+                    ok = combiner.spill(path, partitions_).has_value() && ok;
+                    spills.push_back(path);
+                }
+            });
+        }
+        instr::add_tokens(tokens);
+
+        std::string output = map_output(task);
+        uint64_t records = 0;
+        if (spills.empty()) {
+            // One spill: it is the map output
+            auto written = combiner.spill(output, partitions_);
+            ok = written.has_value() && ok;
+            records = written.value_or(0);
+        } else {
+            if (!combiner.empty()) {
+                std::string path = spill_path();
+                ok = combiner.spill(path, partitions_).has_value() && ok;
+                spills.push_back(path);
+            }
+            std::vector<std::vector<uint64_t>> offsets;
+            for (const auto& s : spills) {
+                auto o = read_run_offsets(s);
+                ok = ok && o && o->size() == partitions_ + 1;
+                offsets.push_back(o.value_or(std::vector<uint64_t>()));
+            }
+            RunWriter out;
+            ok = ok && out.open(output, partitions_);
+            std::string encoded;
+            for (size_t p = 0; p < partitions_ && ok; ++p) {
+                std::vector<SegmentReader> readers(spills.size());
+                for (size_t s = 0; s < spills.size(); ++s) readers[s].open(spills[s], offsets[s][p], offsets[s][p + 1]);
+                merge_segments<Job>(readers, [&](std::string_view key, const typename Job::Value& value) {
+                    encoded.clear();
+                    Job::encode(value, encoded);
+                    out.add(p, key, encoded);
+                });
+            }
+            ok = out.finish() && ok;
+            records = out.records();
+            for (const auto& s : spills) ::unlink(s.c_str());
+        }
+        if (!ok) return fail + "cannot write " + output;
+        std::error_code error;
+        uint64_t bytes = std::filesystem::file_size(output, error);
+        return "DONE MAP " + std::to_string(task) + " " + std::to_string(spills.empty() ? 1 : spills.size()) + " " +
+               std::to_string(records) + " " + std::to_string(bytes);
+    }
+
+    // Copies segment partition of map task's output from a worker to path.
+    // Returns the bytes copied, or nothing.
+    static std::optional<uint64_t> fetch(const std::string& address, size_t task, size_t partition,
+                                         const std::string& path) {
+        int fd = connect_to(address);
+        if (fd < 0) return std::nullopt;
+        std::optional<uint64_t> copied;
+        uint64_t size;
+        if (send_message(fd, "SEGMENT " + std::to_string(task) + " " + std::to_string(partition)) &&
+            read_all(fd, reinterpret_cast<char*>(&size), 8) && size != UINT64_MAX) {
+            RecordWriter out;
+            std::string buffer(kIoBuffer, '\0');
+            uint64_t left = size;
+            bool ok = size == 0 || out.open(path);
+            while (ok && left > 0) {
+                size_t n = size_t(std::min<uint64_t>(left, buffer.size()));
+                ok = read_all(fd, buffer.data(), n);
+                if (ok) out.append(std::string_view(buffer.data(), n));
+                left -= n;
+            }
+            if (ok && (size == 0 || out.finish())) copied = size;
+        }
+        ::close(fd);
+        return copied;
+    }
+
+    template <class Job>
+    std::string reduce_task(const Job& job, size_t r, const std::vector<std::pair<size_t, std::string>>& sources) {
+        std::string fail = "FAILED REDUCE " + std::to_string(r) + " ";
+        std::string prefix = dir_ + "/reduce-" + std::to_string(r) + "-";
+        struct Run {
+            std::string path;
+            uint64_t size;
+        };
+        std::deque<Run> runs;
+        auto cleanup = [&] {
+            for (const Run& run : runs) ::unlink(run.path.c_str());
+        };
+
+        // Shuffle: every map output's segment r to a local run
+        for (const auto& [task, address] : sources) {
+            std::string path = prefix + std::to_string(task);
+            std::optional<uint64_t> size;
+            {
+                instr::Scope scope(instr::Stage::Read);
+                size = fetch(address, task, r, path);
+            }
+            if (!size) {
+                cleanup();
+                return fail + "cannot fetch map " + std::to_string(task) + " from " + address;
+            }
+            instr::add_bytes(*size);
+            if (*size > 0) runs.push_back({path, *size});
+        }
+
+        // Extra passes while there are more runs than can be open at once
+        size_t passes = 0;
+        std::string encoded;
+        while (runs.size() > kMergeFactor) {
+            std::vector<SegmentReader> readers(kMergeFactor);
+            std::vector<Run> merged(runs.begin(), runs.begin() + long(kMergeFactor));
+            runs.erase(runs.begin(), runs.begin() + long(kMergeFactor));
+            for (size_t i = 0; i < merged.size(); ++i) readers[i].open(merged[i].path, 0, merged[i].size);
+            std::string path = prefix + "pass" + std::to_string(passes++);
+            RecordWriter out;
+            bool ok = out.open(path);
+            merge_segments<Job>(readers, [&](std::string_view key, const typename Job::Value& value) {
+                encoded.clear();
+                Job::encode(value, encoded);
+                out.add(key, encoded);
+            });
+            ok = out.finish() && ok;
+            for (const Run& run : merged) ::unlink(run.path.c_str());
+            runs.push_back({path, out.position()});
+            if (!ok) {
+                cleanup();
+                return fail + "cannot write " + path;
+            }
+        }
+
+        // Final pass straight into the output; renamed when complete so a
+        // re-run task never leaves half a file
+        char name[32];
+        std::snprintf(name, sizeof(name), "part-%05zu", r);
+        std::string output = (std::filesystem::path(output_dir_) / name).string();
+        std::string partial = output + ".tmp" + std::to_string(::getpid());
+        std::vector<SegmentReader> readers(runs.size());
+        for (size_t i = 0; i < runs.size(); ++i) readers[i].open(runs[i].path, 0, runs[i].size);
+        RecordWriter out;
+        bool ok = out.open(partial);
+        uint64_t records = 0;
+        std::string line;
+        merge_segments<Job>(readers, [&](std::string_view key, const typename Job::Value& value) {
+            line.clear();
+            job.write(key, value, line);
+            out.append(line);
+            ++records;
+        });
+        ok = out.finish() && ok;
+        cleanup();
+        if (!ok || std::rename(partial.c_str(), output.c_str()) != 0) {
+            ::unlink(partial.c_str());
+            return fail + "cannot write " + output;
+        }
+        instr::add_unique_keys(records);
+        return "DONE REDUCE " + std::to_string(r) + " " + std::to_string(records);
+    }
+
+    // Answers SEGMENT requests, one per connection, each on its own thread
+    void serve_shuffle() {
+        for (;;) {
+            int client = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            std::thread([this, client] {
+                std::string request;
+                if (recv_message(client, request)) {
+                    std::istringstream in(request);
+                    std::string word;
+                    size_t task = 0, partition = 0;
+                    in >> word >> task >> partition;
+                    std::string path = map_output(task);
+                    auto offsets = read_run_offsets(path);
+                    uint64_t size = UINT64_MAX;
+                    if (word == "SEGMENT" && offsets && partition + 1 < offsets->size()) {
+                        size = (*offsets)[partition + 1] - (*offsets)[partition];
+                    }
+                    bool ok = write_all(client, reinterpret_cast<const char*>(&size), 8);
+                    int fd = size == UINT64_MAX ? -1 : ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                    std::string buffer(size_t(std::min<uint64_t>(size, kIoBuffer)), '\0');
+                    for (uint64_t done = 0; ok && fd >= 0 && done < size;) {
+                        ssize_t n = ::pread(fd, buffer.data(), size_t(std::min<uint64_t>(size - done, buffer.size())),
+                                            off_t((*offsets)[partition] + done));
+                        ok = n > 0 && write_all(client, buffer.data(), size_t(n));
+                        done += uint64_t(std::max<ssize_t>(n, 0));
+                    }
+                    if (fd >= 0) ::close(fd);
+                }
+                ::close(client);
+            }).detach();
+        }
+    }
+
+    void stop_server() {
+        if (listen_fd_ >= 0) ::shutdown(listen_fd_, SHUT_RDWR);
+        if (server_.joinable()) server_.join();
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+
+    int fd_ = -1;
+    int listen_fd_ = -1;
+    std::thread server_;
+    std::string shuffle_address_;
+    std::string dir_;
+    std::string job_;
+    size_t partitions_ = 0;
+    uint64_t memory_ = 0;
+    std::string output_dir_;
+    std::vector<std::string> files_;
+};
+
+// ---- Coordinator ----
+
+struct JobSpec {
+    std::string name;
+    std::vector<std::string> files;
+    uint64_t chunk_bytes = kDefaultChunkBytes;
+    size_t partitions = 4;
+    uint64_t memory = uint64_t(64) << 20;  // per map task, before spilling
+    std::string output_dir;
+};
+
+struct Summary {
+    size_t map_tasks = 0;
+    size_t reduce_tasks = 0;
+    size_t workers = 0;
+    uint64_t spills = 0;
+    uint64_t map_records = 0;   // after the map-side combiner
+    uint64_t shuffle_bytes = 0;
+    uint64_t output_records = 0;
+    size_t retries = 0;         // failed or requeued task runs
+};
+
+class Coordinator {
+public:
+    // Tasks failing this many times end the job
+    static constexpr size_t kMaxAttempts = 4;
+
+    explicit Coordinator(JobSpec spec) : spec_(std::move(spec)) {
+        chunks_ = plan_chunks(spec_.files, spec_.chunk_bytes);
+        maps_.resize(chunks_.size());
+        reduces_.resize(spec_.partitions);
+    }
+    Coordinator(const Coordinator&) = delete;
+    Coordinator& operator=(const Coordinator&) = delete;
+    ~Coordinator() {
+        for (auto& w : workers_) {
+            if (w.fd >= 0) ::close(w.fd);
+        }
+        if (listen_fd_ >= 0) ::close(listen_fd_);
+    }
+
+    bool listen(const std::string& address) {
+        listen_fd_ = listen_on(address, address_);
+        return listen_fd_ >= 0;
+    }
+    const std::string& address() const { return address_; }
+
+    // Serves workers until every reduce task is done. false (with error)
+    // when a task keeps failing or every worker is gone; alive() says
+    // whether workers may still connect.
+    bool run(Summary& summary, std::string& error, const std::function<bool()>& alive = {}) {
+        summary = Summary{};
+        summary.map_tasks = maps_.size();
+        summary.reduce_tasks = reduces_.size();
+        while (!finished()) {
+            std::vector<pollfd> fds{{listen_fd_, POLLIN, 0}};
+            std::vector<size_t> ids;
+            for (size_t w = 0; w < workers_.size(); ++w) {
+                if (workers_[w].fd < 0) continue;
+                fds.push_back({workers_[w].fd, POLLIN, 0});
+                ids.push_back(w);
+            }
+            if (ids.empty() && (!workers_.empty() || (alive && !alive()))) {
+                error = "no workers left";
+                return false;
+            }
+            if (::poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR) {
+                error = "poll failed";
+                return false;
+            }
+            if (fds[0].revents & POLLIN) {
+                int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd >= 0) workers_.push_back({fd});
+            }
+            for (size_t i = 1; i < fds.size(); ++i) {
+                if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                size_t w = ids[i - 1];
+                std::string message;
+                if (!recv_message(workers_[w].fd, message)) lost(w);
+                else if (!handle(w, message, summary, error)) return false;
+            }
+            assign_waiting();
+        }
+        // Every worker still connected is told to leave
+        for (auto& w : workers_) {
+            if (w.fd < 0) continue;
+            if (w.waiting) send_message(w.fd, "EXIT");
+            else {
+                std::string message;
+                while (recv_message(w.fd, message) && message != "NEXT" && message.rfind("HELLO", 0) != 0) {}
+                send_message(w.fd, "EXIT");
+            }
+            ::close(w.fd);
+            w.fd = -1;
+        }
+        summary.workers = workers_.size();
+        summary.retries += requeued_;
+        return true;
+    }
+
+private:
+    enum class State { Pending, Running, Done };
+
+    struct Task {
+        State state = State::Pending;
+        size_t worker = 0;
+        size_t attempts = 0;
+    };
+
+    struct Peer {
+        int fd = -1;
+        std::string shuffle;  // where its map outputs are served
+        bool waiting = false; // sent NEXT, no task yet
+        bool running = false;
+        bool is_map = false;
+        size_t task = 0;
+    };
+
+    bool finished() const {
+        return std::all_of(reduces_.begin(), reduces_.end(), [](const Task& t) { return t.state == State::Done; });
+    }
+
+    bool maps_done() const {
+        return std::all_of(maps_.begin(), maps_.end(), [](const Task& t) { return t.state == State::Done; });
+    }
+
+    bool handle(size_t w, const std::string& message, Summary& summary, std::string& error) {
+        Peer& peer = workers_[w];
+        std::istringstream in(message);
+        std::string word;
+        in >> word;
+        if (word == "HELLO") {
+            in >> peer.shuffle;
+            std::string reply = "JOB " + spec_.name + " " + std::to_string(spec_.partitions) + " " +
+                                std::to_string(spec_.memory) + "\n" + spec_.output_dir;
+            for (const auto& f : spec_.files) reply += "\n" + f;
+            if (!send_message(peer.fd, reply)) lost(w);
+        } else if (word == "NEXT") {
+            peer.waiting = true;
+        } else if (word == "DONE") {
+            std::string kind;
+            size_t id;
+            in >> kind >> id;
+            peer.running = false;
+            if (kind == "MAP" && id < maps_.size()) {
+                uint64_t spills = 0, records = 0, bytes = 0;
+                in >> spills >> records >> bytes;
+                maps_[id].state = State::Done;
+                maps_[id].worker = w;
+                summary.spills += spills;
+                summary.map_records += records;
+                summary.shuffle_bytes += bytes;
+            } else if (kind == "REDUCE" && id < reduces_.size()) {
+                uint64_t records = 0;
+                in >> records;
+                reduces_[id].state = State::Done;
+                summary.output_records += records;
+            }
+        } else if (word == "FAILED") {
+            std::string kind, why;
+            size_t id;
+            in >> kind >> id;
+            std::getline(in, why);
+            peer.running = false;
+            std::vector<Task>& tasks = kind == "MAP" ? maps_ : reduces_;
+            if (id < tasks.size()) {
+                tasks[id].state = State::Pending;
+                summary.retries++;
+                if (tasks[id].attempts >= kMaxAttempts) {
+                    error = kind + " " + std::to_string(id) + " failed" + why;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // A worker went away: its task runs again, and so do the maps whose
+    // output it was serving if a reducer may still need them
+    void lost(size_t w) {
+        Peer& peer = workers_[w];
+        ::close(peer.fd);
+        peer.fd = -1;
+        if (peer.running) {
+            (peer.is_map ? maps_ : reduces_)[peer.task].state = State::Pending;
+            requeued_++;
+        }
+        if (!finished()) {
+            for (Task& t : maps_) {
+                if (t.state == State::Done && t.worker == w) {
+                    t.state = State::Pending;
+                    requeued_++;
+                }
+            }
+        }
+    }
+
+    void assign_waiting() {
+        for (size_t w = 0; w < workers_.size(); ++w) {
+            Peer& peer = workers_[w];
+            if (peer.fd < 0 || !peer.waiting) continue;
+            std::string task;
+            auto map = std::find_if(maps_.begin(), maps_.end(), [](const Task& t) { return t.state == State::Pending; });
+            if (map != maps_.end()) {
+                size_t id = size_t(map - maps_.begin());
+                const FileChunk& c = chunks_[id];
+                task = "MAP " + std::to_string(id) + " " + std::to_string(c.file) + " " + std::to_string(c.begin) + " " +
+                       std::to_string(c.end);
+                start(peer, *map, w, true, id);
+            } else if (maps_done()) {
+                auto reduce = std::find_if(reduces_.begin(), reduces_.end(),
+                                           [](const Task& t) { return t.state == State::Pending; });
+                if (reduce == reduces_.end()) continue;  // EXIT once all are done
+                size_t id = size_t(reduce - reduces_.begin());
+                task = "REDUCE " + std::to_string(id);
+                for (size_t m = 0; m < maps_.size(); ++m) {
+                    task += "\n" + std::to_string(m) + " " + workers_[maps_[m].worker].shuffle;
+                }
+                start(peer, *reduce, w, false, id);
+            } else {
+                continue;
+            }
+            if (!send_message(peer.fd, task)) lost(w);
+        }
+    }
+
+    static void start(Peer& peer, Task& task, size_t w, bool is_map, size_t id) {
+        task.state = State::Running;
+        task.worker = w;
+        task.attempts++;
+        peer.waiting = false;
+        peer.running = true;
+        peer.is_map = is_map;
+        peer.task = id;
+    }
+
+    JobSpec spec_;
+    std::vector<FileChunk> chunks_;
+    std::vector<Task> maps_;
+    std::vector<Task> reduces_;
+    std::vector<Peer> workers_;
+    int listen_fd_ = -1;
+    std::string address_;
+    size_t requeued_ = 0;  // tasks run again because their worker went away
+};
+
+}  // namespace mr
@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only view over a whole file. Maps it with mmap when possible and falls
+// back to one large pread() buffer for files the kernel refuses to map.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            data_ = other.data_;
+            size_ = other.size_;
+            mapped_ = other.mapped_;
+            open_ = other.open_;
+            buffer_ = std::move(other.buffer_);
+            other.data_ = nullptr;
+            other.size_ = 0;
+            other.mapped_ = false;
+            other.open_ = false;
+        }
+        return *this;
+    }
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            ::close(fd);
+            open_ = true;
+            return true;
+        }
+
+        void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            madvise(addr, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(addr);
+            mapped_ = true;
+        } else if (!read_all(fd)) {
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        ::close(fd);
+        open_ = true;
+        return true;
+    }
+
+    void close() {
+        if (mapped_) munmap(const_cast<char*>(data_), size_);
+        buffer_.clear();
+        buffer_.shrink_to_fit();
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+        open_ = false;
+    }
+
+    bool is_open() const { return open_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    bool read_all(int fd) {
+        buffer_.resize(size_);
+        size_t done = 0;
+        while (done < size_) {
+            ssize_t n = pread(fd, buffer_.data() + done, size_ - done, done);
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
+        }
+        data_ = buffer_.data();
+        return true;
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    bool open_ = false;
+    std::vector<char> buffer_;
+};
+
+// Touches every page of range so a mapped file is read from disk now rather
+// than through page faults wherever it is first used; lets callers time the
+// read on its own. A no-op cost for data already in memory.
+inline void fault_in(std::string_view range) {
+    if (range.empty()) return;
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(range.data()) & ~uintptr_t(page - 1);
+    madvise(reinterpret_cast<void*>(start), reinterpret_cast<uintptr_t>(range.data()) + range.size() - start,
+            MADV_WILLNEED);
+    volatile char sink = 0;
+    for (size_t i = 0; i < range.size(); i += page) sink = sink ^ range[i];
+    sink = sink ^ range.back();
+}
+
+// Splits data into `parts` byte ranges whose boundaries never fall inside a
+// word: every cut is moved forward until the previous byte is whitespace.
+// Returns parts + 1 offsets; range i is [cuts[i], cuts[i + 1]).
+inline std::vector<size_t> split_at_whitespace(std::string_view data, size_t parts) {
+    if (parts == 0) parts = 1;
+    std::vector<size_t> cuts(parts + 1, data.size());
+    cuts[0] = 0;
+    for (size_t i = 1; i < parts; ++i) {
+        size_t pos = std::max(cuts[i - 1], data.size() / parts * i);
+        while (pos < data.size() && pos > 0 &&
+               !std::isspace(static_cast<unsigned char>(data[pos - 1]))) {
+            ++pos;
+        }
+        cuts[i] = pos;
+    }
+    return cuts;
+}
@@ -0,0 +1,383 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "file_chunks.h"
+#include "instrument.h"
+#if !defined(READ_PIPELINE_NO_URING) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define READ_PIPELINE_URING 1
+#endif
+
+// Bounded multi-producer multi-consumer queue. pop() blocks until an item
+// arrives or the queue is closed and drained. Time spent blocked (on the lock
+// or waiting for room or items) is instrumented as lock_wait.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock = instr::timed_lock(mutex_);
+        wait(not_full_, lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock = instr::timed_lock(mutex_);
+        wait(not_empty_, lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    template <class Ready>
+    static void wait(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, Ready ready) {
+        if (ready()) return;
+        instr::Scope blocked(instr::Stage::LockWait);
+        cv.wait(lock, ready);
+    }
+
+    size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+// A page-aligned buffer holding one chunk of a file
+struct ReadBuffer {
+    static constexpr size_t kAlign = 4096;
+
+    char* data = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t chunk = 0;  // index into the planned chunks
+    bool ok = true;
+
+    ReadBuffer() = default;
+    ReadBuffer(const ReadBuffer&) = delete;
+    ReadBuffer& operator=(const ReadBuffer&) = delete;
+    ~ReadBuffer() { std::free(data); }
+
+    void reserve(size_t bytes) {
+        if (bytes <= capacity) return;
+        std::free(data);
+        capacity = (bytes + kAlign - 1) / kAlign * kAlign;
+        data = static_cast<char*>(std::aligned_alloc(kAlign, capacity));
+    }
+
+    std::string_view view() const { return {data, size}; }
+};
+
+#ifdef READ_PIPELINE_URING
+// Minimal io_uring over the raw system calls (liburing is not required):
+// one submission ring of plain reads and its completion ring.
+class IoUring {
+public:
+    ~IoUring() {
+        if (sqes_) munmap(sqes_, sqes_bytes_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_bytes_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_bytes_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool init(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = int(syscall(__NR_io_uring_setup, entries, &p));
+        if (fd_ < 0) return false;
+
+        sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+
+        sq_ptr_ = map(sq_bytes_, IORING_OFF_SQ_RING);
+        if (!sq_ptr_) return false;
+        cq_ptr_ = single ? sq_ptr_ : map(cq_bytes_, IORING_OFF_CQ_RING);
+        if (!cq_ptr_) return false;
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_bytes_, IORING_OFF_SQES));
+        if (!sqes_) return false;
+
+        char* sq = static_cast<char*>(sq_ptr_);
+        char* cq = static_cast<char*>(cq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        sq_entries_ = p.sq_entries;
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    bool queue_read(int fd, void* buffer, unsigned length, uint64_t offset, uint64_t user_data) {
+        unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) return false;
+        unsigned index = tail & sq_mask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(buffer);
+        sqe.len = length;
+        sqe.off = offset;
+        sqe.user_data = user_data;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        ++to_submit_;
+        return true;
+    }
+
+    // Submits the queued reads and waits for at least min_complete completions
+    bool submit_and_wait(unsigned min_complete) {
+        while (true) {
+            long r = syscall(__NR_io_uring_enter, fd_, to_submit_, min_complete,
+                             min_complete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (r >= 0) {
+                to_submit_ -= unsigned(r);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    bool pop(io_uring_cqe& out) {
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+        out = cqes_[head & cq_mask_];
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    void* map(size_t bytes, uint64_t offset) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, off_t(offset));
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sq_bytes_ = 0, cq_bytes_ = 0, sqes_bytes_ = 0;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0, sq_entries_ = 0;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned to_submit_ = 0;
+};
+#endif
+
+// Read stage of the indexers. One reader thread loads the planned chunks
+// into a fixed pool of aligned buffers, keeping up to queue_depth reads in
+// flight (io_uring when the kernel allows it, blocking pread otherwise), and
+// hands full buffers to the tokenizer threads through a bounded queue.
+// Buffers come back to the pool with release(), so memory stays at
+// (queue_depth + workers) * buffer_bytes however large the corpus is.
+class ReadPipeline {
+public:
+    ReadPipeline(const std::vector<std::string>& files, std::vector<FileChunk> chunks, size_t queue_depth,
+                 size_t workers)
+        : files_(files),
+          chunks_(std::move(chunks)),
+          depth_(std::max<size_t>(1, queue_depth)),
+          free_(depth_ + workers),
+          full_(depth_ + workers) {
+        size_t largest = 0;
+        for (const auto& c : chunks_) largest = std::max<size_t>(largest, c.end - c.begin);
+        buffers_.resize(depth_ + workers);
+        for (auto& b : buffers_) {
+            b = std::make_unique<ReadBuffer>();
+            b->reserve(std::max<size_t>(1, std::min<size_t>(largest, kDefaultChunkBytes)));
+            free_.push(b.get());
+        }
+        remaining_.assign(files_.size(), 0);
+        for (const auto& c : chunks_) remaining_[c.file]++;
+        fds_.assign(files_.size(), -1);
+        reader_ = std::thread([this] { read_all(); });
+    }
+
+    ~ReadPipeline() {
+        if (reader_.joinable()) reader_.join();
+    }
+
+    ReadPipeline(const ReadPipeline&) = delete;
+    ReadPipeline& operator=(const ReadPipeline&) = delete;
+
+    const std::vector<FileChunk>& chunks() const { return chunks_; }
+
+    // Next full buffer (in any chunk order); false when every chunk was delivered
+    bool next(ReadBuffer*& buffer) { return full_.pop(buffer); }
+    void release(ReadBuffer* buffer) { free_.push(buffer); }
+
+    const char* backend() const { return uring_used_ ? "io_uring" : "pread"; }
+
+private:
+    int fd_for(size_t file) {
+        if (fds_[file] < 0) fds_[file] = ::open(files_[file].c_str(), O_RDONLY);
+        return fds_[file];
+    }
+
+    // A chunk is done: close its file after the last one
+    void finish(ReadBuffer* buffer) {
+        size_t file = chunks_[buffer->chunk].file;
+        if (--remaining_[file] == 0 && fds_[file] >= 0) {
+            ::close(fds_[file]);
+            fds_[file] = -1;
+        }
+        instr::add_bytes(buffer->size);
+        full_.push(buffer);
+    }
+
+    void prepare(ReadBuffer* buffer, size_t chunk) {
+        buffer->chunk = chunk;
+        buffer->size = chunks_[chunk].end - chunks_[chunk].begin;
+        buffer->reserve(buffer->size);
+        buffer->ok = true;
+    }
+
+    // Completes a read with pread from `done` bytes on
+    void read_rest(ReadBuffer* buffer, size_t done) {
+        instr::Scope read(instr::Stage::Read);
+        int fd = fd_for(chunks_[buffer->chunk].file);
+        uint64_t offset = chunks_[buffer->chunk].begin;
+        while (fd >= 0 && done < buffer->size) {
+            ssize_t n = pread(fd, buffer->data + done, buffer->size - done, off_t(offset + done));
+            if (n <= 0) break;
+            done += size_t(n);
+        }
+        buffer->ok = fd >= 0 && done == buffer->size;
+        buffer->size = done;
+    }
+
+    void read_all() {
+        instr::set_thread_name("reader");
+#ifdef READ_PIPELINE_URING
+        IoUring ring;
+        if (ring.init(unsigned(std::min<size_t>(depth_, 4096)))) {
+            uring_used_ = true;
+            read_uring(ring);
+            full_.close();
+            return;
+        }
+#endif
+        for (size_t c = 0; c < chunks_.size(); ++c) {
+            ReadBuffer* buffer = nullptr;
+            free_.pop(buffer);
+            prepare(buffer, c);
+            read_rest(buffer, 0);
+            finish(buffer);
+        }
+        full_.close();
+    }
+
+#ifdef READ_PIPELINE_URING
+    void read_uring(IoUring& ring) {
+        size_t next = 0;
+        std::vector<ReadBuffer*> in_flight;
+        while (next < chunks_.size() || !in_flight.empty()) {
+            // Keep up to depth_ reads in flight; block for a buffer only when idle
+            while (next < chunks_.size() && in_flight.size() < depth_) {
+                ReadBuffer* buffer = nullptr;
+                if (in_flight.empty()) free_.pop(buffer);
+                else if (!free_.try_pop(buffer)) break;
+                prepare(buffer, next);
+                int fd = fd_for(chunks_[next].file);
+                if (fd < 0 || buffer->size == 0 ||
+                    !ring.queue_read(fd, buffer->data, unsigned(std::min<size_t>(buffer->size, 1u << 30)),
+                                     chunks_[next].begin, reinterpret_cast<uint64_t>(buffer))) {
+                    read_rest(buffer, 0);
+                    finish(buffer);
+                } else {
+                    in_flight.push_back(buffer);
+                }
+                ++next;
+            }
+            if (in_flight.empty()) continue;
+            bool submitted;
+            {
+                instr::Scope read(instr::Stage::Read);
+                submitted = ring.submit_and_wait(1);
+            }
+            if (!submitted) {
+                // The ring broke: redo its reads and submit nothing more through it
+                uring_used_ = false;
+                for (ReadBuffer* buffer : in_flight) {
+                    read_rest(buffer, 0);
+                    finish(buffer);
+                }
+                break;
+            }
+            io_uring_cqe cqe;
+            while (ring.pop(cqe)) {
+                ReadBuffer* buffer = reinterpret_cast<ReadBuffer*>(cqe.user_data);
+                // Short or failed reads are finished with pread
+                size_t done = cqe.res > 0 ? size_t(cqe.res) : 0;
+                if (done < buffer->size) read_rest(buffer, done);
+                finish(buffer);
+                in_flight.erase(std::find(in_flight.begin(), in_flight.end(), buffer));
+            }
+        }
+        // Without a working ring, finish what is left with blocking reads
+        for (; next < chunks_.size(); ++next) {
+            ReadBuffer* buffer = nullptr;
+            free_.pop(buffer);
+            prepare(buffer, next);
+            read_rest(buffer, 0);
+            finish(buffer);
+        }
+    }
+#endif
+
+    const std::vector<std::string>& files_;
+    std::vector<FileChunk> chunks_;
+    size_t depth_;
+    std::vector<std::unique_ptr<ReadBuffer>> buffers_;
+    BoundedQueue<ReadBuffer*> free_;
+    BoundedQueue<ReadBuffer*> full_;
+    std::vector<size_t> remaining_;
+    std::vector<int> fds_;
+    std::atomic<bool> uring_used_{false};
+    std::thread reader_;
+};
@@ -0,0 +1,274 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TOKENIZER_X86 1
+#endif
+
+// Shared word tokenizer for wordCount and invertedIndex.
+//
+// A word is a run of non-whitespace bytes with every byte that is not an ASCII
+// letter or digit removed, lowercased. "Don't" -> "dont", "x.y" -> "xy", and a
+// token made only of punctuation yields nothing. Classification is done
+// 32 bytes per step by an AVX2 or SSE4.2 kernel picked at runtime, with a
+// scalar fallback that gives identical results.
+namespace tok {
+
+enum class Kernel { Auto, Scalar, SSE42, AVX2 };
+
+inline bool is_space(unsigned char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool is_alnum(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+inline char to_lower(unsigned char c) { return (c >= 'A' && c <= 'Z') ? char(c + 32) : char(c); }
+
+// Normalizes a single token with the same rules the kernels apply.
+inline std::string normalize(std::string_view token) {
+    std::string out;
+    out.reserve(token.size());
+    for (unsigned char c : token) {
+        if (is_alnum(c)) out += to_lower(c);
+    }
+    return out;
+}
+
+// 64-bit hash of a normalized word, 8 bytes per step. Computed by the
+// tokenizer while the word is still in L1 so tables never rehash keys.
+inline uint64_t hash_word(std::string_view s) {
+    const uint64_t m = 0x9E3779B97F4A7C15ull;
+    uint64_t h = s.size() * m;
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        uint64_t v;
+        std::memcpy(&v, s.data() + i, 8);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    if (i < s.size()) {
+        uint64_t v = 0;
+        std::memcpy(&v, s.data() + i, s.size() - i);
+        h = (h ^ v) * m;
+        h ^= h >> 29;
+    }
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    h ^= h >> 32;
+    return h;
+}
+
+namespace detail {
+
+// Classifies n bytes (n <= 32 per mask word): writes lowercased bytes to out,
+// one whitespace bit and one "dropped byte" bit per input byte. Bits past n
+// are marked as whitespace so scans stop there.
+using ClassifyFn = void (*)(const char* in, size_t n, char* out, uint32_t* ws, uint32_t* dirty);
+
+inline void classify_scalar(const char* in, size_t n, char* out, uint32_t* ws, uint32_t* dirty) {
+    for (size_t b = 0; b * 32 < n; ++b) {
+        uint32_t w = 0, d = 0;
+        size_t len = std::min<size_t>(32, n - b * 32);
+        for (size_t j = 0; j < len; ++j) {
+            unsigned char c = in[b * 32 + j];
+            out[b * 32 + j] = to_lower(c);
+            if (is_space(c)) w |= 1u << j;
+            else if (!is_alnum(c)) d |= 1u << j;
+        }
+        if (len < 32) w |= ~0u << len;
+        ws[b] = w;
+        dirty[b] = d;
+    }
+}
+
+#ifdef TOKENIZER_X86
+__attribute__((target("avx2")))
+inline __m256i in_range_avx2(__m256i x, char lo, char hi) {
+    __m256i d = _mm256_sub_epi8(x, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(char(hi - lo))), d);
+}
+
+__attribute__((target("avx2")))
+inline void classify_avx2(const char* in, size_t n, char* out, uint32_t* ws, uint32_t* dirty) {
+    size_t i = 0, b = 0;
+    for (; i + 32 <= n; i += 32, ++b) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i upper = in_range_avx2(x, 'A', 'Z');
+        __m256i alnum = _mm256_or_si256(
+            _mm256_or_si256(upper, in_range_avx2(x, 'a', 'z')), in_range_avx2(x, '0', '9'));
+        __m256i space = _mm256_or_si256(
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), in_range_avx2(x, '\t', '\r'));
+        __m256i lower = _mm256_add_epi8(x, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), lower);
+        ws[b] = uint32_t(_mm256_movemask_epi8(space));
+        dirty[b] = ~uint32_t(_mm256_movemask_epi8(_mm256_or_si256(space, alnum)));
+    }
+    if (i < n) classify_scalar(in + i, n - i, out + i, ws + b, dirty + b);
+}
+
+__attribute__((target("sse4.2")))
+inline __m128i in_range_sse(__m128i x, char lo, char hi) {
+    __m128i d = _mm_sub_epi8(x, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(char(hi - lo))), d);
+}
+
+__attribute__((target("sse4.2")))
+inline void classify_half_sse(const char* in, char* out, uint32_t& ws, uint32_t& keep) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i upper = in_range_sse(x, 'A', 'Z');
+    __m128i alnum = _mm_or_si128(
+        _mm_or_si128(upper, in_range_sse(x, 'a', 'z')), in_range_sse(x, '0', '9'));
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), in_range_sse(x, '\t', '\r'));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_add_epi8(x, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+    ws = uint32_t(_mm_movemask_epi8(space));
+    keep = uint32_t(_mm_movemask_epi8(_mm_or_si128(space, alnum)));
+}
+
+__attribute__((target("sse4.2")))
+inline void classify_sse42(const char* in, size_t n, char* out, uint32_t* ws, uint32_t* dirty) {
+    size_t i = 0, b = 0;
+    for (; i + 32 <= n; i += 32, ++b) {
+        uint32_t ws_lo, ws_hi, keep_lo, keep_hi;
+        classify_half_sse(in + i, out + i, ws_lo, keep_lo);
+        classify_half_sse(in + i + 16, out + i + 16, ws_hi, keep_hi);
+        ws[b] = ws_lo | (ws_hi << 16);
+        dirty[b] = ~(keep_lo | (keep_hi << 16));
+    }
+    if (i < n) classify_scalar(in + i, n - i, out + i, ws + b, dirty + b);
+}
+#endif
+
+inline ClassifyFn select_kernel(Kernel k) {
+#ifdef TOKENIZER_X86
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+    bool sse42 = __builtin_cpu_supports("sse4.2");
+    if ((k == Kernel::Auto || k == Kernel::AVX2) && avx2) return classify_avx2;
+    if ((k == Kernel::Auto || k == Kernel::AVX2 || k == Kernel::SSE42) && sse42) return classify_sse42;
+#else
+    (void)k;
+#endif
+    return classify_scalar;
+}
+
+inline const char* kernel_name(ClassifyFn fn) {
+#ifdef TOKENIZER_X86
+    if (fn == classify_avx2) return "avx2";
+    if (fn == classify_sse42) return "sse4.2";
+#endif
+    (void)fn;
+    return "scalar";
+}
+
+// Index of the first bit >= pos that is set (want_set) or clear in masks,
+// or limit when there is none.
+inline size_t next_bit(const uint32_t* masks, size_t pos, size_t limit, bool want_set) {
+    while (pos < limit) {
+        uint32_t m = masks[pos >> 5];
+        if (!want_set) m = ~m;
+        m &= ~0u << (pos & 31);
+        if (m) return std::min(limit, (pos & ~size_t(31)) + __builtin_ctz(m));
+        pos = (pos & ~size_t(31)) + 32;
+    }
+    return limit;
+}
+
+}  // namespace detail
+
+class Tokenizer {
+public:
+    // Bytes classified per pass; big enough to amortize the scan, small
+    // enough for the scratch buffers to stay in L2.
+    static constexpr size_t kWindow = 1 << 16;
+
+    explicit Tokenizer(Kernel kernel = Kernel::Auto) : classify_(detail::select_kernel(kernel)) {}
+
+    const char* kernel_name() const { return detail::kernel_name(classify_); }
+
+    // Calls fn(std::string_view word) for every word in text. The view is only
+    // valid during the call.
+    template <class Fn>
+    void for_each_word(std::string_view text, Fn&& fn) {
+        size_t base = 0;
+        while (base < text.size()) {
+            size_t end = std::min(text.size(), base + kWindow);
+            if (end < text.size()) {
+                // Back off to the last whitespace so no word is cut in two
+                size_t cut = end;
+                while (cut > base && !is_space(text[cut - 1])) --cut;
+                if (cut > base) {
+                    end = cut;
+                } else {
+                    while (end < text.size() && !is_space(text[end])) ++end;
+                }
+            }
+            scan_window(text.substr(base, end - base), fn);
+            base = end;
+        }
+    }
+
+    // Same as for_each_word, calling fn(std::string_view word, uint64_t hash)
+    template <class Fn>
+    void for_each_hashed_word(std::string_view text, Fn&& fn) {
+        for_each_word(text, [&](std::string_view w) { fn(w, hash_word(w)); });
+    }
+
+    std::vector<std::string> tokenize(std::string_view text) {
+        std::vector<std::string> tokens;
+        for_each_word(text, [&](std::string_view w) { tokens.emplace_back(w); });
+        return tokens;
+    }
+
+private:
+    template <class Fn>
+    void scan_window(std::string_view text, Fn& fn) {
+        size_t n = text.size();
+        size_t blocks = (n + 31) / 32;
+        if (lowered_.size() < n) lowered_.resize(n);
+        if (ws_.size() < blocks) {
+            ws_.resize(blocks);
+            dirty_.resize(blocks);
+        }
+        classify_(text.data(), n, lowered_.data(), ws_.data(), dirty_.data());
+
+        size_t pos = 0;
+        while (true) {
+            pos = detail::next_bit(ws_.data(), pos, n, false);
+            if (pos >= n) break;
+            size_t end = detail::next_bit(ws_.data(), pos, n, true);
+            size_t bad = detail::next_bit(dirty_.data(), pos, end, true);
+            if (bad == end) {
+                fn(std::string_view(lowered_.data() + pos, end - pos));
+            } else {
+                compact_.assign(lowered_.data() + pos, bad - pos);
+                for (size_t i = bad + 1; i < end; ++i) {
+                    if (!(dirty_[i >> 5] >> (i & 31) & 1)) compact_ += lowered_[i];
+                }
+                if (!compact_.empty()) fn(std::string_view(compact_));
+            }
+            pos = end;
+        }
+    }
+
+    static bool is_space(char c) { return tok::is_space(static_cast<unsigned char>(c)); }
+
+    detail::ClassifyFn classify_;
+    std::string lowered_;
+    std::string compact_;
+    std::vector<uint32_t> ws_;
+    std::vector<uint32_t> dirty_;
+};
+
+// Tokenizer owned by the calling thread, for code that has no natural place
+// to keep one.
+inline Tokenizer& thread_tokenizer() {
+    thread_local Tokenizer tokenizer;
+    return tokenizer;
+}
+
+}  // namespace tok
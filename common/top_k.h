@@ -0,0 +1,166 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Keeps only the first k elements of v in cmp order, sorted. Partial select
+// instead of sorting every element when only the head is wanted.
+template <class T, class Cmp>
+void keep_top(std::vector<T>& v, size_t k, Cmp cmp) {
+    if (k == 0 || k >= v.size()) {
+        std::sort(v.begin(), v.end(), cmp);
+        return;
+    }
+    std::nth_element(v.begin(), v.begin() + k, v.end(), cmp);
+    v.resize(k);
+    std::sort(v.begin(), v.end(), cmp);
+}
+
+// Space-Saving heavy hitters summary (Metwally et al.) with a fixed number
+// of counters, so memory does not depend on the vocabulary size.
+//
+// For every reported word: true count <= count and true count >= count - error,
+// with error <= total() / capacity(). Any word whose true count exceeds
+// total() / capacity() is guaranteed to be in the summary.
+class SpaceSaving {
+public:
+    struct Counter {
+        std::string word;
+        uint64_t count = 0;
+        uint64_t error = 0;
+    };
+
+    explicit SpaceSaving(size_t capacity) : capacity_(std::max<size_t>(1, capacity)) {
+        slots_.resize(capacity_);
+        index_.reserve(capacity_ * 2);
+    }
+
+    void add(std::string_view word, uint64_t n = 1) {
+        total_ += n;
+        auto it = index_.find(word);
+        if (it != index_.end()) {
+            slots_[it->second].count += n;
+            sift_down(pos_[it->second]);
+            return;
+        }
+        if (heap_.size() < capacity_) {
+            uint32_t slot = uint32_t(heap_.size());
+            slots_[slot] = Counter{std::string(word), n, 0};
+            index_.emplace(slots_[slot].word, slot);
+            pos_.push_back(heap_.size());
+            heap_.push_back(slot);
+            sift_up(heap_.size() - 1);
+            return;
+        }
+        // Evict the smallest counter; the newcomer inherits its count as error
+        uint32_t slot = heap_[0];
+        Counter& c = slots_[slot];
+        index_.erase(c.word);
+        c.word.assign(word);
+        c.error = c.count;
+        c.count += n;
+        index_.emplace(c.word, slot);
+        sift_down(0);
+    }
+
+    // Merges another summary (Berinde et al.): a word missing from one side
+    // may have occurred up to that side's minimum count there, so it is added
+    // to both its count and its error. The largest capacity() counters are kept.
+    void merge(const SpaceSaving& other) {
+        uint64_t min_this = min_count();
+        uint64_t min_other = other.min_count();
+        std::vector<Counter> combined;
+        combined.reserve(heap_.size() + other.heap_.size());
+        for (uint32_t slot : heap_) {
+            const Counter& c = slots_[slot];
+            auto it = other.index_.find(c.word);
+            if (it != other.index_.end()) {
+                const Counter& o = other.slots_[it->second];
+                combined.push_back({c.word, c.count + o.count, c.error + o.error});
+            } else {
+                combined.push_back({c.word, c.count + min_other, c.error + min_other});
+            }
+        }
+        for (uint32_t slot : other.heap_) {
+            const Counter& o = other.slots_[slot];
+            if (index_.count(o.word)) continue;
+            combined.push_back({o.word, o.count + min_this, o.error + min_this});
+        }
+        uint64_t total = total_ + other.total_;
+        keep_top(combined, capacity_, [](const Counter& a, const Counter& b) {
+            return a.count > b.count || (a.count == b.count && a.word < b.word);
+        });
+
+        index_.clear();
+        heap_.clear();
+        pos_.clear();
+        total_ = 0;
+        for (auto& c : combined) {
+            uint32_t slot = uint32_t(heap_.size());
+            slots_[slot] = std::move(c);
+            index_.emplace(slots_[slot].word, slot);
+            pos_.push_back(heap_.size());
+            heap_.push_back(slot);
+            sift_up(heap_.size() - 1);
+        }
+        total_ = total;
+    }
+
+    // Counters sorted by estimated count, descending
+    std::vector<Counter> counters() const {
+        std::vector<Counter> out;
+        out.reserve(heap_.size());
+        for (uint32_t slot : heap_) out.push_back(slots_[slot]);
+        std::sort(out.begin(), out.end(), [](const Counter& a, const Counter& b) {
+            return a.count > b.count || (a.count == b.count && a.word < b.word);
+        });
+        return out;
+    }
+
+    uint64_t total() const { return total_; }
+    size_t capacity() const { return capacity_; }
+    size_t size() const { return heap_.size(); }
+    // Upper bound on the error of any counter
+    uint64_t max_error() const { return total_ / capacity_; }
+    uint64_t min_count() const { return heap_.size() < capacity_ ? 0 : slots_[heap_[0]].count; }
+
+private:
+    // Min-heap of slot indices by count; pos_ maps a slot back to its heap position
+    bool less(size_t a, size_t b) const { return slots_[heap_[a]].count < slots_[heap_[b]].count; }
+
+    void swap_nodes(size_t a, size_t b) {
+        std::swap(heap_[a], heap_[b]);
+        pos_[heap_[a]] = a;
+        pos_[heap_[b]] = b;
+    }
+
+    void sift_up(size_t i) {
+        while (i > 0 && less(i, (i - 1) / 2)) {
+            swap_nodes(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+
+    void sift_down(size_t i) {
+        while (true) {
+            size_t smallest = i, l = 2 * i + 1, r = l + 1;
+            if (l < heap_.size() && less(l, smallest)) smallest = l;
+            if (r < heap_.size() && less(r, smallest)) smallest = r;
+            if (smallest == i) return;
+            swap_nodes(i, smallest);
+            i = smallest;
+        }
+    }
+
+    size_t capacity_;
+    uint64_t total_ = 0;
+    std::vector<Counter> slots_;
+    std::vector<uint32_t> heap_;
+    std::vector<size_t> pos_;
+    // Keys view the words stored in slots_, which never move
+    std::unordered_map<std::string_view, uint32_t> index_;
+};
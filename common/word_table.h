@@ -0,0 +1,260 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "tokenizer.h"
+
+// Bump allocator for interned keys. Memory is released only when the arena
+// is destroyed, so views handed out stay valid for its whole lifetime.
+class Arena {
+public:
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept { *this = std::move(other); }
+    Arena& operator=(Arena&& other) noexcept {
+        blocks_ = std::move(other.blocks_);
+        cur_ = other.cur_;
+        left_ = other.left_;
+        reserved_ = other.reserved_;
+        other.blocks_.clear();
+        other.cur_ = nullptr;
+        other.left_ = 0;
+        other.reserved_ = 0;
+        return *this;
+    }
+
+    std::string_view intern(std::string_view s) {
+        if (s.size() > left_) grow(s.size());
+        char* dst = cur_;
+        std::memcpy(dst, s.data(), s.size());
+        cur_ += s.size();
+        left_ -= s.size();
+        return {dst, s.size()};
+    }
+
+    size_t bytes_reserved() const { return reserved_; }
+
+private:
+    void grow(size_t need) {
+        size_t size = std::max(kBlockSize, need);
+        blocks_.emplace_back(new char[size]);
+        cur_ = blocks_.back().get();
+        left_ = size;
+        reserved_ += size;
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cur_ = nullptr;
+    size_t left_ = 0;
+    size_t reserved_ = 0;
+};
+
+// Flat open-addressing word counter (Swiss-table layout).
+//
+// One control byte per slot holds a 7-bit tag of the hash (or kEmpty);
+// probing compares 16 control bytes at once, so most lookups touch one
+// cache line of control bytes and the matching slot. Keys live in an Arena,
+// either the table's own or one shared by all tables of a thread. Hashes
+// come from tok::hash_word and are stored, so growing never rehashes keys.
+// Count selects the counter width (uint32_t halves the slot payload).
+template <class Count = uint64_t>
+class WordTable {
+public:
+    struct Entry {
+        std::string_view word;
+        Count count;
+    };
+
+    explicit WordTable(Arena* arena = nullptr, size_t expected = 0)
+        : arena_(arena ? arena : &own_arena_) {
+        rehash(capacity_for(expected));
+    }
+
+    WordTable(const WordTable&) = delete;
+    WordTable& operator=(const WordTable&) = delete;
+    WordTable(WordTable&& other) noexcept { *this = std::move(other); }
+    WordTable& operator=(WordTable&& other) noexcept {
+        bool owns = other.arena_ == &other.own_arena_;
+        own_arena_ = std::move(other.own_arena_);
+        arena_ = owns ? &own_arena_ : other.arena_;
+        ctrl_ = std::move(other.ctrl_);
+        slots_ = std::move(other.slots_);
+        size_ = other.size_;
+        mask_ = other.mask_;
+        other.size_ = 0;
+        other.rehash(kGroup);
+        return *this;
+    }
+
+    void add_hashed(std::string_view word, uint64_t hash, Count n = 1) {
+        Slot& slot = find_or_insert(word, hash);
+        slot.count += n;
+    }
+    void add(std::string_view word, Count n = 1) { add_hashed(word, tok::hash_word(word), n); }
+
+    // Value slot of word, inserted as 0 the first time it is seen. Lets the
+    // table map keys to ids; the reference is valid until the next insertion.
+    Count& value_hashed(std::string_view word, uint64_t hash) { return find_or_insert(word, hash).count; }
+
+    // Count for word, or 0 when it has not been seen
+    Count count_hashed(std::string_view word, uint64_t hash) const {
+        const Slot* slot = find(word, hash);
+        return slot ? slot->count : 0;
+    }
+    Count count(std::string_view word) const { return count_hashed(word, tok::hash_word(word)); }
+
+    // Starts loading the control group a lookup of hash probes first, so a
+    // batch of lookups overlaps its cache misses
+    void prefetch(uint64_t hash) const {
+        size_t g = (hash >> 7) & mask_;
+        __builtin_prefetch(ctrl_.data() + g);
+        __builtin_prefetch(slots_.data() + g);
+    }
+
+    // Adds every entry of other, reusing its stored hashes
+    template <class OtherCount>
+    void merge(const WordTable<OtherCount>& other) {
+        other.for_each_hashed([&](std::string_view word, uint64_t hash, OtherCount n) {
+            add_hashed(word, hash, Count(n));
+        });
+    }
+
+    void reserve(size_t expected) {
+        size_t cap = capacity_for(expected);
+        if (cap > ctrl_.size()) rehash(cap);
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    template <class Fn>
+    void for_each(Fn&& fn) const {
+        for (size_t i = 0; i < ctrl_.size(); ++i) {
+            if (ctrl_[i] != kEmpty) fn(slots_[i].word(), slots_[i].count);
+        }
+    }
+
+    template <class Fn>
+    void for_each_hashed(Fn&& fn) const {
+        for (size_t i = 0; i < ctrl_.size(); ++i) {
+            if (ctrl_[i] != kEmpty) fn(slots_[i].word(), slots_[i].hash, slots_[i].count);
+        }
+    }
+
+    std::vector<Entry> entries() const {
+        std::vector<Entry> out;
+        out.reserve(size_);
+        for_each([&](std::string_view word, Count n) { out.push_back({word, n}); });
+        return out;
+    }
+
+private:
+    template <class> friend class WordTable;
+
+    static constexpr size_t kGroup = 16;
+    static constexpr int8_t kEmpty = -128;
+
+    struct Slot {
+        uint64_t hash;
+        const char* key;
+        uint32_t len;
+        Count count;
+        std::string_view word() const { return {key, len}; }
+    };
+
+    static size_t capacity_for(size_t expected) {
+        size_t cap = kGroup;
+        while (cap * 7 / 8 < expected) cap *= 2;
+        return cap;
+    }
+
+    static int8_t tag(uint64_t hash) { return int8_t(hash & 0x7F); }
+
+    // Bitmask of slots in the group starting at g whose control byte equals c
+    uint32_t match(size_t g, int8_t c) const {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl_.data() + g));
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(c))));
+#else
+        uint32_t bits = 0;
+        for (size_t j = 0; j < kGroup; ++j) bits |= uint32_t(ctrl_[g + j] == c) << j;
+        return bits;
+#endif
+    }
+
+    const Slot* find(std::string_view word, uint64_t hash) const {
+        size_t g = (hash >> 7) & mask_;
+        for (size_t step = kGroup;; step += kGroup) {
+            for (uint32_t m = match(g, tag(hash)); m; m &= m - 1) {
+                const Slot& slot = slots_[g + __builtin_ctz(m)];
+                if (slot.hash == hash && slot.word() == word) return &slot;
+            }
+            if (match(g, kEmpty)) return nullptr;
+            g = (g + step) & mask_;
+        }
+    }
+
+    Slot& find_or_insert(std::string_view word, uint64_t hash) {
+        size_t g = (hash >> 7) & mask_;
+        for (size_t step = kGroup;; step += kGroup) {
+            for (uint32_t m = match(g, tag(hash)); m; m &= m - 1) {
+                Slot& slot = slots_[g + __builtin_ctz(m)];
+                if (slot.hash == hash && slot.word() == word) return slot;
+            }
+            if (uint32_t empty = match(g, kEmpty)) {
+                if ((size_ + 1) * 8 > ctrl_.size() * 7) {
+                    rehash(ctrl_.size() * 2);
+                    return find_or_insert(word, hash);
+                }
+                // First time this word is seen: copy its bytes into the arena
+                size_t i = g + __builtin_ctz(empty);
+                std::string_view key = arena_->intern(word);
+                ctrl_[i] = tag(hash);
+                slots_[i] = Slot{hash, key.data(), uint32_t(key.size()), 0};
+                ++size_;
+                return slots_[i];
+            }
+            g = (g + step) & mask_;
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<int8_t> old_ctrl = std::move(ctrl_);
+        std::vector<Slot> old_slots = std::move(slots_);
+        ctrl_.assign(capacity, kEmpty);
+        slots_.assign(capacity, Slot{});
+        // Probes move group by group, so mask_ keeps group-aligned starts
+        mask_ = (capacity - 1) & ~(kGroup - 1);
+        for (size_t i = 0; i < old_ctrl.size(); ++i) {
+            if (old_ctrl[i] == kEmpty) continue;
+            const Slot& slot = old_slots[i];
+            size_t g = (slot.hash >> 7) & mask_;
+            for (size_t step = kGroup;; step += kGroup) {
+                if (uint32_t empty = match(g, kEmpty)) {
+                    size_t j = g + __builtin_ctz(empty);
+                    ctrl_[j] = tag(slot.hash);
+                    slots_[j] = slot;
+                    break;
+                }
+                g = (g + step) & mask_;
+            }
+        }
+    }
+
+    Arena own_arena_;
+    Arena* arena_ = nullptr;
+    std::vector<int8_t> ctrl_;
+    std::vector<Slot> slots_;
+    size_t size_ = 0;
+    size_t mask_ = 0;
+};
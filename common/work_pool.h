@@ -0,0 +1,61 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "instrument.h"
+
+// Runs fn(task, worker) for every task in [0, num_tasks) on num_threads
+// threads. Each worker starts with a contiguous slice of task ids (so the
+// chunks of one file stay on one core) and takes from the front of its own
+// deque; when it runs dry it steals from the back of another worker's deque,
+// so one slow file no longer holds the whole run back.
+template <class Fn>
+void run_work_stealing(size_t num_tasks, size_t num_threads, Fn&& fn) {
+    if (num_tasks == 0) return;
+    num_threads = std::max<size_t>(1, std::min(num_threads, num_tasks));
+
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+    std::vector<Queue> queues(num_threads);
+    for (size_t w = 0; w < num_threads; ++w) {
+        size_t first = num_tasks * w / num_threads;
+        size_t last = num_tasks * (w + 1) / num_threads;
+        for (size_t t = first; t < last; ++t) queues[w].tasks.push_back(t);
+    }
+
+    auto take = [&](size_t worker, size_t& task) {
+        {
+            auto lock = instr::timed_lock(queues[worker].mutex);
+            if (!queues[worker].tasks.empty()) {
+                task = queues[worker].tasks.front();
+                queues[worker].tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < num_threads; ++i) {
+            Queue& victim = queues[(worker + i) % num_threads];
+            auto lock = instr::timed_lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;  // tasks are never added, so empty everywhere means done
+    };
+
+    auto work = [&](size_t worker) {
+        size_t task;
+        while (take(worker, task)) fn(task, worker);
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 1; w < num_threads; ++w) threads.emplace_back(work, w);
+    work(0);
+    for (auto& t : threads) t.join();
+}
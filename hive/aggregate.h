@@ -0,0 +1,360 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/instrument.h"
+#include "../common/tokenizer.h"
+#include "../common/word_table.h"
+#include "../common/work_pool.h"
+#include "table.h"
+
+// GROUP BY con COUNT/SUM/AVG/MIN/MAX sobre tablas de texto, sin la JVM.
+//
+// Cada hilo parsea sus trozos y agrega en un Partial propio: las filas se
+// juntan en lotes de kBatch claves; el lote calcula todos los hashes, luego
+// resuelve el id de grupo de cada clave en una WordTable (la tabla de
+// wordCount) y al final recorre cada agregado por separado sobre el lote, un
+// bucle por tipo sin saltos por fila. La unión final reparte los grupos por
+// hash en fragmentos que se combinan en paralelo reutilizando los hashes
+// guardados.
+namespace aggregate {
+
+constexpr size_t kBatch = 256;
+
+enum class Func { Count, Sum, Avg, Min, Max };
+
+// column = -1 es COUNT(*) / COUNT(1): cuenta filas en vez de valores no nulos
+struct Spec {
+    Func func = Func::Count;
+    int column = -1;
+};
+
+// "count(*)", "sum(visitas)", ... -> Spec, o nada si no se reconoce
+inline std::optional<Spec> parseSpec(std::string_view text, const table::Schema& schema) {
+    size_t open = text.find('('), close = text.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open) return std::nullopt;
+    std::string name(text.substr(0, open));
+    for (char& c : name) c = char(std::tolower(static_cast<unsigned char>(c)));
+    std::string_view argument = text.substr(open + 1, close - open - 1);
+    while (!argument.empty() && argument.front() == ' ') argument.remove_prefix(1);
+    while (!argument.empty() && argument.back() == ' ') argument.remove_suffix(1);
+
+    Spec spec;
+    if (name == "count") spec.func = Func::Count;
+    else if (name == "sum") spec.func = Func::Sum;
+    else if (name == "avg") spec.func = Func::Avg;
+    else if (name == "min") spec.func = Func::Min;
+    else if (name == "max") spec.func = Func::Max;
+    else return std::nullopt;
+    if (spec.func == Func::Count && (argument == "*" || argument == "1")) return spec;
+    spec.column = schema.find(argument);
+    if (spec.column < 0) return std::nullopt;
+    return spec;
+}
+
+// Cómo se lee la columna de un agregado: SUM y AVG de una cadena la
+// convierten a double, como Hive
+enum class Input { Rows, Int, Double, Text };
+
+inline Input inputOf(const Spec& spec, const table::Schema& schema) {
+    if (spec.column < 0) return Input::Rows;
+    table::Type type = schema.columns[size_t(spec.column)].type;
+    if (type == table::Type::Int) return Input::Int;
+    if (type == table::Type::Double || spec.func == Func::Sum || spec.func == Func::Avg) return Input::Double;
+    return Input::Text;
+}
+
+// Estado de un agregado en un grupo
+struct State {
+    int64_t count = 0;  // filas o valores no nulos
+    int64_t intSum = 0;
+    double sum = 0;
+    int64_t intMin = std::numeric_limits<int64_t>::max();
+    int64_t intMax = std::numeric_limits<int64_t>::min();
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    std::string_view textMin, textMax;
+};
+
+// Suma b en a; las cadenas de b se copian en arena
+inline void combine(State& a, const State& b, Input input, Arena& arena) {
+    if (b.count == 0) return;
+    if (input == Input::Text) {
+        if (a.count == 0 || b.textMin < a.textMin) a.textMin = arena.intern(b.textMin);
+        if (a.count == 0 || b.textMax > a.textMax) a.textMax = arena.intern(b.textMax);
+    }
+    a.count += b.count;
+    a.intSum += b.intSum;
+    a.sum += b.sum;
+    a.intMin = std::min(a.intMin, b.intMin);
+    a.intMax = std::max(a.intMax, b.intMax);
+    a.min = std::min(a.min, b.min);
+    a.max = std::max(a.max, b.max);
+}
+
+inline table::Value finish(const State& s, Func func, Input input) {
+    using table::Value;
+    if (func == Func::Count) return Value::ofInt(s.count);
+    if (s.count == 0) return Value::null();
+    switch (func) {
+    case Func::Sum: return input == Input::Int ? Value::ofInt(s.intSum) : Value::ofDouble(s.sum);
+    case Func::Avg: return Value::ofDouble((input == Input::Int ? double(s.intSum) : s.sum) / double(s.count));
+    case Func::Min:
+        return input == Input::Int ? Value::ofInt(s.intMin)
+               : input == Input::Text ? Value::ofString(s.textMin) : Value::ofDouble(s.min);
+    case Func::Max:
+        return input == Input::Int ? Value::ofInt(s.intMax)
+               : input == Input::Text ? Value::ofString(s.textMax) : Value::ofDouble(s.max);
+    default: return Value::null();
+    }
+}
+
+// Separa las columnas de una clave compuesta
+constexpr char kKeySeparator = '\0';
+
+// Agregación de un hilo
+class Partial {
+public:
+    // filter descarta filas antes de agregar (WHERE); addChunk solo separa
+    // las columnas que usan las claves, los agregados y el filtro
+    Partial(const table::Schema& schema, std::vector<int> keys, std::vector<Spec> specs,
+            table::RowFilter filter = {})
+        : schema_(&schema), keys_(std::move(keys)), specs_(std::move(specs)), filter_(std::move(filter)) {
+        for (const Spec& spec : specs_) inputs_.push_back(inputOf(spec, schema));
+        values_.resize(specs_.size());
+        for (auto& v : values_) v.reserve(kBatch);
+        scanColumns_ = filter_.keep ? filter_.columns : 0;
+        for (int k : keys_) scanColumns_ = std::max(scanColumns_, size_t(k) + 1);
+        for (const Spec& spec : specs_) scanColumns_ = std::max(scanColumns_, size_t(spec.column + 1));
+    }
+
+    // Agrega todas las líneas de text
+    void addChunk(std::string_view text) {
+        uint64_t rows = 0;
+        table::forEachLine(text, [&](std::string_view line) {
+            table::splitRow(line, *schema_, row_, scanColumns_);
+            ++rows;
+            if (filter_(row_)) add(row_);
+        });
+        flush();
+        instr::add_tokens(rows);
+    }
+
+    // Agrega una fila ya separada. Sus campos se leen al vaciar el lote, así
+    // que el texto al que apuntan debe vivir hasta el siguiente flush().
+    void add(const table::Row& row) {
+        if (keys_.size() == 1) {
+            batchKeys_.push_back(field(row, size_t(keys_[0])));
+        } else {
+            // Claves compuestas: se copian a keyText_ y se apuntan al vaciar el lote
+            size_t begin = keyText_.size();
+            for (size_t k = 0; k < keys_.size(); ++k) {
+                if (k) keyText_ += kKeySeparator;
+                keyText_ += field(row, size_t(keys_[k]));
+            }
+            keyBounds_.push_back({begin, keyText_.size()});
+            batchKeys_.emplace_back();
+        }
+        for (size_t s = 0; s < specs_.size(); ++s) {
+            values_[s].push_back(specs_[s].column < 0 ? std::string_view() : field(row, size_t(specs_[s].column)));
+        }
+        if (batchKeys_.size() == kBatch) flush();
+    }
+
+    // Agrega el lote en curso
+    void flush() {
+        size_t n = batchKeys_.size();
+        if (n == 0) return;
+        {
+            instr::Scope scope(instr::Stage::Insert);
+            for (size_t i = 0; i < keyBounds_.size(); ++i) {
+                batchKeys_[i] = std::string_view(keyText_).substr(keyBounds_[i].first,
+                                                                   keyBounds_[i].second - keyBounds_[i].first);
+            }
+            hashes_.resize(n);
+            groupIds_.resize(n);
+            for (size_t i = 0; i < n; ++i) hashes_[i] = tok::hash_word(batchKeys_[i]);
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t& id = table_.value_hashed(batchKeys_[i], hashes_[i]);
+                if (id == 0) {
+                    id = uint32_t(table_.size());
+                    states_.resize(table_.size() * specs_.size());
+                }
+                groupIds_[i] = id - 1;
+            }
+            for (size_t s = 0; s < specs_.size(); ++s) update(s);
+        }
+        batchKeys_.clear();
+        keyBounds_.clear();
+        keyText_.clear();
+        for (auto& v : values_) v.clear();
+    }
+
+    size_t groups() const { return table_.size(); }
+    const table::Schema& schema() const { return *schema_; }
+    const std::vector<int>& keys() const { return keys_; }
+    const std::vector<Spec>& specs() const { return specs_; }
+    const std::vector<Input>& inputs() const { return inputs_; }
+
+    // fn(clave, hash, estados del grupo) por cada grupo
+    template <class Fn>
+    void forEachGroup(Fn&& fn) const {
+        table_.for_each_hashed([&](std::string_view key, uint64_t hash, uint32_t id) {
+            fn(key, hash, &states_[size_t(id - 1) * specs_.size()]);
+        });
+    }
+
+private:
+    static std::string_view field(const table::Row& row, size_t column) {
+        return row.isNull(column) ? table::kNullText : row[column];
+    }
+
+    // Un agregado sobre todo el lote
+    void update(size_t s) {
+        const size_t stride = specs_.size();
+        const std::vector<std::string_view>& values = values_[s];
+        State* states = states_.data() + s;
+        size_t n = values.size();
+        switch (inputs_[s]) {
+        case Input::Rows:
+            for (size_t i = 0; i < n; ++i) states[groupIds_[i] * stride].count++;
+            break;
+        case Input::Int:
+            for (size_t i = 0; i < n; ++i) {
+                auto v = table::toInt(values[i]);
+                if (!v) continue;
+                State& st = states[groupIds_[i] * stride];
+                st.count++;
+                st.intSum += *v;
+                st.intMin = std::min(st.intMin, *v);
+                st.intMax = std::max(st.intMax, *v);
+            }
+            break;
+        case Input::Double:
+            for (size_t i = 0; i < n; ++i) {
+                auto v = table::toDouble(values[i]);
+                if (!v) continue;
+                State& st = states[groupIds_[i] * stride];
+                st.count++;
+                st.sum += *v;
+                st.min = std::min(st.min, *v);
+                st.max = std::max(st.max, *v);
+            }
+            break;
+        case Input::Text: {
+            Func func = specs_[s].func;
+            for (size_t i = 0; i < n; ++i) {
+                if (values[i] == table::kNullText) continue;
+                State& st = states[groupIds_[i] * stride];
+                bool first = st.count++ == 0;
+                if (func == Func::Min && (first || values[i] < st.textMin)) st.textMin = texts_.intern(values[i]);
+                if (func == Func::Max && (first || values[i] > st.textMax)) st.textMax = texts_.intern(values[i]);
+            }
+            break;
+        }
+        }
+    }
+
+    const table::Schema* schema_;
+    std::vector<int> keys_;
+    std::vector<Spec> specs_;
+    std::vector<Input> inputs_;
+    table::RowFilter filter_;
+    size_t scanColumns_ = 0;
+
+    WordTable<uint32_t> table_;   // clave -> id de grupo + 1
+    std::vector<State> states_;   // grupo * specs_.size() + agregado
+    Arena texts_;                 // MIN/MAX de cadenas
+
+    // Lote en curso
+    table::Row row_;
+    std::vector<std::string_view> batchKeys_;
+    std::string keyText_;
+    std::vector<std::pair<size_t, size_t>> keyBounds_;
+    std::vector<std::vector<std::string_view>> values_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> groupIds_;
+};
+
+// Une los parciales en numThreads hilos. Cada fila del resultado trae las
+// columnas de la clave y luego un valor por agregado.
+inline std::vector<table::ResultRow> merge(const std::vector<Partial>& partials, size_t numThreads) {
+    if (partials.empty()) return {};
+    instr::Scope scope(instr::Stage::Merge);
+    const Partial& first = partials.front();
+    const table::Schema& schema = first.schema();
+    const std::vector<int>& keys = first.keys();
+    const std::vector<Spec>& specs = first.specs();
+    const std::vector<Input>& inputs = first.inputs();
+    const size_t stride = specs.size();
+
+    size_t numShards = std::max<size_t>(1, numThreads) * 4;
+    std::vector<std::vector<table::ResultRow>> shardRows(numShards);
+    run_work_stealing(numShards, numThreads, [&](size_t shard, size_t) {
+        WordTable<uint32_t> merged;
+        std::vector<State> states;
+        Arena texts;
+        for (const Partial& partial : partials) {
+            partial.forEachGroup([&](std::string_view key, uint64_t hash, const State* partialStates) {
+                if ((hash >> 40) % numShards != shard) return;
+                uint32_t& id = merged.value_hashed(key, hash);
+                if (id == 0) {
+                    id = uint32_t(merged.size());
+                    states.resize(merged.size() * stride);
+                }
+                State* target = &states[size_t(id - 1) * stride];
+                for (size_t s = 0; s < stride; ++s) combine(target[s], partialStates[s], inputs[s], texts);
+            });
+        }
+
+        auto& rows = shardRows[shard];
+        rows.reserve(merged.size());
+        merged.for_each([&](std::string_view key, uint32_t id) {
+            table::ResultRow row;
+            size_t begin = 0;
+            for (size_t k = 0; k < keys.size(); ++k) {
+                size_t end = k + 1 < keys.size() ? key.find(kKeySeparator, begin) : key.size();
+                row.push_back(table::parseValue(key.substr(begin, end - begin),
+                                                schema.columns[size_t(keys[k])].type));
+                begin = end + 1;
+            }
+            const State* groupStates = &states[size_t(id - 1) * stride];
+            for (size_t s = 0; s < stride; ++s) row.push_back(finish(groupStates[s], specs[s].func, inputs[s]));
+            rows.push_back(std::move(row));
+        });
+    });
+
+    std::vector<table::ResultRow> rows;
+    for (auto& part : shardRows) {
+        std::move(part.begin(), part.end(), std::back_inserter(rows));
+    }
+    // Sin GROUP BY hay una fila aunque la tabla esté vacía (COUNT(*) = 0)
+    if (keys.empty() && rows.empty()) {
+        table::ResultRow row;
+        for (size_t s = 0; s < stride; ++s) row.push_back(finish(State{}, specs[s].func, inputs[s]));
+        rows.push_back(std::move(row));
+    }
+    instr::add_unique_keys(rows.size());
+    return rows;
+}
+
+// SELECT claves, agregados FROM files [WHERE filter] GROUP BY claves
+inline std::vector<table::ResultRow> groupBy(const std::vector<std::string>& files, const table::Schema& schema,
+                                             const std::vector<int>& keys, const std::vector<Spec>& specs,
+                                             size_t numThreads, const table::RowFilter& filter = {},
+                                             uint64_t chunkBytes = kDefaultChunkBytes) {
+    numThreads = std::max<size_t>(1, numThreads);
+    std::vector<Partial> partials;
+    for (size_t t = 0; t < numThreads; ++t) partials.emplace_back(schema, keys, specs, filter);
+    table::scanChunks(files, numThreads, [&](std::string_view text, size_t worker) {
+        partials[worker].addChunk(text);
+    }, chunkBytes);
+    return merge(partials, numThreads);
+}
+
+}  // namespace aggregate
@@ -0,0 +1,641 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/instrument.h"
+#include "../common/mapped_file.h"
+#include "../common/tokenizer.h"
+#include "../common/word_table.h"
+#include "../common/work_pool.h"
+#include "aggregate.h"
+#include "table.h"
+
+// Formato columnar de las tablas de hive/.
+//
+//   [Cabecera 64 bytes]
+//   [Datos]        por bloque de kBlockRows filas y por columna, un arreglo
+//                  alineado a 8 bytes: u32 ids de diccionario (cadenas),
+//                  i64 (enteros) o f64 (doubles)
+//   [Esquema]      por columna: u8 tipo, u32 largo del nombre, nombre
+//   [Bloques]      por bloque u64 filas y por columna un ColumnBlock con
+//                  offset, nulos y el mapa de zona (mínimo y máximo)
+//   [Diccionarios] u64 offset por columna (0 si no es de cadenas); cada
+//                  diccionario es u64 n, u64 offsets[n + 1] y los bytes
+//
+// Las cadenas se guardan una vez por columna y las filas solo llevan su id,
+// así que los ids de usuario y las URLs repetidas ocupan 4 bytes. Los
+// nulos son kNullId, kNullInt o el NaN kNullDoubleBits. El archivo se lee
+// con mmap y los arreglos se usan sin copiarlos.
+namespace columnar {
+
+constexpr char kMagic[8] = {'B', 'D', 'C', 'O', 'L', 0, 0, 1};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kBlockRows = 64 * 1024;
+
+constexpr uint32_t kNullId = std::numeric_limits<uint32_t>::max();
+constexpr int64_t kNullInt = std::numeric_limits<int64_t>::min();
+constexpr uint64_t kNullDoubleBits = 0x7FF80000DEADBEEFull;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t numColumns;
+    uint64_t numRows;
+    uint64_t numBlocks;
+    uint64_t schemaOffset;
+    uint64_t blocksOffset;
+    uint64_t dictOffset;
+    uint64_t reserved;
+};
+static_assert(sizeof(Header) == kHeaderSize, "cabecera de 64 bytes");
+
+// Columna de un bloque. min y max son i64, los bits de un f64 o ids de
+// diccionario (la menor y la mayor cadena del bloque) según el tipo; sin
+// valores no nulos valen lo que dejó el escritor y nulls == filas.
+struct ColumnBlock {
+    uint64_t offset;
+    uint64_t nulls;
+    uint64_t min;
+    uint64_t max;
+};
+
+inline bool isNull(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, 8);
+    return bits == kNullDoubleBits;
+}
+
+inline double nullDouble() {
+    double v;
+    std::memcpy(&v, &kNullDoubleBits, 8);
+    return v;
+}
+
+inline uint64_t bitsOf(double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, 8);
+    return bits;
+}
+
+inline double doubleOf(uint64_t bits) {
+    double v;
+    std::memcpy(&v, &bits, 8);
+    return v;
+}
+
+inline void putU64(std::string& out, uint64_t v) { out.append(reinterpret_cast<const char*>(&v), 8); }
+
+inline uint64_t getU64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+// Cómo se lee cada campo de texto al convertir. Clock es una hora "H:MM" o
+// "H:MM:SS" y se guarda como segundos desde medianoche.
+enum class Parse { Text, Int, Double, Clock };
+
+struct ColumnSpec {
+    std::string name;
+    Parse parse = Parse::Text;
+};
+
+inline table::Type storedType(Parse parse) {
+    switch (parse) {
+    case Parse::Text: return table::Type::String;
+    case Parse::Double: return table::Type::Double;
+    default: return table::Type::Int;
+    }
+}
+
+inline std::optional<int64_t> parseClock(std::string_view s) {
+    int64_t seconds = 0;
+    int parts = 0;
+    size_t begin = 0;
+    while (begin <= s.size()) {
+        size_t end = s.find(':', begin);
+        if (end == std::string_view::npos) end = s.size();
+        auto v = table::toInt(s.substr(begin, end - begin));
+        if (!v || *v < 0 || (parts > 0 && *v >= 60)) return std::nullopt;
+        seconds = seconds * 60 + *v;
+        ++parts;
+        begin = end + 1;
+    }
+    if (parts == 2) seconds *= 60;
+    if (parts < 2 || parts > 3) return std::nullopt;
+    return seconds;
+}
+
+// Escribe una tabla fila a fila; guarda en memoria un solo bloque por columna
+class Writer {
+public:
+    bool open(const std::string& path, const std::vector<ColumnSpec>& columns, size_t blockRows = kBlockRows) {
+        out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!out_) return false;
+        columns_ = columns;
+        blockRows_ = std::max<size_t>(1, blockRows);
+        state_.clear();
+        state_.resize(columns.size());
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+        header_.version = kVersion;
+        header_.numColumns = uint32_t(columns.size());
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        offset_ = kHeaderSize;
+        return bool(out_);
+    }
+
+    // Agrega una fila ya separada; los campos que no se pueden leer son nulos
+    void add(const table::Row& row) {
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            ColumnState& col = state_[c];
+            std::string_view text = row.isNull(c) ? table::kNullText : row[c];
+            bool null = text == table::kNullText;
+            switch (columns_[c].parse) {
+            case Parse::Text: {
+                uint32_t id = kNullId;
+                if (!null) {
+                    uint32_t& slot = col.ids.value_hashed(text, tok::hash_word(text));
+                    if (slot == 0) {
+                        slot = uint32_t(col.ids.size());
+                        col.words.push_back(col.arena.intern(text));
+                    }
+                    id = slot - 1;
+                }
+                col.idValues.push_back(id);
+                break;
+            }
+            case Parse::Int:
+            case Parse::Clock: {
+                std::optional<int64_t> v;
+                if (!null) v = columns_[c].parse == Parse::Int ? table::toInt(text) : parseClock(text);
+                col.intValues.push_back(v ? *v : kNullInt);
+                break;
+            }
+            case Parse::Double: {
+                std::optional<double> v;
+                if (!null) v = table::toDouble(text);
+                col.doubleValues.push_back(v ? *v : nullDouble());
+                break;
+            }
+            }
+        }
+        if (++blockFill_ == blockRows_) flushBlock();
+        ++header_.numRows;
+    }
+
+    bool finish() {
+        flushBlock();
+
+        std::string schema;
+        for (const ColumnSpec& column : columns_) {
+            schema += char(storedType(column.parse));
+            uint32_t length = uint32_t(column.name.size());
+            schema.append(reinterpret_cast<const char*>(&length), 4);
+            schema += column.name;
+        }
+        header_.schemaOffset = offset_;
+        write(schema);
+
+        header_.blocksOffset = offset_;
+        header_.numBlocks = blockSizes_.size();
+        std::string blocks;
+        for (size_t b = 0; b < blockSizes_.size(); ++b) {
+            putU64(blocks, blockSizes_[b]);
+            const ColumnBlock* info = &blockInfo_[b * columns_.size()];
+            blocks.append(reinterpret_cast<const char*>(info), columns_.size() * sizeof(ColumnBlock));
+        }
+        write(blocks);
+
+        // Tabla de diccionarios y luego cada diccionario
+        header_.dictOffset = offset_;
+        std::vector<uint64_t> dictOffsets(columns_.size(), 0);
+        uint64_t next = offset_ + 8 * columns_.size();
+        std::string dictionaries;
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            if (columns_[c].parse != Parse::Text) continue;
+            dictOffsets[c] = next + dictionaries.size();
+            const auto& words = state_[c].words;
+            putU64(dictionaries, words.size());
+            uint64_t position = 0;
+            for (std::string_view w : words) {
+                putU64(dictionaries, position);
+                position += w.size();
+            }
+            putU64(dictionaries, position);
+            for (std::string_view w : words) dictionaries += w;
+        }
+        std::string table;
+        for (uint64_t offset : dictOffsets) putU64(table, offset);
+        write(table);
+        write(dictionaries);
+
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        out_.close();
+        return !out_.fail();
+    }
+
+    uint64_t rows() const { return header_.numRows; }
+
+private:
+    struct ColumnState {
+        WordTable<uint32_t> ids;  // cadena -> id + 1
+        std::vector<std::string_view> words;
+        Arena arena;
+        std::vector<uint32_t> idValues;
+        std::vector<int64_t> intValues;
+        std::vector<double> doubleValues;
+    };
+
+    void write(std::string_view bytes) {
+        out_.write(bytes.data(), std::streamsize(bytes.size()));
+        offset_ += bytes.size();
+    }
+
+    void pad() {
+        static const char zeros[8] = {};
+        if (offset_ % 8) write(std::string_view(zeros, 8 - offset_ % 8));
+    }
+
+    // Escribe las columnas del bloque en curso con sus mapas de zona
+    void flushBlock() {
+        if (blockFill_ == 0) return;
+        instr::Scope scope(instr::Stage::Serialize);
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            ColumnState& col = state_[c];
+            pad();
+            ColumnBlock info{offset_, 0, 0, 0};
+            switch (columns_[c].parse) {
+            case Parse::Text: {
+                uint32_t lo = kNullId, hi = kNullId;
+                for (uint32_t id : col.idValues) {
+                    if (id == kNullId) {
+                        info.nulls++;
+                        continue;
+                    }
+                    if (lo == kNullId || col.words[id] < col.words[lo]) lo = id;
+                    if (hi == kNullId || col.words[id] > col.words[hi]) hi = id;
+                }
+                info.min = lo;
+                info.max = hi;
+                write({reinterpret_cast<const char*>(col.idValues.data()), col.idValues.size() * 4});
+                col.idValues.clear();
+                break;
+            }
+            case Parse::Int:
+            case Parse::Clock: {
+                int64_t lo = std::numeric_limits<int64_t>::max(), hi = kNullInt;
+                for (int64_t v : col.intValues) {
+                    if (v == kNullInt) {
+                        info.nulls++;
+                        continue;
+                    }
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                info.min = uint64_t(lo);
+                info.max = uint64_t(hi);
+                write({reinterpret_cast<const char*>(col.intValues.data()), col.intValues.size() * 8});
+                col.intValues.clear();
+                break;
+            }
+            case Parse::Double: {
+                double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+                for (double v : col.doubleValues) {
+                    if (isNull(v)) {
+                        info.nulls++;
+                        continue;
+                    }
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+                info.min = bitsOf(lo);
+                info.max = bitsOf(hi);
+                write({reinterpret_cast<const char*>(col.doubleValues.data()), col.doubleValues.size() * 8});
+                col.doubleValues.clear();
+                break;
+            }
+            }
+            blockInfo_.push_back(info);
+        }
+        blockSizes_.push_back(blockFill_);
+        blockFill_ = 0;
+    }
+
+    std::ofstream out_;
+    Header header_{};
+    uint64_t offset_ = 0;
+    std::vector<ColumnSpec> columns_;
+    std::vector<ColumnState> state_;
+    size_t blockRows_ = kBlockRows;
+    size_t blockFill_ = 0;
+    std::vector<uint64_t> blockSizes_;
+    std::vector<ColumnBlock> blockInfo_;  // bloque * columnas + columna
+};
+
+// Convierte archivos de texto con schema (delimitador y restInLast) a un
+// archivo columnar. Devuelve las filas escritas, o nada si falla.
+inline std::optional<uint64_t> convert(const std::vector<std::string>& files, const table::Schema& schema,
+                                       const std::vector<ColumnSpec>& columns, const std::string& output,
+                                       size_t blockRows = kBlockRows) {
+    Writer writer;
+    if (!writer.open(output, columns, blockRows)) return std::nullopt;
+    table::Row row;
+    for (const std::string& path : files) {
+        MappedFile file;
+        if (!file.open(path)) return std::nullopt;
+        instr::add_bytes(file.size());
+        table::forEachLine(file.view(), [&](std::string_view line) {
+            table::splitRow(line, schema, row);
+            writer.add(row);
+        });
+    }
+    if (!writer.finish()) return std::nullopt;
+    return writer.rows();
+}
+
+class Reader {
+public:
+    bool open(const std::string& path) {
+        if (!file_.open(path) || file_.size() < kHeaderSize) return false;
+        std::memcpy(&header_, file_.data(), kHeaderSize);
+        if (std::memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0 || header_.version != kVersion) {
+            file_.close();
+            return false;
+        }
+        const char* p = file_.data() + header_.schemaOffset;
+        schema_.columns.clear();
+        for (uint32_t c = 0; c < header_.numColumns; ++c) {
+            table::Type type = table::Type(uint8_t(*p++));
+            uint32_t length;
+            std::memcpy(&length, p, 4);
+            p += 4;
+            schema_.columns.push_back({std::string(p, length), type});
+            p += length;
+        }
+        blockStride_ = 8 + header_.numColumns * sizeof(ColumnBlock);
+        blockFirstRow_.assign(1, 0);
+        for (uint64_t b = 0; b < header_.numBlocks; ++b) {
+            blockFirstRow_.push_back(blockFirstRow_.back() + blockRows(b));
+        }
+        return true;
+    }
+
+    const table::Schema& schema() const { return schema_; }
+    uint64_t numRows() const { return header_.numRows; }
+    uint64_t numBlocks() const { return header_.numBlocks; }
+    uint64_t fileSize() const { return file_.size(); }
+
+    uint64_t blockRows(uint64_t b) const {
+        return getU64(file_.data() + header_.blocksOffset + b * blockStride_);
+    }
+    uint64_t blockFirstRow(uint64_t b) const { return blockFirstRow_[b]; }
+
+    ColumnBlock columnBlock(uint64_t b, size_t c) const {
+        ColumnBlock info;
+        std::memcpy(&info, file_.data() + header_.blocksOffset + b * blockStride_ + 8 + c * sizeof(ColumnBlock),
+                    sizeof(info));
+        return info;
+    }
+
+    // Arreglos de la columna c en el bloque b, directamente sobre el mapeo
+    const uint32_t* ids(uint64_t b, size_t c) const { return data<uint32_t>(b, c); }
+    const int64_t* ints(uint64_t b, size_t c) const { return data<int64_t>(b, c); }
+    const double* doubles(uint64_t b, size_t c) const { return data<double>(b, c); }
+
+    uint64_t dictionarySize(size_t c) const {
+        uint64_t offset = dictOffset(c);
+        return offset ? getU64(file_.data() + offset) : 0;
+    }
+
+    std::string_view word(size_t c, uint32_t id) const {
+        const char* dict = file_.data() + dictOffset(c);
+        uint64_t n = getU64(dict);
+        uint64_t begin = getU64(dict + 8 + 8 * uint64_t(id));
+        uint64_t end = getU64(dict + 8 + 8 * (uint64_t(id) + 1));
+        return {dict + 8 + 8 * (n + 1) + begin, size_t(end - begin)};
+    }
+
+    // Mapa de zona: false si ningún valor de la columna numérica c en el
+    // bloque b puede estar en [lo, hi]
+    bool mayOverlap(uint64_t b, size_t c, double lo, double hi) const {
+        ColumnBlock info = columnBlock(b, c);
+        if (info.nulls == blockRows(b)) return false;
+        double min, max;
+        if (schema_.columns[c].type == table::Type::Int) {
+            min = double(int64_t(info.min));
+            max = double(int64_t(info.max));
+        } else {
+            min = doubleOf(info.min);
+            max = doubleOf(info.max);
+        }
+        return max >= lo && min <= hi;
+    }
+
+    table::Value value(uint64_t b, size_t c, uint64_t i) const {
+        switch (schema_.columns[c].type) {
+        case table::Type::String: {
+            uint32_t id = ids(b, c)[i];
+            return id == kNullId ? table::Value::null() : table::Value::ofString(word(c, id));
+        }
+        case table::Type::Int: {
+            int64_t v = ints(b, c)[i];
+            return v == kNullInt ? table::Value::null() : table::Value::ofInt(v);
+        }
+        case table::Type::Double: {
+            double v = doubles(b, c)[i];
+            return isNull(v) ? table::Value::null() : table::Value::ofDouble(v);
+        }
+        }
+        return table::Value::null();
+    }
+
+private:
+    template <class T>
+    const T* data(uint64_t b, size_t c) const {
+        return reinterpret_cast<const T*>(file_.data() + columnBlock(b, c).offset);
+    }
+
+    uint64_t dictOffset(size_t c) const { return getU64(file_.data() + header_.dictOffset + 8 * c); }
+
+    MappedFile file_;
+    Header header_{};
+    table::Schema schema_;
+    size_t blockStride_ = 0;
+    std::vector<uint64_t> blockFirstRow_;
+};
+
+// Filtro lo <= columna <= hi sobre una columna numérica
+struct Range {
+    int column;
+    double lo;
+    double hi;
+};
+
+// SELECT clave, agregados FROM archivo WHERE rangos GROUP BY clave sobre un
+// archivo columnar. La clave (o -1, sin GROUP BY) debe ser una columna de
+// cadenas: su id de diccionario indexa directamente los estados, sin hash.
+// Solo se leen las columnas que usan la clave, los agregados y los filtros,
+// y los bloques que el mapa de zona descarta no se tocan.
+inline std::vector<table::ResultRow> groupBy(const Reader& reader, int key, const std::vector<aggregate::Spec>& specs,
+                                             const std::vector<Range>& ranges, size_t numThreads) {
+    using aggregate::Input;
+    using aggregate::State;
+    numThreads = std::max<size_t>(1, numThreads);
+    const table::Schema& schema = reader.schema();
+    const size_t stride = specs.size();
+    std::vector<Input> inputs;
+    for (const auto& spec : specs) inputs.push_back(aggregate::inputOf(spec, schema));
+    // Un grupo por id más el de la clave NULL (el último)
+    const size_t numGroups = key < 0 ? 1 : reader.dictionarySize(size_t(key)) + 1;
+
+    std::vector<std::vector<State>> partials(numThreads);
+    std::vector<std::vector<uint64_t>> groupRows(numThreads);  // filas seleccionadas por grupo
+    std::vector<Arena> texts(numThreads);
+    run_work_stealing(reader.numBlocks(), numThreads, [&](size_t b, size_t worker) {
+        for (const Range& r : ranges) {
+            if (!reader.mayOverlap(b, size_t(r.column), r.lo, r.hi)) return;
+        }
+        auto& states = partials[worker];
+        auto& rowsOf = groupRows[worker];
+        if (states.empty()) {
+            states.resize(numGroups * stride);
+            rowsOf.resize(numGroups);
+        }
+        const size_t n = reader.blockRows(b);
+        instr::add_tokens(n);
+
+        // Filas que pasan los filtros
+        thread_local std::vector<uint8_t> selected;
+        selected.assign(n, 1);
+        for (const Range& r : ranges) {
+            size_t c = size_t(r.column);
+            if (schema.columns[c].type == table::Type::Int) {
+                const int64_t* v = reader.ints(b, c);
+                for (size_t i = 0; i < n; ++i) {
+                    selected[i] &= v[i] != kNullInt && double(v[i]) >= r.lo && double(v[i]) <= r.hi;
+                }
+            } else {
+                const double* v = reader.doubles(b, c);
+                for (size_t i = 0; i < n; ++i) selected[i] &= !isNull(v[i]) && v[i] >= r.lo && v[i] <= r.hi;
+            }
+        }
+
+        thread_local std::vector<uint32_t> groupIds;
+        groupIds.assign(n, 0);
+        if (key >= 0) {
+            const uint32_t* ids = reader.ids(b, size_t(key));
+            for (size_t i = 0; i < n; ++i) groupIds[i] = ids[i] == kNullId ? uint32_t(numGroups - 1) : ids[i];
+        }
+
+        instr::Scope scope(instr::Stage::Insert);
+        for (size_t i = 0; i < n; ++i) rowsOf[groupIds[i]] += selected[i];
+        for (size_t s = 0; s < stride; ++s) {
+            State* base = states.data() + s;
+            size_t c = size_t(std::max(0, specs[s].column));
+            switch (inputs[s]) {
+            case Input::Rows:
+                for (size_t i = 0; i < n; ++i) base[groupIds[i] * stride].count += selected[i];
+                break;
+            case Input::Int: {
+                const int64_t* v = reader.ints(b, c);
+                for (size_t i = 0; i < n; ++i) {
+                    if (!selected[i] || v[i] == kNullInt) continue;
+                    State& st = base[groupIds[i] * stride];
+                    st.count++;
+                    st.intSum += v[i];
+                    st.intMin = std::min(st.intMin, v[i]);
+                    st.intMax = std::max(st.intMax, v[i]);
+                }
+                break;
+            }
+            case Input::Double: {
+                if (schema.columns[c].type == table::Type::String) {
+                    // SUM/AVG de una columna de cadenas: se lee cada cadena como double
+                    const uint32_t* ids = reader.ids(b, c);
+                    for (size_t i = 0; i < n; ++i) {
+                        if (!selected[i] || ids[i] == kNullId) continue;
+                        auto v = table::toDouble(reader.word(c, ids[i]));
+                        if (!v) continue;
+                        State& st = base[groupIds[i] * stride];
+                        st.count++;
+                        st.sum += *v;
+                        st.min = std::min(st.min, *v);
+                        st.max = std::max(st.max, *v);
+                    }
+                    break;
+                }
+                const double* v = reader.doubles(b, c);
+                for (size_t i = 0; i < n; ++i) {
+                    if (!selected[i] || isNull(v[i])) continue;
+                    State& st = base[groupIds[i] * stride];
+                    st.count++;
+                    st.sum += v[i];
+                    st.min = std::min(st.min, v[i]);
+                    st.max = std::max(st.max, v[i]);
+                }
+                break;
+            }
+            case Input::Text: {
+                const uint32_t* ids = reader.ids(b, c);
+                aggregate::Func func = specs[s].func;
+                for (size_t i = 0; i < n; ++i) {
+                    if (!selected[i] || ids[i] == kNullId) continue;
+                    State& st = base[groupIds[i] * stride];
+                    std::string_view w = reader.word(c, ids[i]);
+                    bool first = st.count++ == 0;
+                    // Las cadenas viven en el mapeo: no hace falta copiarlas
+                    if (func == aggregate::Func::Min && (first || w < st.textMin)) st.textMin = w;
+                    if (func == aggregate::Func::Max && (first || w > st.textMax)) st.textMax = w;
+                }
+                break;
+            }
+            }
+        }
+    });
+
+    // Unión por rangos de grupos en paralelo
+    instr::Scope scope(instr::Stage::Merge);
+    std::vector<State> merged(numGroups * stride);
+    std::vector<uint64_t> mergedRows(numGroups);
+    size_t numRanges = std::min(numGroups, numThreads * 4);
+    run_work_stealing(numRanges, numThreads, [&](size_t r, size_t worker) {
+        size_t first = numGroups * r / numRanges, last = numGroups * (r + 1) / numRanges;
+        for (size_t t = 0; t < numThreads; ++t) {
+            const auto& states = partials[t];
+            if (states.empty()) continue;
+            for (size_t g = first; g < last; ++g) {
+                mergedRows[g] += groupRows[t][g];
+                for (size_t s = 0; s < stride; ++s) {
+                    aggregate::combine(merged[g * stride + s], states[g * stride + s], inputs[s], texts[worker]);
+                }
+            }
+        }
+    });
+
+    std::vector<table::ResultRow> rows;
+    for (size_t g = 0; g < numGroups; ++g) {
+        const State* st = &merged[g * stride];
+        // Con GROUP BY solo salen los grupos que tienen filas
+        if (key >= 0 && mergedRows[g] == 0) continue;
+        table::ResultRow row;
+        if (key >= 0) {
+            row.push_back(g + 1 == numGroups ? table::Value::null()
+                                             : table::Value::ofString(reader.word(size_t(key), uint32_t(g))));
+        }
+        for (size_t s = 0; s < stride; ++s) row.push_back(aggregate::finish(st[s], specs[s].func, inputs[s]));
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
+
+}  // namespace columnar
@@ -0,0 +1,1020 @@
+#pragma once
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/work_pool.h"
+#include "aggregate.h"
+#include "hql.h"
+#include "join.h"
+#include "table.h"
+
+// Ejecuta las sentencias de hql.h en local, con la semántica de Hive.
+//
+// El catálogo vive en memoria: CREATE TABLE registra el esquema, LOAD DATA
+// apunta la tabla a los archivos (no los copia) y CREATE TABLE AS escribe el
+// resultado en almacen/<tabla>/000000_0 con el formato de texto de Hive
+// ('\001' entre campos, \N para NULL) para que las sentencias siguientes lo
+// puedan leer.
+//
+// Plan de una consulta:
+//   - cada conjunción del WHERE (y del ON) que solo mira una tabla se empuja
+//     a su escaneo, que además solo separa las columnas que la consulta usa
+//   - GROUP BY sobre una tabla, o sobre el JOIN por igualdad de dos tablas,
+//     va a los operadores paralelos: aggregate::groupBy con un Partial por
+//     hilo, o join::joinAggregate con la agregación en el lado de sondeo
+//   - lo demás (subconsultas, JOIN sin agregar, HAVING, ORDER BY, LIMIT) se
+//     resuelve en memoria sobre filas ya materializadas, que a esa altura
+//     son pocas
+// Sin ORDER BY, un GROUP BY sale ordenado por sus claves, como con el único
+// reductor de Hive.
+namespace executor {
+
+// Tabla del catálogo
+struct Table {
+    table::Schema schema;
+    std::vector<std::string> files;
+    bool managed = false;  // CREATE TABLE AS: sus archivos están en el almacén
+};
+
+// Resultado de una consulta
+struct Relation {
+    std::vector<table::Column> columns;
+    std::vector<table::ResultRow> rows;
+};
+
+struct Options {
+    size_t numThreads = 1;
+    std::string warehouse = "almacen";
+    // LOAD DATA: prefijo de ruta del script -> ruta local
+    std::vector<std::pair<std::string, std::string>> paths;
+    // Delimitador de las tablas sin ROW FORMAT (Hive: '\001')
+    std::optional<char> defaultDelimiter;
+    join::Options join;
+};
+
+using hql::Expr;
+using table::Type;
+using table::Value;
+
+[[noreturn]] inline void fail(const std::string& what) { throw std::runtime_error(what); }
+
+// Expresión con las columnas resueltas a posiciones de la fila de entrada
+struct Bound {
+    Expr::Kind kind = Expr::Kind::Literal;
+    int slot = -1;  // Column / Aggregate
+    Value value;
+    std::string op;
+    Type type = Type::String;
+    std::vector<Bound> args;
+};
+
+// Lógica de tres valores: NULL es desconocido
+inline std::optional<bool> truth(const Value& v) {
+    switch (v.kind) {
+    case Value::Kind::Null: return std::nullopt;
+    case Value::Kind::Int: return v.i != 0;
+    case Value::Kind::Double: return v.d != 0;
+    case Value::Kind::String: return !v.s.empty();
+    }
+    return std::nullopt;
+}
+
+inline Value ofBool(std::optional<bool> b) { return b ? Value::ofInt(*b) : Value::null(); }
+
+// Número de un valor; una cadena se convierte como en Hive (NULL si no se puede)
+inline std::optional<double> numberOf(const Value& v) {
+    switch (v.kind) {
+    case Value::Kind::Int: return double(v.i);
+    case Value::Kind::Double: return v.d;
+    case Value::Kind::String: return table::toDouble(v.s);
+    default: return std::nullopt;
+    }
+}
+
+// a <=> b; nada si alguno es NULL. Cadena contra número compara como double.
+inline std::optional<int> compareValues(const Value& a, const Value& b) {
+    if (a.isNull() || b.isNull()) return std::nullopt;
+    if ((a.kind == Value::Kind::String) == (b.kind == Value::Kind::String)) return table::compare(a, b);
+    auto x = numberOf(a), y = numberOf(b);
+    if (!x || !y) return std::nullopt;
+    return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+template <class Get>
+Value eval(const Bound& e, const Get& get);
+
+template <class Get>
+Value evalBinary(const Bound& e, const Get& get) {
+    const std::string& op = e.op;
+    if (op == "AND" || op == "OR") {
+        bool isAnd = op == "AND";
+        auto left = truth(eval(e.args[0], get));
+        if (left && *left != isAnd) return Value::ofInt(!isAnd);
+        auto right = truth(eval(e.args[1], get));
+        if (right && *right != isAnd) return Value::ofInt(!isAnd);
+        return left && right ? Value::ofInt(isAnd) : Value::null();
+    }
+    Value a = eval(e.args[0], get), b = eval(e.args[1], get);
+    if (op == "=" || op == "<>" || op == "<" || op == "<=" || op == ">" || op == ">=") {
+        auto c = compareValues(a, b);
+        if (!c) return Value::null();
+        if (op == "=") return Value::ofInt(*c == 0);
+        if (op == "<>") return Value::ofInt(*c != 0);
+        if (op == "<") return Value::ofInt(*c < 0);
+        if (op == "<=") return Value::ofInt(*c <= 0);
+        if (op == ">") return Value::ofInt(*c > 0);
+        return Value::ofInt(*c >= 0);
+    }
+    // + - * /: entero si los dos lo son (salvo /), si no double
+    if (op != "/" && a.kind == Value::Kind::Int && b.kind == Value::Kind::Int) {
+        if (op == "+") return Value::ofInt(a.i + b.i);
+        if (op == "-") return Value::ofInt(a.i - b.i);
+        return Value::ofInt(a.i * b.i);
+    }
+    auto x = numberOf(a), y = numberOf(b);
+    if (!x || !y) return Value::null();
+    if (op == "+") return Value::ofDouble(*x + *y);
+    if (op == "-") return Value::ofDouble(*x - *y);
+    if (op == "*") return Value::ofDouble(*x * *y);
+    return *y == 0 ? Value::null() : Value::ofDouble(*x / *y);
+}
+
+// get(slot) da el valor de una columna (o agregado) de la fila de entrada
+template <class Get>
+Value eval(const Bound& e, const Get& get) {
+    switch (e.kind) {
+    case Expr::Kind::Column:
+    case Expr::Kind::Aggregate: return get(size_t(e.slot));
+    case Expr::Kind::Literal: return e.value;
+    case Expr::Kind::Not: {
+        auto t = truth(eval(e.args[0], get));
+        return ofBool(t ? std::optional<bool>(!*t) : std::nullopt);
+    }
+    case Expr::Kind::Negate: {
+        Value v = eval(e.args[0], get);
+        if (v.kind == Value::Kind::Int) return Value::ofInt(-v.i);
+        auto d = numberOf(v);
+        return d ? Value::ofDouble(-*d) : Value::null();
+    }
+    case Expr::Kind::IsNull: {
+        bool null = eval(e.args[0], get).isNull();
+        return Value::ofInt(e.op.empty() ? null : !null);
+    }
+    case Expr::Kind::Binary: return evalBinary(e, get);
+    }
+    return Value::null();
+}
+
+// Forma canónica, para reconocer el mismo agregado escrito dos veces
+inline std::string canonical(const Bound& e) {
+    std::string out = std::to_string(int(e.kind)) + e.op + "#" + std::to_string(e.slot);
+    if (e.kind == Expr::Kind::Literal) out += std::to_string(int(e.value.kind)) + table::format(e.value);
+    out += "(";
+    for (const Bound& a : e.args) out += canonical(a) + ",";
+    return out + ")";
+}
+
+// Una columna visible en la consulta: de qué origen sale y cómo se llama
+struct ScopeColumn {
+    std::string qualifier;  // alias, o nombre de la tabla
+    std::string table;      // tabla del catálogo ("" en subconsultas)
+    std::string name;
+    Type type = Type::String;
+    size_t source = 0;
+};
+
+inline bool sameName(std::string_view a, std::string_view b) { return hql::lower(a) == hql::lower(b); }
+
+struct Scope {
+    std::vector<ScopeColumn> columns;
+
+    size_t resolve(const Expr& column) const {
+        int found = -1;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const ScopeColumn& col = columns[c];
+            if (!sameName(col.name, column.name)) continue;
+            if (!column.qualifier.empty() && !sameName(col.qualifier, column.qualifier) &&
+                !sameName(col.table, column.qualifier)) {
+                continue;
+            }
+            if (found >= 0) fail("columna ambigua: " + column.text);
+            found = int(c);
+        }
+        if (found < 0) fail("columna desconocida: " + column.text);
+        return size_t(found);
+    }
+};
+
+// Un agregado de la consulta; su argumento se evalúa sobre la fila de entrada
+struct AggregateCall {
+    aggregate::Func func = aggregate::Func::Count;
+    bool star = false;
+    Bound arg;
+    Type type = Type::Int;
+    std::string signature;
+};
+
+// Dónde se evalúa una expresión: sobre la fila de entrada (columnas del
+// alcance) o sobre la fila agrupada (claves del GROUP BY, luego agregados)
+struct Context {
+    const Scope* scope = nullptr;
+    const std::vector<size_t>* keys = nullptr;
+    const std::vector<AggregateCall>* aggregates = nullptr;
+
+    bool grouped() const { return keys != nullptr; }
+};
+
+inline bool isComparison(const std::string& op) {
+    return op == "=" || op == "<>" || op == "<" || op == "<=" || op == ">" || op == ">=";
+}
+
+inline Type aggregateType(aggregate::Func func, bool star, Type arg) {
+    using aggregate::Func;
+    if (func == Func::Count || star) return Type::Int;
+    if (func == Func::Avg) return Type::Double;
+    if (func == Func::Sum) return arg == Type::Int ? Type::Int : Type::Double;
+    return arg;
+}
+
+inline Bound bind(const Expr& e, const Context& ctx);
+
+inline Bound bindAggregateCall(const Expr& e, const Scope& scope, AggregateCall* call) {
+    Context row{&scope};
+    AggregateCall c;
+    c.func = e.func;
+    c.star = e.star;
+    if (!e.star) c.arg = bind(*e.args[0], row);
+    c.type = aggregateType(c.func, c.star, c.arg.type);
+    c.signature = std::to_string(int(c.func)) + (c.star ? "*" : canonical(c.arg));
+    *call = c;
+    return c.arg;
+}
+
+inline Bound bind(const Expr& e, const Context& ctx) {
+    Bound b;
+    b.kind = e.kind;
+    b.op = e.op;
+    switch (e.kind) {
+    case Expr::Kind::Column: {
+        size_t c = ctx.scope->resolve(e);
+        b.type = ctx.scope->columns[c].type;
+        if (!ctx.grouped()) {
+            b.slot = int(c);
+            return b;
+        }
+        for (size_t k = 0; k < ctx.keys->size(); ++k) {
+            if ((*ctx.keys)[k] == c) {
+                b.slot = int(k);
+                return b;
+            }
+        }
+        fail("la columna " + e.text + " no está en el GROUP BY");
+    }
+    case Expr::Kind::Literal:
+        b.value = e.value;
+        b.type = e.value.kind == Value::Kind::Int ? Type::Int
+                 : e.value.kind == Value::Kind::Double ? Type::Double : Type::String;
+        return b;
+    case Expr::Kind::Aggregate: {
+        if (!ctx.grouped()) fail("agregado fuera de lugar: " + e.text);
+        AggregateCall call;
+        bindAggregateCall(e, *ctx.scope, &call);
+        for (size_t a = 0; a < ctx.aggregates->size(); ++a) {
+            if ((*ctx.aggregates)[a].signature == call.signature) {
+                b.slot = int(ctx.keys->size() + a);
+                b.type = call.type;
+                return b;
+            }
+        }
+        fail("agregado no planificado: " + e.text);
+    }
+    default: break;
+    }
+    for (const auto& a : e.args) b.args.push_back(bind(*a, ctx));
+    if (e.kind == Expr::Kind::Binary && !isComparison(e.op) && e.op != "AND" && e.op != "OR") {
+        bool ints = b.args[0].type == Type::Int && b.args[1].type == Type::Int;
+        b.type = ints && e.op != "/" ? Type::Int : Type::Double;
+    } else if (e.kind == Expr::Kind::Negate) {
+        b.type = b.args[0].type == Type::Int ? Type::Int : Type::Double;
+    } else {
+        b.type = Type::Int;  // booleano
+    }
+    return b;
+}
+
+inline bool hasAggregate(const Expr& e) {
+    if (e.kind == Expr::Kind::Aggregate) return true;
+    for (const auto& a : e.args) {
+        if (hasAggregate(*a)) return true;
+    }
+    return false;
+}
+
+// Agrega a calls los agregados de e que aún no están
+inline void collectAggregates(const Expr& e, const Scope& scope, std::vector<AggregateCall>& calls) {
+    if (e.kind == Expr::Kind::Aggregate) {
+        AggregateCall call;
+        bindAggregateCall(e, scope, &call);
+        if (!e.star && hasAggregate(*e.args[0])) fail("agregado dentro de otro: " + e.text);
+        for (const AggregateCall& c : calls) {
+            if (c.signature == call.signature) return;
+        }
+        calls.push_back(std::move(call));
+        return;
+    }
+    for (const auto& a : e.args) collectAggregates(*a, scope, calls);
+}
+
+// Columnas del alcance que usa e
+inline void collectColumns(const Expr& e, const Scope& scope, std::vector<bool>& used) {
+    if (e.kind == Expr::Kind::Column) used[scope.resolve(e)] = true;
+    for (const auto& a : e.args) collectColumns(*a, scope, used);
+}
+
+// HAVING y ORDER BY pueden nombrar un alias del SELECT: la columna que no
+// existe en el alcance se cambia por la expresión del alias
+inline hql::ExprPtr withAliases(const hql::ExprPtr& e, const Scope& scope, const std::vector<hql::SelectItem>& items) {
+    if (!e) return e;
+    if (e->kind == Expr::Kind::Column && e->qualifier.empty()) {
+        for (const auto& column : scope.columns) {
+            if (sameName(column.name, e->name)) return e;
+        }
+        for (const auto& item : items) {
+            if (item.expr && sameName(item.alias, e->name)) return item.expr;
+        }
+        return e;
+    }
+    auto copy = std::make_shared<Expr>(*e);
+    for (auto& a : copy->args) a = withAliases(a, scope, items);
+    return copy;
+}
+
+// a AND b AND c -> {a, b, c}
+inline void conjuncts(const hql::ExprPtr& e, std::vector<hql::ExprPtr>& out) {
+    if (!e) return;
+    if (e->kind == Expr::Kind::Binary && e->op == "AND") {
+        conjuncts(e->args[0], out);
+        conjuncts(e->args[1], out);
+    } else {
+        out.push_back(e);
+    }
+}
+
+// Escapa a \N y usa '\001', como el texto que escribe Hive
+inline std::string storedText(const Value& v) { return v.isNull() ? std::string(table::kNullText) : table::format(v); }
+
+class Executor {
+public:
+    explicit Executor(Options options) : options_(std::move(options)) {}
+
+    // Ejecuta una sentencia; CREATE TABLE AS y las consultas devuelven sus filas
+    std::optional<Relation> run(const hql::Statement& st) {
+        using K = hql::Statement::Kind;
+        plan_.clear();
+        switch (st.kind) {
+        case K::Set: settings_[st.name] = st.value; return std::nullopt;
+        case K::DropTable: drop(st); return std::nullopt;
+        case K::CreateTable: create(st); return std::nullopt;
+        case K::Load: load(st); return std::nullopt;
+        case K::CreateTableAs: {
+            std::string name = hql::lower(st.name);
+            if (tables_.count(name)) {
+                if (st.ifExists) return std::nullopt;
+                fail("la tabla ya existe: " + st.name);
+            }
+            Relation result = select(*st.query);
+            store(name, result);
+            return result;
+        }
+        case K::Query: return select(*st.query);
+        }
+        return std::nullopt;
+    }
+
+    // Qué hizo la última sentencia, para --plan
+    const std::vector<std::string>& plan() const { return plan_; }
+
+    const Table* find(const std::string& name) const {
+        auto it = tables_.find(hql::lower(name));
+        return it == tables_.end() ? nullptr : &it->second;
+    }
+
+private:
+    // Una tabla del FROM: del catálogo o una subconsulta ya ejecutada
+    struct Source {
+        std::string qualifier;
+        const Table* base = nullptr;
+        Relation derived;
+        size_t offset = 0;  // primera columna en el alcance
+        size_t width = 0;
+    };
+
+    // Una conjunción del WHERE/ON y los orígenes que mira
+    struct Conjunct {
+        hql::ExprPtr expr;
+        std::vector<size_t> sources;
+    };
+
+    // Igualdad de un JOIN: columna del lado izquierdo = columna del nuevo origen
+    struct EquiKey {
+        size_t left, right;  // índices en el alcance
+    };
+
+    void drop(const hql::Statement& st) {
+        auto it = tables_.find(hql::lower(st.name));
+        if (it == tables_.end()) {
+            if (st.ifExists) return;
+            fail("tabla no encontrada: " + st.name);
+        }
+        if (it->second.managed) {
+            std::error_code error;
+            std::filesystem::remove_all(tableDir(it->first), error);
+        }
+        tables_.erase(it);
+    }
+
+    void create(const hql::Statement& st) {
+        std::string name = hql::lower(st.name);
+        if (tables_.count(name)) {
+            if (st.ifExists) return;
+            fail("la tabla ya existe: " + st.name);
+        }
+        Table t;
+        t.schema.columns = st.columns;
+        t.schema.delimiter = st.delimited ? st.delimiter : options_.defaultDelimiter.value_or('\001');
+        tables_[name] = std::move(t);
+    }
+
+    void load(const hql::Statement& st) {
+        auto it = tables_.find(hql::lower(st.name));
+        if (it == tables_.end()) fail("tabla no encontrada: " + st.name);
+        std::string path = st.path;
+        for (const auto& [from, to] : options_.paths) {
+            if (path.rfind(from, 0) == 0) {
+                path = to + path.substr(from.size());
+                break;
+            }
+        }
+        namespace fs = std::filesystem;
+        std::vector<std::string> files;
+        std::error_code error;
+        if (fs::is_directory(path, error)) {
+            // Un directorio carga todos sus archivos menos los ocultos (_SUCCESS, .crc)
+            for (const auto& entry : fs::directory_iterator(path, error)) {
+                std::string base = entry.path().filename().string();
+                if (entry.is_regular_file() && base[0] != '.' && base[0] != '_') files.push_back(entry.path().string());
+            }
+            std::sort(files.begin(), files.end());
+        } else if (fs::is_regular_file(path, error)) {
+            files.push_back(path);
+        } else {
+            fail("ruta inválida '" + st.path + "': no existe" + (path != st.path ? " (" + path + ")" : ""));
+        }
+        Table& t = it->second;
+        if (st.overwrite) t.files = files;
+        else t.files.insert(t.files.end(), files.begin(), files.end());
+        plan_.push_back("LOAD " + st.name + ": " + std::to_string(files.size()) + " archivo(s) de " + path);
+    }
+
+    std::filesystem::path tableDir(const std::string& name) const {
+        return std::filesystem::path(options_.warehouse) / name;
+    }
+
+    // CREATE TABLE AS: el resultado va al almacén en el formato de Hive
+    void store(const std::string& name, const Relation& result) {
+        namespace fs = std::filesystem;
+        fs::path dir = tableDir(name);
+        std::error_code error;
+        fs::remove_all(dir, error);
+        fs::create_directories(dir, error);
+        std::string path = (dir / "000000_0").string();
+        std::ofstream out(path, std::ios::binary);
+        std::string text;
+        for (const auto& row : result.rows) {
+            for (size_t c = 0; c < row.size(); ++c) {
+                if (c) text += '\001';
+                text += storedText(row[c]);
+            }
+            text += '\n';
+        }
+        out << text;
+        if (!out) fail("no se pudo escribir " + path);
+        Table t;
+        t.schema.columns = result.columns;
+        t.files = {path};
+        t.managed = true;
+        tables_[name] = std::move(t);
+        plan_.push_back("CREATE TABLE " + name + ": " + std::to_string(result.rows.size()) + " filas en " + path);
+    }
+
+    Source source(const hql::TableRef& ref) {
+        Source s;
+        if (ref.subquery) {
+            s.derived = select(*ref.subquery);
+            s.qualifier = ref.alias;
+            s.width = s.derived.columns.size();
+            return s;
+        }
+        s.base = find(ref.table);
+        if (!s.base) fail("tabla no encontrada: " + ref.table);
+        s.qualifier = ref.alias.empty() ? ref.table : ref.alias;
+        s.width = s.base->schema.columns.size();
+        return s;
+    }
+
+    const std::vector<table::Column>& columnsOf(const Source& s) const {
+        return s.base ? s.base->schema.columns : s.derived.columns;
+    }
+
+    // Orígenes que mira e
+    std::vector<size_t> sourcesOf(const Expr& e, const Scope& scope) const {
+        std::vector<bool> used(scope.columns.size());
+        collectColumns(e, scope, used);
+        std::vector<size_t> out;
+        for (size_t c = 0; c < used.size(); ++c) {
+            size_t s = scope.columns[c].source;
+            if (used[c] && std::find(out.begin(), out.end(), s) == out.end()) out.push_back(s);
+        }
+        return out;
+    }
+
+    // Filtro de escaneo de una tabla del catálogo con las conjunciones que
+    // solo la miran a ella
+    table::RowFilter scanFilter(const Source& s, const std::vector<Conjunct>& pushed, const Scope& scope) const {
+        std::vector<Bound> bounds;
+        size_t columns = 0;
+        for (const Conjunct& c : pushed) {
+            bounds.push_back(bind(*c.expr, Context{&scope}));
+            std::vector<bool> used(scope.columns.size());
+            collectColumns(*c.expr, scope, used);
+            for (size_t i = 0; i < used.size(); ++i) {
+                if (used[i]) columns = std::max(columns, i - s.offset + 1);
+            }
+        }
+        if (bounds.empty()) return {};
+        const table::Schema* schema = &s.base->schema;
+        size_t offset = s.offset;
+        return {[bounds, schema, offset](const table::Row& row) {
+                    auto get = [&](size_t slot) {
+                        size_t c = slot - offset;
+                        return row.isNull(c) ? Value::null() : table::parseValue(row[c], schema->columns[c].type);
+                    };
+                    for (const Bound& b : bounds) {
+                        auto t = truth(eval(b, get));
+                        if (!t || !*t) return false;
+                    }
+                    return true;
+                },
+                columns};
+    }
+
+    // Filas de una tabla del catálogo en el orden de sus archivos; solo se
+    // leen las columnas de used (las demás quedan NULL) y las que pasan filter
+    Relation scan(const Table& t, const std::vector<bool>& used, const table::RowFilter& filter) const {
+        size_t limit = filter.keep ? filter.columns : 0;
+        for (size_t c = 0; c < used.size(); ++c) {
+            if (used[c]) limit = c + 1;
+        }
+        std::vector<FileChunk> chunks = plan_chunks(t.files, kDefaultChunkBytes, true);
+        std::vector<std::vector<table::ResultRow>> parts(chunks.size());
+        run_work_stealing(chunks.size(), options_.numThreads, [&](size_t task, size_t) {
+            thread_local std::string buffer;
+            thread_local table::Row row;
+            {
+                instr::Scope scope(instr::Stage::Read);
+                if (!read_chunk(t.files[chunks[task].file], chunks[task], buffer)) return;
+            }
+            instr::add_bytes(buffer.size());
+            instr::Scope scope(instr::Stage::Tokenize);
+            uint64_t lines = 0;
+            table::forEachLine(buffer, [&](std::string_view line) {
+                ++lines;
+                table::splitRow(line, t.schema, row, limit);
+                if (!filter(row)) return;
+                table::ResultRow out(t.schema.columns.size());
+                for (size_t c = 0; c < limit; ++c) {
+                    if (used[c] && !row.isNull(c)) out[c] = table::parseValue(row[c], t.schema.columns[c].type);
+                }
+                parts[task].push_back(std::move(out));
+            });
+            instr::add_tokens(lines);
+        });
+        Relation r;
+        r.columns = t.schema.columns;
+        for (auto& part : parts) std::move(part.begin(), part.end(), std::back_inserter(r.rows));
+        return r;
+    }
+
+    // Claves de JOIN/GROUP BY en memoria: valores con su tipo, separados
+    static std::string keyOf(const table::ResultRow& row, const std::vector<size_t>& columns) {
+        std::string key;
+        for (size_t c : columns) {
+            const Value& v = row[c];
+            key += char('0' + int(v.kind));
+            key += table::format(v);
+            key += aggregate::kKeySeparator;
+        }
+        return key;
+    }
+
+    static aggregate::Input inputOf(const AggregateCall& call) {
+        using aggregate::Func;
+        if (call.star) return aggregate::Input::Rows;
+        if (call.arg.type == Type::Int) return aggregate::Input::Int;
+        if (call.arg.type == Type::Double || call.func == Func::Sum || call.func == Func::Avg) {
+            return aggregate::Input::Double;
+        }
+        return aggregate::Input::Text;
+    }
+
+    // GROUP BY en memoria sobre filas del alcance: claves y luego agregados
+    std::vector<table::ResultRow> groupRows(const std::vector<table::ResultRow>& rows,
+                                            const std::vector<size_t>& keys,
+                                            const std::vector<AggregateCall>& calls) const {
+        using aggregate::Input;
+        std::vector<Input> inputs;
+        for (const auto& call : calls) inputs.push_back(inputOf(call));
+        std::unordered_map<std::string, size_t> groups;
+        std::vector<table::ResultRow> out;
+        std::vector<aggregate::State> states;
+        Arena texts;
+        for (const auto& row : rows) {
+            auto [it, inserted] = groups.emplace(keyOf(row, keys), out.size());
+            if (inserted) {
+                table::ResultRow key;
+                for (size_t k : keys) key.push_back(row[k]);
+                out.push_back(std::move(key));
+                states.resize(out.size() * calls.size());
+            }
+            aggregate::State* group = &states[it->second * calls.size()];
+            auto get = [&](size_t slot) -> const Value& { return row[slot]; };
+            for (size_t a = 0; a < calls.size(); ++a) {
+                aggregate::State& st = group[a];
+                if (inputs[a] == Input::Rows) {
+                    st.count++;
+                    continue;
+                }
+                Value v = eval(calls[a].arg, get);
+                if (v.isNull()) continue;
+                aggregate::State one;
+                one.count = 1;
+                if (inputs[a] == Input::Int) {
+                    one.intSum = one.intMin = one.intMax = v.i;
+                } else if (inputs[a] == Input::Double) {
+                    auto d = numberOf(v);
+                    if (!d) continue;
+                    one.sum = one.min = one.max = *d;
+                }
+                // combine copia las cadenas al arena si se quedan
+                std::string text = inputs[a] == Input::Text ? table::format(v) : std::string();
+                one.textMin = one.textMax = text;
+                aggregate::combine(st, one, inputs[a], texts);
+            }
+        }
+        // Sin GROUP BY hay una fila aunque no haya entrada
+        if (keys.empty() && out.empty()) {
+            out.emplace_back();
+            states.resize(calls.size());
+        }
+        for (size_t g = 0; g < out.size(); ++g) {
+            for (size_t a = 0; a < calls.size(); ++a) {
+                out[g].push_back(aggregate::finish(states[g * calls.size() + a], calls[a].func, inputs[a]));
+            }
+        }
+        return out;
+    }
+
+    Relation select(const hql::Select& q) {
+        // Orígenes y alcance
+        std::vector<const hql::TableRef*> refs{&q.from};
+        for (const auto& j : q.joins) refs.push_back(&j.right);
+        std::vector<Source> sources;
+        Scope scope;
+        for (size_t s = 0, offset = 0; s < refs.size(); ++s) {
+            sources.push_back(source(*refs[s]));
+            sources[s].offset = offset;
+            offset += sources[s].width;
+            for (const auto& column : columnsOf(sources[s])) {
+                scope.columns.push_back({sources[s].qualifier, refs[s]->table, column.name, column.type, s});
+            }
+        }
+
+        // WHERE y ON en conjunciones; la igualdad entre el nuevo origen y los
+        // anteriores es la clave de cada JOIN
+        std::vector<Conjunct> filters;
+        std::vector<std::vector<EquiKey>> joinKeys(q.joins.size());
+        std::vector<hql::ExprPtr> parts;
+        conjuncts(q.where, parts);
+        for (const auto& e : parts) {
+            if (hasAggregate(*e)) fail("agregado en WHERE: " + e->text);
+            filters.push_back({e, sourcesOf(*e, scope)});
+        }
+        for (size_t j = 0; j < q.joins.size(); ++j) {
+            std::vector<hql::ExprPtr> on;
+            conjuncts(q.joins[j].on, on);
+            for (const auto& e : on) {
+                if (e->kind == Expr::Kind::Binary && e->op == "=" && e->args[0]->kind == Expr::Kind::Column &&
+                    e->args[1]->kind == Expr::Kind::Column) {
+                    size_t a = scope.resolve(*e->args[0]), b = scope.resolve(*e->args[1]);
+                    size_t sa = scope.columns[a].source, sb = scope.columns[b].source;
+                    if (sa == j + 1 && sb <= j) std::swap(a, b), std::swap(sa, sb);
+                    if (sb == j + 1 && sa <= j) {
+                        joinKeys[j].push_back({a, b});
+                        continue;
+                    }
+                }
+                filters.push_back({e, sourcesOf(*e, scope)});
+            }
+            if (joinKeys[j].empty()) fail("el JOIN con " + sources[j + 1].qualifier + " necesita una igualdad en ON");
+        }
+
+        hql::ExprPtr having = withAliases(q.having, scope, q.items);
+        std::vector<hql::OrderItem> orderBy = q.orderBy;
+        for (auto& item : orderBy) item.expr = withAliases(item.expr, scope, q.items);
+
+        bool grouped = !q.groupBy.empty() || (having && hasAggregate(*having));
+        for (const auto& item : q.items) grouped = grouped || (item.expr && hasAggregate(*item.expr));
+        for (const auto& item : orderBy) grouped = grouped || hasAggregate(*item.expr);
+
+        std::vector<size_t> keys;
+        for (const auto& e : q.groupBy) {
+            if (e->kind != Expr::Kind::Column) fail("GROUP BY solo admite columnas: " + e->text);
+            keys.push_back(scope.resolve(*e));
+        }
+        std::vector<AggregateCall> calls;
+        if (grouped) {
+            for (const auto& item : q.items) {
+                if (!item.expr) fail("SELECT * con GROUP BY");
+                collectAggregates(*item.expr, scope, calls);
+            }
+            if (having) collectAggregates(*having, scope, calls);
+            for (const auto& item : orderBy) collectAggregates(*item.expr, scope, calls);
+        }
+
+        // Columnas que usa la consulta (proyección de los escaneos)
+        std::vector<bool> used(scope.columns.size());
+        for (const auto& item : q.items) {
+            if (item.expr) collectColumns(*item.expr, scope, used);
+            else std::fill(used.begin(), used.end(), true);
+        }
+        for (const auto& f : filters) collectColumns(*f.expr, scope, used);
+        for (const auto& keysOfJoin : joinKeys) {
+            for (const EquiKey& k : keysOfJoin) used[k.left] = used[k.right] = true;
+        }
+        for (size_t k : keys) used[k] = true;
+        if (having) collectColumns(*having, scope, used);
+        for (const auto& item : orderBy) collectColumns(*item.expr, scope, used);
+
+        // Conjunciones de un solo origen: van a su escaneo
+        std::vector<std::vector<Conjunct>> pushed(sources.size());
+        std::vector<Conjunct> remaining;
+        for (auto& f : filters) {
+            if (f.sources.size() <= 1) pushed[f.sources.empty() ? 0 : f.sources[0]].push_back(std::move(f));
+            else remaining.push_back(std::move(f));
+        }
+
+        std::vector<table::ResultRow> rows;
+        bool native = grouped && remaining.empty() && sources.size() <= 2 &&
+                      std::all_of(sources.begin(), sources.end(), [](const Source& s) { return s.base; }) &&
+                      (sources.size() == 1 || joinKeys[0].size() == 1) &&
+                      std::all_of(calls.begin(), calls.end(), [](const AggregateCall& c) {
+                          return c.star || c.arg.kind == Expr::Kind::Column;
+                      });
+        if (native) {
+            rows = groupNative(sources, scope, pushed, joinKeys, keys, calls, used);
+        } else {
+            rows = joinInMemory(sources, scope, pushed, joinKeys, used);
+            for (const Conjunct& f : remaining) {
+                Bound b = bind(*f.expr, Context{&scope});
+                std::erase_if(rows, [&](const table::ResultRow& row) {
+                    auto t = truth(eval(b, [&](size_t slot) -> const Value& { return row[slot]; }));
+                    return !t || !*t;
+                });
+            }
+            if (grouped) {
+                rows = groupRows(rows, keys, calls);
+                plan_.push_back("GROUP BY en memoria: " + std::to_string(rows.size()) + " grupos");
+            }
+        }
+        if (grouped) {
+            std::vector<table::SortKey> order;
+            for (size_t k = 0; k < keys.size(); ++k) order.push_back({k});
+            table::orderBy(rows, order);
+        }
+        Context ctx{&scope};
+        if (grouped) {
+            ctx.keys = &keys;
+            ctx.aggregates = &calls;
+        }
+        return project(q.items, having, orderBy, q.limit, ctx, std::move(rows));
+    }
+
+    // GROUP BY sobre una tabla o el JOIN de dos con los operadores paralelos
+    std::vector<table::ResultRow> groupNative(const std::vector<Source>& sources, const Scope& scope,
+                                              const std::vector<std::vector<Conjunct>>& pushed,
+                                              const std::vector<std::vector<EquiKey>>& joinKeys,
+                                              const std::vector<size_t>& keys,
+                                              const std::vector<AggregateCall>& calls,
+                                              const std::vector<bool>& used) {
+        auto countUsed = [&](const Source& s) {
+            return std::count(used.begin() + long(s.offset), used.begin() + long(s.offset + s.width), true);
+        };
+        auto describe = [&](const Source& s, const std::vector<Conjunct>& filter) {
+            std::string text = s.qualifier + " (" + std::to_string(countUsed(s)) + "/" + std::to_string(s.width) +
+                               " columnas";
+            for (const Conjunct& c : filter) text += ", filtro " + c.expr->text;
+            return text + ")";
+        };
+        if (sources.size() == 1) {
+            const Source& s = sources[0];
+            std::vector<int> localKeys;
+            for (size_t k : keys) localKeys.push_back(int(k));
+            std::vector<aggregate::Spec> specs;
+            for (const auto& c : calls) specs.push_back({c.func, c.star ? -1 : c.arg.slot});
+            plan_.push_back("GROUP BY paralelo con parciales por hilo sobre " + describe(s, pushed[0]));
+            return aggregate::groupBy(s.base->files, s.base->schema, localKeys, specs, options_.numThreads,
+                                      scanFilter(s, pushed[0], scope));
+        }
+
+        // El lado más chico se construye y el grande sondea
+        const EquiKey& key = joinKeys[0][0];
+        size_t probe = join::totalBytes(sources[0].base->files) >= join::totalBytes(sources[1].base->files) ? 0 : 1;
+        size_t build = 1 - probe;
+        auto side = [&](size_t s, size_t keyColumn) {
+            return join::Side{sources[s].base->files, sources[s].base->schema, int(keyColumn - sources[s].offset),
+                              scanFilter(sources[s], pushed[s], scope)};
+        };
+        join::Side probeSide = side(probe, probe == 0 ? key.left : key.right);
+        join::Side buildSide = side(build, build == 0 ? key.left : key.right);
+        // Alcance -> columna de joinedSchema(probe, build)
+        auto joined = [&](size_t c) {
+            size_t s = scope.columns[c].source;
+            size_t local = c - sources[s].offset;
+            return int(s == probe ? local : sources[probe].width + local);
+        };
+        std::vector<int> joinedKeys;
+        for (size_t k : keys) joinedKeys.push_back(joined(k));
+        std::vector<aggregate::Spec> specs;
+        for (const auto& c : calls) specs.push_back({c.func, c.star ? -1 : joined(size_t(c.arg.slot))});
+
+        join::Options options = options_.join;
+        options.numThreads = options_.numThreads;
+        // hive.auto.convert.join=false: nada de map join, siempre se reparte
+        auto setting = settings_.find("hive.auto.convert.join");
+        if (setting != settings_.end() && hql::lower(setting->second) == "false") options.broadcastBytes = 0;
+        join::Strategy strategy;
+        auto rows = join::joinAggregate(probeSide, buildSide, joinedKeys, specs, options, &strategy);
+        plan_.push_back(std::string("JOIN ") + (strategy == join::Strategy::Broadcast ? "broadcast" : "particionado") +
+                        " con agregación en el sondeo: sondea " + describe(sources[probe], pushed[probe]) +
+                        ", construye " + describe(sources[build], pushed[build]));
+        return rows;
+    }
+
+    // Filas del alcance: escanea las tablas (con sus filtros y proyección) y
+    // une en memoria por las igualdades de cada JOIN
+    std::vector<table::ResultRow> joinInMemory(std::vector<Source>& sources, const Scope& scope,
+                                               const std::vector<std::vector<Conjunct>>& pushed,
+                                               const std::vector<std::vector<EquiKey>>& joinKeys,
+                                               const std::vector<bool>& used) {
+        auto rowsOf = [&](size_t s) {
+            Source& src = sources[s];
+            std::vector<table::ResultRow> rows;
+            if (src.base) {
+                std::vector<bool> local(used.begin() + long(src.offset), used.begin() + long(src.offset + src.width));
+                rows = scan(*src.base, local, scanFilter(src, pushed[s], scope)).rows;
+                plan_.push_back("escaneo paralelo de " + src.qualifier + ": " + std::to_string(rows.size()) + " filas");
+                return rows;
+            }
+            rows = std::move(src.derived.rows);
+            for (const Conjunct& c : pushed[s]) {
+                Bound b = bind(*c.expr, Context{&scope});
+                std::erase_if(rows, [&](const table::ResultRow& row) {
+                    auto get = [&](size_t slot) -> const Value& { return row[slot - src.offset]; };
+                    auto t = truth(eval(b, get));
+                    return !t || !*t;
+                });
+            }
+            plan_.push_back("subconsulta " + src.qualifier + ": " + std::to_string(rows.size()) + " filas");
+            return rows;
+        };
+
+        std::vector<table::ResultRow> rows = rowsOf(0);
+        for (size_t j = 0; j < joinKeys.size(); ++j) {
+            const Source& right = sources[j + 1];
+            std::vector<table::ResultRow> rightRows = rowsOf(j + 1);
+            std::vector<size_t> leftColumns, rightColumns;
+            for (const EquiKey& k : joinKeys[j]) {
+                leftColumns.push_back(k.left);
+                rightColumns.push_back(k.right - right.offset);
+            }
+            auto hasNull = [](const table::ResultRow& row, const std::vector<size_t>& columns) {
+                return std::any_of(columns.begin(), columns.end(), [&](size_t c) { return row[c].isNull(); });
+            };
+            std::unordered_multimap<std::string, size_t> table;
+            for (size_t r = 0; r < rightRows.size(); ++r) {
+                if (!hasNull(rightRows[r], rightColumns)) table.emplace(keyOf(rightRows[r], rightColumns), r);
+            }
+            std::vector<table::ResultRow> joined;
+            for (const auto& row : rows) {
+                if (hasNull(row, leftColumns)) continue;
+                auto [begin, end] = table.equal_range(keyOf(row, leftColumns));
+                std::vector<size_t> matches;
+                for (auto it = begin; it != end; ++it) matches.push_back(it->second);
+                std::sort(matches.begin(), matches.end());
+                for (size_t r : matches) {
+                    table::ResultRow out = row;
+                    out.insert(out.end(), rightRows[r].begin(), rightRows[r].end());
+                    joined.push_back(std::move(out));
+                }
+            }
+            rows = std::move(joined);
+            plan_.push_back("JOIN en memoria con " + right.qualifier + ": " + std::to_string(rows.size()) + " filas");
+        }
+        return rows;
+    }
+
+    // SELECT, HAVING, ORDER BY y LIMIT sobre filas de ctx
+    Relation project(const std::vector<hql::SelectItem>& selectItems, const hql::ExprPtr& having,
+                     const std::vector<hql::OrderItem>& orderBy, int64_t limit, const Context& ctx,
+                     std::vector<table::ResultRow> rows) const {
+        if (having) {
+            if (!ctx.grouped()) fail("HAVING sin GROUP BY");
+            Bound b = bind(*having, ctx);
+            std::erase_if(rows, [&](const table::ResultRow& row) {
+                auto t = truth(eval(b, [&](size_t slot) -> const Value& { return row[slot]; }));
+                return !t || !*t;
+            });
+        }
+
+        Relation out;
+        std::vector<Bound> items;
+        for (size_t i = 0; i < selectItems.size(); ++i) {
+            const hql::SelectItem& item = selectItems[i];
+            if (!item.expr) {
+                for (size_t c = 0; c < ctx.scope->columns.size(); ++c) {
+                    Bound b;
+                    b.kind = Expr::Kind::Column;
+                    b.slot = int(c);
+                    b.type = ctx.scope->columns[c].type;
+                    items.push_back(b);
+                    out.columns.push_back({ctx.scope->columns[c].name, b.type});
+                }
+                continue;
+            }
+            items.push_back(bind(*item.expr, ctx));
+            std::string name = !item.alias.empty() ? item.alias
+                               : item.expr->kind == Expr::Kind::Column ? item.expr->name
+                                                                       : "_c" + std::to_string(i);
+            out.columns.push_back({name, items.back().type});
+        }
+
+        // ORDER BY: un nombre de la salida, o una expresión que se evalúa
+        // como columna oculta
+        size_t visible = items.size();
+        std::vector<table::SortKey> order;
+        for (const auto& item : orderBy) {
+            int column = -1;
+            if (item.expr->kind == Expr::Kind::Column && item.expr->qualifier.empty()) {
+                for (size_t c = 0; c < visible; ++c) {
+                    if (sameName(out.columns[c].name, item.expr->name)) column = int(c);
+                }
+            }
+            if (column < 0) {
+                column = int(items.size());
+                items.push_back(bind(*item.expr, ctx));
+            }
+            order.push_back({size_t(column), item.descending});
+        }
+
+        out.rows.reserve(rows.size());
+        for (const auto& row : rows) {
+            auto get = [&](size_t slot) -> const Value& { return row[slot]; };
+            table::ResultRow result;
+            result.reserve(items.size());
+            for (const Bound& b : items) result.push_back(eval(b, get));
+            out.rows.push_back(std::move(result));
+        }
+        table::orderBy(out.rows, order);
+        if (limit >= 0 && out.rows.size() > size_t(limit)) out.rows.resize(size_t(limit));
+        for (auto& row : out.rows) row.resize(visible);
+        return out;
+    }
+
+    Options options_;
+    std::map<std::string, Table> tables_;  // nombre en minúsculas -> tabla
+    std::map<std::string, std::string> settings_;
+    std::vector<std::string> plan_;
+};
+
+}  // namespace executor
@@ -0,0 +1,153 @@
+#include <bits/stdc++.h>
+#include "executor.h"
+#include "hql.h"
+#include "table.h"
+using namespace std;
+using namespace chrono;
+
+// Corre los .hql de hive/ tal cual, sin Hadoop ni la JVM: parsea el script
+// (hql.h) y ejecuta cada sentencia con executor.h.
+//
+//   hiveLocal [-f] script.hql [opciones]
+//   hiveLocal -e 'SELECT ...; ...' [opciones]
+//
+//   --hilos N            hilos de los escaneos y los joins
+//   --ruta ORIGEN=DEST   LOAD DATA de una ruta que empieza con ORIGEN lee DEST
+//                        en su lugar (repetible)
+//   --delimitador C      delimitador de las tablas sin ROW FORMAT (Hive: \001)
+//   --almacen DIR        dónde escribe CREATE TABLE AS (por defecto ./almacen)
+//   --broadcast MB       tamaño máximo del lado construido en memoria del JOIN
+//   --temporal DIR       particiones del JOIN repartido
+//   --plan               muestra en la salida de errores cómo se ejecutó cada
+//                        sentencia
+//
+// Como la consola de Hive, las filas de cada consulta y de cada CREATE TABLE
+// AS salen por la salida estándar separadas por tabuladores; el script se
+// detiene en el primer error.
+
+// "\001", "\t", "\n" o un carácter
+optional<char> parseDelimiter(const string& text) {
+    if (text == "\\t") return '\t';
+    if (text == "\\n") return '\n';
+    if (text.size() > 1 && text[0] == '\\') return char(stoi(text.substr(1), nullptr, 8));
+    if (text.size() == 1) return text[0];
+    return nullopt;
+}
+
+void printRows(const executor::Relation& result) {
+    string out;
+    for (const auto& row : result.rows) {
+        for (size_t c = 0; c < row.size(); ++c) {
+            if (c) out += '\t';
+            out += table::format(row[c]);
+        }
+        out += '\n';
+    }
+    cout << out << flush;
+}
+
+// Primera línea de la sentencia, para los mensajes
+string firstLine(const string& text) {
+    string line = text.substr(0, text.find('\n'));
+    return line.size() > 70 ? line.substr(0, 67) + "..." : line;
+}
+
+void usage(const char* program) {
+    cerr << "Uso: " << program << " [-f] script.hql [--hilos N] [--ruta ORIGEN=DEST]... [--delimitador C]\n"
+         << "         [--almacen DIR] [--broadcast MB] [--temporal DIR] [--plan]\n"
+         << "     " << program << " -e 'consulta; ...' [opciones]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    executor::Options options;
+    options.numThreads = max(1u, thread::hardware_concurrency());
+    string scriptPath, inlineScript;
+    bool showPlan = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--plan") {
+            showPlan = true;
+            continue;
+        }
+        if (arg.rfind("-", 0) != 0) {
+            scriptPath = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "-f") scriptPath = value;
+        else if (arg == "-e") inlineScript = value;
+        else if (arg == "--hilos") options.numThreads = max(1ul, stoul(value));
+        else if (arg == "--almacen") options.warehouse = value;
+        else if (arg == "--broadcast") options.join.broadcastBytes = uint64_t(stod(value) * (1 << 20));
+        else if (arg == "--temporal") options.join.tempDir = value;
+        else if (arg == "--ruta") {
+            size_t eq = value.find('=');
+            if (eq == string::npos) {
+                usage(argv[0]);
+                return 1;
+            }
+            options.paths.push_back({value.substr(0, eq), value.substr(eq + 1)});
+        } else if (arg == "--delimitador") {
+            auto delimiter = parseDelimiter(value);
+            if (!delimiter) {
+                cerr << "Delimitador inválido: " << value << endl;
+                return 1;
+            }
+            options.defaultDelimiter = *delimiter;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (scriptPath.empty() == inlineScript.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    string script = inlineScript;
+    if (!scriptPath.empty()) {
+        ifstream in(scriptPath, ios::binary);
+        if (!in) {
+            cerr << "No se pudo abrir " << scriptPath << endl;
+            return 1;
+        }
+        script.assign(istreambuf_iterator<char>(in), {});
+    }
+
+    vector<hql::Statement> statements;
+    try {
+        statements = hql::parseScript(script);
+    } catch (const runtime_error& e) {
+        cerr << "FAILED: " << e.what() << endl;
+        return 1;
+    }
+
+    executor::Executor executor(options);
+    auto scriptStart = high_resolution_clock::now();
+    for (const auto& st : statements) {
+        auto startTime = high_resolution_clock::now();
+        optional<executor::Relation> result;
+        try {
+            result = executor.run(st);
+        } catch (const exception& e) {
+            cerr << "FAILED: " << firstLine(st.text) << " (línea " << st.line << "): " << e.what() << endl;
+            return 1;
+        }
+        duration<double> elapsed = high_resolution_clock::now() - startTime;
+        if (showPlan) {
+            cerr << "-- " << firstLine(st.text) << "\n";
+            for (const auto& step : executor.plan()) cerr << "   " << step << "\n";
+        }
+        if (result) {
+            printRows(*result);
+            cerr << "OK, " << result->rows.size() << " filas en " << elapsed.count() << " segundos" << endl;
+        }
+    }
+    duration<double> elapsed = high_resolution_clock::now() - scriptStart;
+    cerr << "Sentencias: " << statements.size() << ", tiempo: " << elapsed.count() << " segundos" << endl;
+    return 0;
+}
@@ -0,0 +1,654 @@
+#pragma once
+#include <cctype>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "aggregate.h"
+#include "table.h"
+
+// Parser del subconjunto de HiveQL que usan los .hql de hive/:
+//
+//   SET clave=valor
+//   DROP TABLE [IF EXISTS] t
+//   CREATE TABLE t (col tipo, ...) [ROW FORMAT DELIMITED
+//       [FIELDS TERMINATED BY 'c'] [LINES TERMINATED BY '\n']] [STORED AS TEXTFILE]
+//   CREATE TABLE t AS consulta
+//   LOAD DATA [LOCAL] INPATH 'ruta' [OVERWRITE] INTO TABLE t
+//   consulta
+//
+//   consulta: SELECT expr [[AS] alias], ... FROM origen [[INNER] JOIN origen ON expr]...
+//             [WHERE expr] [GROUP BY expr, ...] [HAVING expr]
+//             [ORDER BY expr [ASC|DESC], ...] [LIMIT n]
+//   origen:   tabla [alias] | (consulta) alias
+//
+// Las expresiones son columnas ([tabla.]col), literales, + - * /,
+// comparaciones, AND/OR/NOT, IS [NOT] NULL y COUNT/SUM/AVG/MIN/MAX. Los
+// comentarios "--" llegan hasta el final de la línea. Un error de sintaxis
+// lanza std::runtime_error con la línea.
+namespace hql {
+
+struct Expr;
+using ExprPtr = std::shared_ptr<Expr>;
+
+struct Expr {
+    enum class Kind { Column, Literal, Aggregate, Binary, Not, Negate, IsNull } kind = Kind::Literal;
+    std::string qualifier, name;  // Column: [qualifier.]name
+    table::Value value;           // Literal
+    aggregate::Func func = aggregate::Func::Count;
+    bool star = false;            // Aggregate: COUNT(*) / COUNT(1), sin argumento
+    std::string op;               // Binary: = <> < <= > >= + - * / AND OR; IsNull: "NOT" si es IS NOT NULL
+    std::vector<ExprPtr> args;
+    std::string text;             // como estaba escrita, para los mensajes
+};
+
+struct SelectItem {
+    ExprPtr expr;  // nulo en SELECT *
+    std::string alias;
+};
+
+struct Select;
+
+struct TableRef {
+    std::string table;                // tabla del catálogo, o vacío si es subconsulta
+    std::shared_ptr<Select> subquery;
+    std::string alias;
+};
+
+struct JoinClause {
+    TableRef right;
+    ExprPtr on;
+};
+
+struct OrderItem {
+    ExprPtr expr;
+    bool descending = false;
+};
+
+struct Select {
+    std::vector<SelectItem> items;
+    TableRef from;
+    std::vector<JoinClause> joins;
+    ExprPtr where;
+    std::vector<ExprPtr> groupBy;
+    ExprPtr having;
+    std::vector<OrderItem> orderBy;
+    int64_t limit = -1;
+};
+
+struct Statement {
+    enum class Kind { Set, DropTable, CreateTable, CreateTableAs, Load, Query } kind = Kind::Query;
+    std::string name;                   // tabla, o clave de SET
+    std::string value;                  // valor de SET
+    bool ifExists = false;
+    std::vector<table::Column> columns; // CREATE TABLE
+    char delimiter = '\001';
+    bool delimited = false;             // trae FIELDS TERMINATED BY
+    std::string path;                   // LOAD DATA
+    bool overwrite = false;
+    std::shared_ptr<Select> query;      // CREATE TABLE AS y consultas
+    std::string text;                   // la sentencia tal cual
+    int line = 1;
+};
+
+inline std::string lower(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = char(std::tolower(static_cast<unsigned char>(c)));
+    return out;
+}
+
+inline std::string upper(std::string_view s) {
+    std::string out(s);
+    for (char& c : out) c = char(std::toupper(static_cast<unsigned char>(c)));
+    return out;
+}
+
+struct Token {
+    enum class Type { Word, String, Number, Symbol, End } type = Type::End;
+    std::string text;  // String: ya sin comillas ni escapes
+    int line = 1;
+};
+
+// Escapes de los literales de Hive: \n, \t, \\, \' y octales como \001
+inline std::string unescape(std::string_view s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '\\' || i + 1 == s.size()) {
+            out += s[i];
+            continue;
+        }
+        char c = s[++i];
+        if (c >= '0' && c <= '7') {
+            int v = 0, digits = 0;
+            while (digits < 3 && i < s.size() && s[i] >= '0' && s[i] <= '7') v = v * 8 + (s[i++] - '0'), ++digits;
+            --i;
+            out += char(v);
+        } else if (c == 'n') out += '\n';
+        else if (c == 't') out += '\t';
+        else if (c == 'r') out += '\r';
+        else out += c;
+    }
+    return out;
+}
+
+class Lexer {
+public:
+    explicit Lexer(std::string_view text, int line = 1) : text_(text), line_(line) {}
+
+    std::vector<Token> tokens() {
+        std::vector<Token> out;
+        for (;;) {
+            skipSpace();
+            Token t;
+            t.line = line_;
+            if (pos_ >= text_.size()) {
+                out.push_back(t);
+                return out;
+            }
+            char c = text_[pos_];
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+                t.type = Token::Type::Word;
+                size_t begin = pos_;
+                while (pos_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '_')) ++pos_;
+                t.text = text_.substr(begin, pos_ - begin);
+            } else if (c == '`') {
+                // `identificador`
+                size_t end = text_.find('`', pos_ + 1);
+                if (end == std::string_view::npos) error("falta cerrar `");
+                t.type = Token::Type::Word;
+                t.text = text_.substr(pos_ + 1, end - pos_ - 1);
+                pos_ = end + 1;
+            } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+                       (c == '.' && pos_ + 1 < text_.size() && std::isdigit(static_cast<unsigned char>(text_[pos_ + 1])))) {
+                t.type = Token::Type::Number;
+                size_t begin = pos_;
+                while (pos_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '.')) ++pos_;
+                t.text = text_.substr(begin, pos_ - begin);
+            } else if (c == '\'' || c == '"') {
+                t.type = Token::Type::String;
+                size_t begin = ++pos_;
+                while (pos_ < text_.size() && text_[pos_] != c) {
+                    if (text_[pos_] == '\\') ++pos_;
+                    if (pos_ < text_.size() && text_[pos_] == '\n') ++line_;
+                    ++pos_;
+                }
+                if (pos_ >= text_.size()) error("falta cerrar la cadena");
+                t.text = unescape(text_.substr(begin, pos_ - begin));
+                ++pos_;
+            } else {
+                t.type = Token::Type::Symbol;
+                std::string_view two = text_.substr(pos_, 2);
+                if (two == "<=" || two == ">=" || two == "<>" || two == "!=" || two == "==") {
+                    t.text = two;
+                    pos_ += 2;
+                } else {
+                    t.text = std::string(1, c);
+                    ++pos_;
+                }
+            }
+            out.push_back(std::move(t));
+        }
+    }
+
+private:
+    void skipSpace() {
+        while (pos_ < text_.size()) {
+            if (text_[pos_] == '\n') {
+                ++line_;
+                ++pos_;
+            } else if (std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+                ++pos_;
+            } else if (text_.substr(pos_, 2) == "--") {
+                while (pos_ < text_.size() && text_[pos_] != '\n') ++pos_;
+            } else {
+                break;
+            }
+        }
+    }
+
+    [[noreturn]] void error(const std::string& what) const {
+        throw std::runtime_error("línea " + std::to_string(line_) + ": " + what);
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+    int line_;
+};
+
+class Parser {
+public:
+    explicit Parser(std::vector<Token> tokens) : tokens_(std::move(tokens)) {}
+
+    Statement statement() {
+        Statement st;
+        st.line = peek().line;
+        if (accept("SET")) {
+            // SET clave=valor: el resto se toma tal cual
+            st.kind = Statement::Kind::Set;
+            std::string text;
+            while (!atEnd()) text += next().text;
+            size_t eq = text.find('=');
+            if (eq == std::string::npos) error("SET sin '='");
+            st.name = lower(text.substr(0, eq));
+            st.value = text.substr(eq + 1);
+            return st;
+        }
+        if (accept("DROP")) {
+            expect("TABLE");
+            st.kind = Statement::Kind::DropTable;
+            if (accept("IF")) {
+                expect("EXISTS");
+                st.ifExists = true;
+            }
+            st.name = identifier();
+        } else if (accept("CREATE")) {
+            accept("EXTERNAL");
+            expect("TABLE");
+            if (accept("IF")) {
+                expect("NOT");
+                expect("EXISTS");
+                st.ifExists = true;
+            }
+            st.name = identifier();
+            if (acceptSymbol("(")) {
+                st.kind = Statement::Kind::CreateTable;
+                do {
+                    std::string column = identifier();
+                    std::string type = identifier();
+                    if (acceptSymbol("(")) {
+                        // DECIMAL(10,2), VARCHAR(20): la precisión no se usa
+                        while (!atEnd() && !acceptSymbol(")")) next();
+                    }
+                    auto parsed = table::parseType(type);
+                    if (!parsed) error("tipo no soportado: " + type);
+                    st.columns.push_back({column, *parsed});
+                } while (acceptSymbol(","));
+                expectSymbol(")");
+                tableOptions(st);
+            } else {
+                st.kind = Statement::Kind::CreateTableAs;
+                tableOptions(st);
+                expect("AS");
+                st.query = select();
+            }
+        } else if (accept("LOAD")) {
+            expect("DATA");
+            accept("LOCAL");
+            expect("INPATH");
+            st.kind = Statement::Kind::Load;
+            st.path = string();
+            st.overwrite = accept("OVERWRITE");
+            expect("INTO");
+            expect("TABLE");
+            st.name = identifier();
+        } else if (is("SELECT")) {
+            st.kind = Statement::Kind::Query;
+            st.query = select();
+        } else {
+            error("sentencia no soportada");
+        }
+        if (!atEnd()) error("sobra '" + peek().text + "'");
+        return st;
+    }
+
+private:
+    // ROW FORMAT DELIMITED ... y STORED AS ..., en cualquier orden
+    void tableOptions(Statement& st) {
+        for (;;) {
+            if (accept("ROW")) {
+                expect("FORMAT");
+                expect("DELIMITED");
+                while (is("FIELDS") || is("LINES") || is("COLLECTION") || is("MAP")) {
+                    std::string what = upper(next().text);
+                    if (what == "COLLECTION") expect("ITEMS");
+                    if (what == "MAP") expect("KEYS");
+                    expect("TERMINATED");
+                    expect("BY");
+                    std::string delimiter = string();
+                    if (delimiter.size() != 1) error("delimitador de más de un carácter");
+                    if (what == "FIELDS") {
+                        st.delimiter = delimiter[0];
+                        st.delimited = true;
+                    } else if (what == "LINES" && delimiter != "\n") {
+                        error("solo se admite LINES TERMINATED BY '\\n'");
+                    }
+                }
+            } else if (accept("STORED")) {
+                expect("AS");
+                std::string format = upper(identifier());
+                if (format != "TEXTFILE") error("solo se admite STORED AS TEXTFILE");
+            } else {
+                return;
+            }
+        }
+    }
+
+    std::shared_ptr<Select> select() {
+        auto q = std::make_shared<Select>();
+        expect("SELECT");
+        accept("ALL");
+        if (is("DISTINCT")) error("DISTINCT no soportado");
+        do {
+            SelectItem item;
+            if (!acceptSymbol("*")) {
+                item.expr = expr();
+                if (accept("AS")) item.alias = identifier();
+                else if (peek().type == Token::Type::Word && !isKeyword(peek().text)) item.alias = identifier();
+            }
+            q->items.push_back(std::move(item));
+        } while (acceptSymbol(","));
+        expect("FROM");
+        q->from = tableRef();
+        for (;;) {
+            accept("INNER");
+            if (!accept("JOIN")) {
+                if (is("LEFT") || is("RIGHT") || is("FULL") || is("CROSS")) error("solo se admite JOIN interno");
+                break;
+            }
+            JoinClause join;
+            join.right = tableRef();
+            expect("ON");
+            join.on = expr();
+            q->joins.push_back(std::move(join));
+        }
+        if (accept("WHERE")) q->where = expr();
+        if (accept("GROUP")) {
+            expect("BY");
+            do q->groupBy.push_back(expr());
+            while (acceptSymbol(","));
+        }
+        if (accept("HAVING")) q->having = expr();
+        if (accept("ORDER") || accept("SORT")) {
+            expect("BY");
+            do {
+                OrderItem item{expr()};
+                if (accept("DESC")) item.descending = true;
+                else accept("ASC");
+                q->orderBy.push_back(std::move(item));
+            } while (acceptSymbol(","));
+        }
+        if (accept("LIMIT")) {
+            if (peek().type != Token::Type::Number) error("LIMIT espera un número");
+            q->limit = std::stoll(next().text);
+        }
+        return q;
+    }
+
+    TableRef tableRef() {
+        TableRef ref;
+        if (acceptSymbol("(")) {
+            ref.subquery = select();
+            expectSymbol(")");
+            accept("AS");
+            if (peek().type != Token::Type::Word || isKeyword(peek().text)) error("la subconsulta necesita un alias");
+            ref.alias = identifier();
+            return ref;
+        }
+        ref.table = identifier();
+        if (acceptSymbol(".")) ref.table = identifier();  // base.tabla: solo hay una base
+        if (accept("AS") || (peek().type == Token::Type::Word && !isKeyword(peek().text))) ref.alias = identifier();
+        return ref;
+    }
+
+    // Precedencia: OR < AND < NOT < comparación < + - < * / < signo
+    ExprPtr expr() { return orExpr(); }
+
+    ExprPtr orExpr() {
+        ExprPtr left = andExpr();
+        while (accept("OR")) left = binary("OR", left, andExpr());
+        return left;
+    }
+
+    ExprPtr andExpr() {
+        ExprPtr left = notExpr();
+        while (accept("AND")) left = binary("AND", left, notExpr());
+        return left;
+    }
+
+    ExprPtr notExpr() {
+        if (accept("NOT") || acceptSymbol("!")) {
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::Not;
+            e->args.push_back(notExpr());
+            e->text = "NOT " + e->args[0]->text;
+            return e;
+        }
+        return comparison();
+    }
+
+    ExprPtr comparison() {
+        ExprPtr left = additive();
+        if (accept("IS")) {
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::IsNull;
+            if (accept("NOT")) e->op = "NOT";
+            expect("NULL");
+            e->args.push_back(left);
+            e->text = left->text + " IS " + (e->op.empty() ? "" : "NOT ") + "NULL";
+            return e;
+        }
+        static const char* const kOps[] = {"=", "==", "<>", "!=", "<", "<=", ">", ">="};
+        for (const char* op : kOps) {
+            if (acceptSymbol(op)) {
+                std::string name = op;
+                if (name == "==") name = "=";
+                if (name == "!=") name = "<>";
+                return binary(name, left, additive());
+            }
+        }
+        return left;
+    }
+
+    ExprPtr additive() {
+        ExprPtr left = multiplicative();
+        for (;;) {
+            if (acceptSymbol("+")) left = binary("+", left, multiplicative());
+            else if (acceptSymbol("-")) left = binary("-", left, multiplicative());
+            else return left;
+        }
+    }
+
+    ExprPtr multiplicative() {
+        ExprPtr left = unary();
+        for (;;) {
+            if (acceptSymbol("*")) left = binary("*", left, unary());
+            else if (acceptSymbol("/")) left = binary("/", left, unary());
+            else return left;
+        }
+    }
+
+    ExprPtr unary() {
+        if (acceptSymbol("-")) {
+            auto e = std::make_shared<Expr>();
+            e->kind = Expr::Kind::Negate;
+            e->args.push_back(unary());
+            e->text = "-" + e->args[0]->text;
+            return e;
+        }
+        acceptSymbol("+");
+        return primary();
+    }
+
+    ExprPtr primary() {
+        auto e = std::make_shared<Expr>();
+        const Token& t = peek();
+        if (acceptSymbol("(")) {
+            ExprPtr inner = expr();
+            expectSymbol(")");
+            return inner;
+        }
+        if (t.type == Token::Type::Number) {
+            std::string text = next().text;
+            e->kind = Expr::Kind::Literal;
+            e->text = text;
+            if (auto i = table::toInt(text)) e->value = table::Value::ofInt(*i);
+            else if (auto d = table::toDouble(text)) e->value = table::Value::ofDouble(*d);
+            else error("número inválido: " + text);
+            return e;
+        }
+        if (t.type == Token::Type::String) {
+            e->kind = Expr::Kind::Literal;
+            e->value = table::Value::ofString(t.text);
+            e->text = "'" + next().text + "'";
+            return e;
+        }
+        if (t.type != Token::Type::Word) error("se esperaba una expresión en '" + t.text + "'");
+        if (accept("NULL")) {
+            e->kind = Expr::Kind::Literal;
+            e->text = "NULL";
+            return e;
+        }
+        if (is("TRUE") || is("FALSE")) {
+            e->kind = Expr::Kind::Literal;
+            e->value = table::Value::ofInt(upper(t.text) == "TRUE");
+            e->text = upper(next().text);
+            return e;
+        }
+        std::string name = identifier();
+        if (acceptSymbol("(")) {
+            std::string function = upper(name);
+            e->kind = Expr::Kind::Aggregate;
+            if (function == "COUNT") e->func = aggregate::Func::Count;
+            else if (function == "SUM") e->func = aggregate::Func::Sum;
+            else if (function == "AVG") e->func = aggregate::Func::Avg;
+            else if (function == "MIN") e->func = aggregate::Func::Min;
+            else if (function == "MAX") e->func = aggregate::Func::Max;
+            else error("función no soportada: " + name);
+            if (is("DISTINCT")) error("DISTINCT no soportado");
+            if (acceptSymbol("*")) {
+                if (e->func != aggregate::Func::Count) error(name + "(*) no existe");
+                e->star = true;
+            } else {
+                e->args.push_back(expr());
+                // COUNT(1) cuenta filas como COUNT(*)
+                const Expr& a = *e->args[0];
+                if (e->func == aggregate::Func::Count && a.kind == Expr::Kind::Literal && !a.value.isNull()) {
+                    e->star = true;
+                    e->args.clear();
+                }
+            }
+            expectSymbol(")");
+            e->text = function + "(" + (e->args.empty() ? (e->star ? "*" : "") : e->args[0]->text) + ")";
+            return e;
+        }
+        e->kind = Expr::Kind::Column;
+        if (acceptSymbol(".")) {
+            e->qualifier = name;
+            e->name = identifier();
+            e->text = e->qualifier + "." + e->name;
+        } else {
+            e->name = name;
+            e->text = name;
+        }
+        return e;
+    }
+
+    static ExprPtr binary(const std::string& op, ExprPtr left, ExprPtr right) {
+        auto e = std::make_shared<Expr>();
+        e->kind = Expr::Kind::Binary;
+        e->op = op;
+        e->text = left->text + " " + op + " " + right->text;
+        e->args = {std::move(left), std::move(right)};
+        return e;
+    }
+
+    // Palabras que no pueden ser alias
+    static bool isKeyword(std::string_view word) {
+        static const char* const kWords[] = {"FROM",  "WHERE", "GROUP", "HAVING", "ORDER", "SORT", "LIMIT",
+                                             "JOIN",  "INNER", "LEFT",  "RIGHT",  "FULL",  "CROSS", "ON",
+                                             "AS",    "AND",   "OR",    "NOT",    "IS",    "ROW",  "STORED",
+                                             "UNION", "SELECT"};
+        std::string w = upper(word);
+        for (const char* k : kWords) {
+            if (w == k) return true;
+        }
+        return false;
+    }
+
+    const Token& peek() const { return tokens_[std::min(pos_, tokens_.size() - 1)]; }
+    const Token& next() {
+        const Token& t = peek();
+        if (pos_ < tokens_.size()) ++pos_;
+        return t;
+    }
+    bool atEnd() const { return peek().type == Token::Type::End; }
+    bool is(const char* word) const { return peek().type == Token::Type::Word && upper(peek().text) == word; }
+    bool accept(const char* word) {
+        if (!is(word)) return false;
+        next();
+        return true;
+    }
+    bool acceptSymbol(const char* symbol) {
+        if (peek().type != Token::Type::Symbol || peek().text != symbol) return false;
+        next();
+        return true;
+    }
+    void expect(const char* word) {
+        if (!accept(word)) error(std::string("se esperaba ") + word);
+    }
+    void expectSymbol(const char* symbol) {
+        if (!acceptSymbol(symbol)) error(std::string("se esperaba '") + symbol + "'");
+    }
+    std::string identifier() {
+        if (peek().type != Token::Type::Word) error("se esperaba un nombre en '" + peek().text + "'");
+        return next().text;
+    }
+    std::string string() {
+        if (peek().type != Token::Type::String) error("se esperaba una cadena");
+        return next().text;
+    }
+
+    [[noreturn]] void error(const std::string& what) const {
+        throw std::runtime_error("línea " + std::to_string(peek().line) + ": " + what);
+    }
+
+    std::vector<Token> tokens_;
+    size_t pos_ = 0;
+};
+
+// Parte el script en sentencias por ';' (fuera de cadenas y comentarios) y
+// las parsea
+inline std::vector<Statement> parseScript(std::string_view script) {
+    std::vector<Statement> out;
+    size_t begin = 0;
+    int line = 1, startLine = 1;
+    char quote = 0;
+    bool comment = false;
+    for (size_t i = 0; i <= script.size(); ++i) {
+        char c = i < script.size() ? script[i] : ';';
+        if (c == '\n') {
+            ++line;
+            comment = false;
+            continue;
+        }
+        if (comment) continue;
+        if (quote) {
+            if (c == '\\') ++i;
+            else if (c == quote) quote = 0;
+            continue;
+        }
+        if (c == '\'' || c == '"') quote = c;
+        else if (c == '-' && i + 1 < script.size() && script[i + 1] == '-') comment = true;
+        else if (c == ';') {
+            std::string_view text = script.substr(begin, std::min(i, script.size()) - begin);
+            std::vector<Token> tokens = Lexer(text, startLine).tokens();
+            if (tokens.size() > 1) {
+                Statement st = Parser(std::move(tokens)).statement();
+                // Sin los comentarios que la preceden
+                size_t first = text.find_first_not_of(" \t\r\n");
+                while (text.substr(first, 2) == "--") {
+                    first = text.find_first_not_of(" \t\r\n", text.find('\n', first));
+                }
+                st.text = std::string(text.substr(first));
+                out.push_back(std::move(st));
+            }
+            begin = i + 1;
+            startLine = line;
+        }
+    }
+    return out;
+}
+
+}  // namespace hql
@@ -0,0 +1,405 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/tokenizer.h"
+#include "../common/word_table.h"
+#include "../common/work_pool.h"
+#include "aggregate.h"
+#include "table.h"
+
+// Hash join con la agregación empujada al lado de sondeo: las filas unidas
+// no se guardan nunca, cada coincidencia va directo al Partial del hilo y el
+// filtro tipo HAVING se aplica después sobre los grupos.
+//
+// Dos estrategias:
+//   Broadcast    el lado de construcción cabe en memoria: se carga una vez y
+//                todos los hilos sondean la misma tabla mientras recorren el
+//                lado grande en trozos.
+//   Partitioned  los dos lados son grandes: cada hilo reparte las líneas de
+//                ambos por los bits altos del hash de la clave en a lo sumo
+//                kMaxPartitions archivos de partición (un lado después del
+//                otro); luego cada partición se une por separado en el pool
+//                con robo de trabajo. Una partición de construcción que aún
+//                no cabe en partitionBytes se vuelve a partir con los bits
+//                siguientes del hash antes de unirla.
+namespace join {
+
+// Una entrada del join, la columna de su clave y el filtro del WHERE que
+// solo mira este lado (se aplica al leerlo, antes de unir)
+struct Side {
+    std::vector<std::string> files;
+    table::Schema schema;
+    int key = 0;
+    table::RowFilter filter;
+};
+
+enum class Strategy { Broadcast, Partitioned };
+
+// Particiones por pasada: acota los archivos abiertos y los búferes de cada
+// lado; si no alcanzan, las particiones grandes se parten otra vez
+constexpr int kMaxPartitionBits = 6;
+
+struct Options {
+    size_t numThreads = 1;
+    uint64_t broadcastBytes = uint64_t(256) << 20;  // lado de construcción máximo para Broadcast
+    uint64_t partitionBytes = uint64_t(64) << 20;   // construcción objetivo por partición
+    std::string tempDir;                            // vacío: el directorio temporal del sistema
+};
+
+// Fila unida: las columnas de probe y luego las de build
+inline table::Schema joinedSchema(const Side& probe, const Side& build) {
+    table::Schema schema;
+    schema.columns = probe.schema.columns;
+    schema.columns.insert(schema.columns.end(), build.schema.columns.begin(), build.schema.columns.end());
+    return schema;
+}
+
+inline uint64_t totalBytes(const std::vector<std::string>& files) {
+    uint64_t bytes = 0;
+    std::error_code error;
+    for (const auto& f : files) {
+        uint64_t size = std::filesystem::file_size(f, error);
+        if (!error) bytes += size;
+    }
+    return bytes;
+}
+
+inline bool readWhole(const std::string& path, std::string& out) {
+    std::vector<FileChunk> whole = plan_chunks({path}, UINT64_MAX);
+    return !whole.empty() && read_chunk(path, whole[0], out);
+}
+
+// Lado de construcción en memoria: clave -> cadena de filas con esa clave
+class BuildTable {
+public:
+    // Solo se separan las primeras limit columnas de cada línea
+    explicit BuildTable(const Side& side, size_t limit = SIZE_MAX)
+        : schema_(&side.schema), filter_(&side.filter), key_(size_t(side.key)), limit_(limit) {}
+
+    // Se queda con text; las filas apuntan a él
+    void addText(std::string text) {
+        instr::Scope scope(instr::Stage::Insert);
+        texts_.push_back(std::move(text));
+        size_t columns = schema_->columns.size();
+        table::forEachLine(texts_.back(), [&](std::string_view line) {
+            table::splitRow(line, *schema_, row_, limit_);
+            if (row_.isNull(key_) || !(*filter_)(row_)) return;  // NULL no une con nada
+            uint32_t r = uint32_t(next_.size());
+            for (size_t c = 0; c < columns; ++c) fields_.push_back(row_.isNull(c) ? table::kNullText : row_[c]);
+            uint32_t& head = heads_.value_hashed(row_[key_], tok::hash_word(row_[key_]));
+            next_.push_back(head);
+            head = r + 1;
+        });
+    }
+
+    // fn(campos) por cada fila cuya clave es key
+    template <class Fn>
+    void forEachMatch(std::string_view key, uint64_t hash, Fn&& fn) const {
+        size_t columns = schema_->columns.size();
+        for (uint32_t r = heads_.count_hashed(key, hash); r != 0; r = next_[r - 1]) {
+            fn(&fields_[size_t(r - 1) * columns]);
+        }
+    }
+
+    void prefetch(uint64_t hash) const { heads_.prefetch(hash); }
+
+    size_t rows() const { return next_.size(); }
+
+private:
+    const table::Schema* schema_;
+    const table::RowFilter* filter_;
+    size_t key_;
+    size_t limit_;
+    std::deque<std::string> texts_;  // deque: las cadenas no se mueven al crecer
+    std::vector<std::string_view> fields_;
+    std::vector<uint32_t> next_;     // fila anterior con la misma clave + 1
+    WordTable<uint32_t> heads_;      // clave -> última fila + 1
+    table::Row row_;
+};
+
+// Sondea las líneas de text contra build y agrega cada fila unida en
+// partial. Las líneas van en lotes de aggregate::kBatch: primero se separan
+// y se calculan los hashes de todo el lote, después se buscan, así los
+// fallos de caché de las búsquedas se solapan.
+inline void probeChunk(std::string_view text, const Side& probe, const BuildTable& build, size_t buildColumns,
+                       aggregate::Partial& partial, size_t limit = SIZE_MAX) {
+    thread_local table::Row row, joined;
+    thread_local std::vector<std::string_view> fields;
+    thread_local std::vector<uint64_t> hashes;
+    const size_t probeColumns = probe.schema.columns.size();
+    const size_t key = size_t(probe.key);
+    joined.fields.resize(probeColumns + buildColumns);
+    joined.present = probeColumns + buildColumns;
+    uint64_t rows = 0;
+
+    auto probeBatch = [&] {
+        size_t n = hashes.size();
+        for (size_t i = 0; i < n; ++i) build.prefetch(hashes[i]);
+        for (size_t i = 0; i < n; ++i) {
+            const std::string_view* probeFields = &fields[i * probeColumns];
+            build.forEachMatch(probeFields[key], hashes[i], [&](const std::string_view* buildFields) {
+                std::copy(probeFields, probeFields + probeColumns, joined.fields.begin());
+                std::copy(buildFields, buildFields + buildColumns, joined.fields.begin() + probeColumns);
+                partial.add(joined);
+            });
+        }
+        fields.clear();
+        hashes.clear();
+    };
+
+    table::forEachLine(text, [&](std::string_view line) {
+        ++rows;
+        table::splitRow(line, probe.schema, row, limit);
+        if (row.isNull(key) || !probe.filter(row)) return;
+        for (size_t c = 0; c < probeColumns; ++c) fields.push_back(row.isNull(c) ? table::kNullText : row[c]);
+        hashes.push_back(tok::hash_word(row[key]));
+        if (hashes.size() == aggregate::kBatch) probeBatch();
+    });
+    probeBatch();
+    // Los campos apuntan a text: se agregan antes de soltar el trozo
+    partial.flush();
+    instr::add_tokens(rows);
+}
+
+inline bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+// Archivos de partición de un lado: cada hilo acumula líneas por partición y
+// las escribe en bloques bajo el lock de la partición. finish() cierra los
+// archivos y suelta los búferes.
+class Partitioner {
+public:
+    static constexpr size_t kFlushBytes = 64 << 10;
+
+    Partitioner(const std::string& prefix, size_t numPartitions, size_t numThreads)
+        : buffers_(numThreads, std::vector<std::string>(numPartitions)), locks_(numPartitions) {
+        for (size_t p = 0; p < numPartitions; ++p) {
+            paths_.push_back(prefix + "_" + std::to_string(p));
+            fds_.push_back(::open(paths_.back().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+            if (fds_.back() < 0) failed_ = true;
+        }
+    }
+    Partitioner(const Partitioner&) = delete;
+    Partitioner& operator=(const Partitioner&) = delete;
+    ~Partitioner() {
+        for (int fd : fds_) {
+            if (fd >= 0) ::close(fd);
+        }
+    }
+
+    void add(size_t worker, size_t partition, std::string_view line) {
+        std::string& buffer = buffers_[worker][partition];
+        buffer += line;
+        buffer += '\n';
+        if (buffer.size() >= kFlushBytes) write(worker, partition);
+    }
+
+    // Escribe lo pendiente y cierra los archivos
+    bool finish() {
+        for (size_t w = 0; w < buffers_.size(); ++w) {
+            for (size_t p = 0; p < fds_.size(); ++p) write(w, p);
+        }
+        std::vector<std::vector<std::string>>().swap(buffers_);
+        for (int& fd : fds_) {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+        }
+        return !failed_;
+    }
+
+    const std::vector<std::string>& paths() const { return paths_; }
+
+private:
+    void write(size_t worker, size_t partition) {
+        std::string& buffer = buffers_[worker][partition];
+        if (buffer.empty()) return;
+        instr::Scope scope(instr::Stage::Serialize);
+        auto lock = instr::timed_lock(locks_[partition]);
+        if (fds_[partition] < 0 || !writeAll(fds_[partition], buffer.data(), buffer.size())) failed_ = true;
+        buffer.clear();
+    }
+
+    std::vector<std::vector<std::string>> buffers_;  // hilo -> partición -> líneas
+    std::vector<std::mutex> locks_;
+    std::vector<std::string> paths_;
+    std::vector<int> fds_;
+    std::atomic<bool> failed_{false};
+};
+
+// Partición de hash con los bits [shift, shift + bits) contando desde el más alto
+inline size_t partitionOf(uint64_t hash, int shift, int bits) {
+    return bits == 0 ? 0 : size_t((hash << shift) >> (64 - bits));
+}
+
+// Bits para que bytes quede en partes de unos partitionBytes, con al menos
+// minBits y sin pasar de kMaxPartitionBits ni de los bits del hash que quedan
+inline int partitionBits(uint64_t bytes, uint64_t partitionBytes, int minBits, int shift) {
+    int bits = minBits;
+    while (bits < std::min(kMaxPartitionBits, 64 - shift) && (bytes >> bits) > std::max<uint64_t>(1, partitionBytes)) {
+        ++bits;
+    }
+    return bits;
+}
+
+// Reparte las líneas de files por el hash de su clave en prefix_0 ...
+// prefix_(2^bits - 1) y devuelve las rutas, o vacío si falla la escritura.
+// Las de clave NULL y las que no pasan el filtro se descartan porque no
+// unen con nada. Los búferes y archivos se sueltan antes de volver.
+inline std::vector<std::string> partitionSide(const Side& side, const std::vector<std::string>& files,
+                                              const std::string& prefix, int shift, int bits, size_t numThreads,
+                                              size_t limit = SIZE_MAX) {
+    Partitioner out(prefix, size_t(1) << bits, numThreads);
+    table::scanChunks(files, numThreads, [&](std::string_view text, size_t worker) {
+        thread_local table::Row row;
+        table::forEachLine(text, [&](std::string_view line) {
+            table::splitRow(line, side.schema, row, limit);
+            size_t key = size_t(side.key);
+            if (row.isNull(key) || !side.filter(row)) return;
+            out.add(worker, partitionOf(tok::hash_word(row[key]), shift, bits), line);
+        });
+    });
+    if (!out.finish()) return {};
+    return out.paths();
+}
+
+// Une una partición (rutas de sus dos lados) y agrega en partial. Si la de
+// construcción no cabe en partitionBytes, la vuelve a partir con los bits
+// del hash a partir de shift, mientras eso la achique. Borra los archivos
+// que consume; false si no pudo escribir una subpartición.
+inline bool joinPartition(const Side& probe, const Side& build, const std::string& probePath,
+                          const std::string& buildPath, int shift, uint64_t parentBytes, const Options& options,
+                          size_t buildColumns, size_t probeLimit, size_t buildLimit, aggregate::Partial& partial) {
+    std::error_code error;
+    uint64_t bytes = std::filesystem::file_size(buildPath, error);
+    if (error) bytes = 0;
+    if (bytes > options.partitionBytes && bytes < parentBytes && shift < 64) {
+        int bits = partitionBits(bytes, options.partitionBytes, 1, shift);
+        std::vector<std::string> buildParts = partitionSide(build, {buildPath}, buildPath, shift, bits, 1, buildLimit);
+        std::filesystem::remove(buildPath, error);
+        if (buildParts.empty()) return false;
+        std::vector<std::string> probeParts = partitionSide(probe, {probePath}, probePath, shift, bits, 1, probeLimit);
+        std::filesystem::remove(probePath, error);
+        if (probeParts.empty()) return false;
+        bool ok = true;
+        for (size_t p = 0; p < buildParts.size(); ++p) {
+            ok = joinPartition(probe, build, probeParts[p], buildParts[p], shift + bits, bytes, options, buildColumns,
+                               probeLimit, buildLimit, partial) && ok;
+        }
+        return ok;
+    }
+
+    BuildTable table(build, buildLimit);
+    std::string text;
+    if (readWhole(buildPath, text)) table.addText(std::move(text));
+    std::filesystem::remove(buildPath, error);
+    if (table.rows() > 0) {
+        std::string chunk;
+        for (const FileChunk& c : plan_chunks({probePath}, kDefaultChunkBytes, true)) {
+            {
+                instr::Scope scope(instr::Stage::Read);
+                if (!read_chunk(probePath, c, chunk)) break;
+            }
+            instr::add_bytes(chunk.size());
+            probeChunk(chunk, probe, table, buildColumns, partial, probeLimit);
+        }
+    }
+    std::filesystem::remove(probePath, error);
+    return true;
+}
+
+// SELECT claves, agregados FROM probe JOIN build ON probe.key = build.key
+// GROUP BY claves. keys y las columnas de specs son índices de
+// joinedSchema(probe, build). Devuelve las filas de aggregate::merge.
+inline std::vector<table::ResultRow> joinAggregate(const Side& probe, const Side& build, const std::vector<int>& keys,
+                                                   const std::vector<aggregate::Spec>& specs,
+                                                   const Options& options, Strategy* used = nullptr) {
+    size_t numThreads = std::max<size_t>(1, options.numThreads);
+    table::Schema schema = joinedSchema(probe, build);
+    size_t probeColumns = probe.schema.columns.size();
+    size_t buildColumns = build.schema.columns.size();
+    std::vector<aggregate::Partial> partials;
+    for (size_t t = 0; t < numThreads; ++t) partials.emplace_back(schema, keys, specs);
+
+    // Proyección: de cada lado se separan las columnas hasta la última que
+    // usan la clave, el filtro, las claves del GROUP BY y los agregados
+    size_t probeLimit = std::max(size_t(probe.key) + 1, probe.filter.keep ? probe.filter.columns : 0);
+    size_t buildLimit = std::max(size_t(build.key) + 1, build.filter.keep ? build.filter.columns : 0);
+    auto use = [&](int column) {
+        if (column < 0) return;
+        if (size_t(column) < probeColumns) probeLimit = std::max(probeLimit, size_t(column) + 1);
+        else buildLimit = std::max(buildLimit, size_t(column) - probeColumns + 1);
+    };
+    for (int k : keys) use(k);
+    for (const aggregate::Spec& spec : specs) use(spec.column);
+
+    uint64_t buildBytes = totalBytes(build.files);
+    if (buildBytes <= options.broadcastBytes) {
+        if (used) *used = Strategy::Broadcast;
+        BuildTable table(build, buildLimit);
+        for (const auto& f : build.files) {
+            std::string text;
+            if (readWhole(f, text)) table.addText(std::move(text));
+        }
+        table::scanChunks(probe.files, numThreads, [&](std::string_view text, size_t worker) {
+            probeChunk(text, probe, table, buildColumns, partials[worker], probeLimit);
+        });
+        return aggregate::merge(partials, numThreads);
+    }
+
+    // Particiones: potencia de dos con al menos una por hilo y una
+    // construcción de unos partitionBytes en cada una, hasta kMaxPartitionBits
+    if (used) *used = Strategy::Partitioned;
+    int minBits = 0;
+    while ((size_t(1) << minBits) < numThreads) ++minBits;
+    int bits = partitionBits(buildBytes, options.partitionBytes, minBits, 0);
+    namespace fs = std::filesystem;
+    fs::path dir = options.tempDir.empty() ? fs::temp_directory_path() : fs::path(options.tempDir);
+    dir /= "join_" + std::to_string(::getpid());
+    fs::create_directories(dir);
+
+    // Un lado por vez: los búferes y archivos del de construcción se sueltan
+    // antes de partir el de sondeo
+    std::vector<std::string> buildParts =
+        partitionSide(build, build.files, (dir / "build").string(), 0, bits, numThreads, buildLimit);
+    std::vector<std::string> probeParts;
+    if (!buildParts.empty()) {
+        probeParts = partitionSide(probe, probe.files, (dir / "probe").string(), 0, bits, numThreads, probeLimit);
+    }
+    std::atomic<bool> ok(!probeParts.empty());
+    if (ok) {
+        run_work_stealing(buildParts.size(), numThreads, [&](size_t p, size_t worker) {
+            if (!joinPartition(probe, build, probeParts[p], buildParts[p], bits, UINT64_MAX, options, buildColumns,
+                               probeLimit, buildLimit, partials[worker])) {
+                ok = false;
+            }
+        });
+    }
+    std::error_code error;
+    fs::remove_all(dir, error);
+    if (!ok) throw std::runtime_error("no se pudieron escribir las particiones en " + dir.string());
+    return aggregate::merge(partials, numThreads);
+}
+
+}  // namespace join
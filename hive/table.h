@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/work_pool.h"
+
+// Tablas de texto con la semántica de Hive (LazySimpleSerDe) para los
+// trabajos de hive/:
+//   - una fila por línea ('\n', también "\r\n"); la cabecera de los .log es
+//     una fila más, igual que en Hive sin skip.header.line.count
+//   - sin ROW FORMAT el delimitador de campos es '\001' (Ctrl-A)
+//   - los campos que faltan y el texto \N son NULL; los que sobran se ignoran
+//   - un número que no se puede leer es NULL
+namespace table {
+
+enum class Type { String, Int, Double };
+
+struct Column {
+    std::string name;
+    Type type = Type::String;
+};
+
+struct Schema {
+    std::vector<Column> columns;
+    char delimiter = '\001';
+    // La última columna se queda con el resto de la línea, delimitadores
+    // incluidos (la consulta de excite-small.log tiene espacios)
+    bool restInLast = false;
+
+    // Índice de la columna (Hive no distingue mayúsculas) o -1
+    int find(std::string_view name) const {
+        for (size_t c = 0; c < columns.size(); ++c) {
+            const std::string& n = columns[c].name;
+            if (n.size() == name.size() &&
+                std::equal(n.begin(), n.end(), name.begin(), [](char a, char b) {
+                    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+                })) {
+                return int(c);
+            }
+        }
+        return -1;
+    }
+};
+
+// Tipo de Hive -> tipo interno. DECIMAL se guarda como double.
+inline std::optional<Type> parseType(std::string_view hiveType) {
+    std::string t(hiveType.substr(0, hiveType.find('(')));
+    for (char& c : t) c = char(std::toupper(static_cast<unsigned char>(c)));
+    if (t == "STRING" || t == "VARCHAR" || t == "CHAR") return Type::String;
+    if (t == "INT" || t == "BIGINT" || t == "SMALLINT" || t == "TINYINT") return Type::Int;
+    if (t == "DOUBLE" || t == "FLOAT" || t == "DECIMAL") return Type::Double;
+    return std::nullopt;
+}
+
+constexpr std::string_view kNullText = "\\N";
+
+// Campos de una línea; las columnas que la línea no trae son NULL
+struct Row {
+    std::vector<std::string_view> fields;
+    size_t present = 0;
+
+    bool isNull(size_t c) const { return c >= present || fields[c] == kNullText; }
+    std::string_view operator[](size_t c) const { return fields[c]; }
+};
+
+// Con limit solo se separan las primeras limit columnas (proyección): las
+// demás quedan como NULL
+inline void splitRow(std::string_view line, const Schema& schema, Row& row, size_t limit = SIZE_MAX) {
+    size_t n = schema.columns.size();
+    row.fields.resize(n);
+    row.present = 0;
+    size_t begin = 0;
+    size_t last = std::min(n, limit);
+    while (row.present < last) {
+        if (schema.restInLast && row.present + 1 == n) {
+            row.fields[row.present++] = line.substr(begin);
+            break;
+        }
+        size_t end = line.find(schema.delimiter, begin);
+        if (end == std::string_view::npos) end = line.size();
+        row.fields[row.present++] = line.substr(begin, end - begin);
+        if (end == line.size()) break;
+        begin = end + 1;
+    }
+}
+
+// Filtro empujado al escaneo: las filas que no pasan no llegan a agregarse.
+// columns es cuántas columnas (desde la primera) lee keep.
+struct RowFilter {
+    std::function<bool(const Row&)> keep;
+    size_t columns = 0;
+
+    bool operator()(const Row& row) const { return !keep || keep(row); }
+};
+
+// fn(línea) por cada línea de text, sin el salto de línea
+template <class Fn>
+void forEachLine(std::string_view text, Fn&& fn) {
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string_view::npos) end = text.size();
+        std::string_view line = text.substr(begin, end - begin);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        fn(line);
+        begin = end + 1;
+    }
+}
+
+inline std::optional<int64_t> toInt(std::string_view s) {
+    if (!s.empty() && s[0] == '+') s.remove_prefix(1);
+    int64_t v;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc() || end != s.data() + s.size() || s.empty()) return std::nullopt;
+    return v;
+}
+
+inline std::optional<double> toDouble(std::string_view s) {
+    if (!s.empty() && s[0] == '+') s.remove_prefix(1);
+    double v;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec != std::errc() || end != s.data() + s.size() || s.empty()) return std::nullopt;
+    return v;
+}
+
+// Double como lo imprime Hive (Double.toString de Java): el decimal más corto
+// que vuelve al mismo valor, notación científica fuera de [1e-3, 1e7) y
+// siempre con parte decimal ("2.0", "1.0E7")
+inline std::string formatDouble(double d) {
+    if (std::isnan(d)) return "NaN";
+    if (std::isinf(d)) return d > 0 ? "Infinity" : "-Infinity";
+    if (d == 0) return std::signbit(d) ? "-0.0" : "0.0";
+    char buf[64];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), std::fabs(d), std::chars_format::scientific);
+    std::string_view s(buf, size_t(end - buf));
+    size_t e = s.find('e');
+    std::string digits(1, s[0]);
+    if (e > 1) digits += s.substr(2, e - 2);
+    int exponent = std::atoi(std::string(s.substr(e + 1)).c_str());
+
+    std::string out = d < 0 ? "-" : "";
+    if (exponent >= -3 && exponent < 7) {
+        if (exponent < 0) {
+            out.append("0.").append(size_t(-exponent - 1), '0').append(digits);
+        } else {
+            size_t point = size_t(exponent) + 1;
+            if (digits.size() < point + 1) digits.resize(point + 1, '0');
+            out.append(digits, 0, point).append(".").append(digits, point);
+        }
+    } else {
+        out.append(digits, 0, 1).append(".").append(digits.size() > 1 ? std::string_view(digits).substr(1) : "0");
+        out.append("E").append(std::to_string(exponent));
+    }
+    return out;
+}
+
+// Valor de una fila de resultado
+struct Value {
+    enum class Kind { Null, Int, Double, String } kind = Kind::Null;
+    int64_t i = 0;
+    double d = 0;
+    std::string s;
+
+    static Value null() { return {}; }
+    static Value ofInt(int64_t v) { return {Kind::Int, v, 0, {}}; }
+    static Value ofDouble(double v) { return {Kind::Double, 0, v, {}}; }
+    static Value ofString(std::string_view v) { return {Kind::String, 0, 0, std::string(v)}; }
+
+    bool isNull() const { return kind == Kind::Null; }
+    double number() const { return kind == Kind::Int ? double(i) : d; }
+};
+
+// Campo de texto -> valor del tipo de la columna
+inline Value parseValue(std::string_view text, Type type) {
+    if (text == kNullText) return Value::null();
+    switch (type) {
+    case Type::String: return Value::ofString(text);
+    case Type::Int: {
+        auto v = toInt(text);
+        return v ? Value::ofInt(*v) : Value::null();
+    }
+    case Type::Double: {
+        auto v = toDouble(text);
+        return v ? Value::ofDouble(*v) : Value::null();
+    }
+    }
+    return Value::null();
+}
+
+// Como lo muestra la consola de Hive
+inline std::string format(const Value& v) {
+    switch (v.kind) {
+    case Value::Kind::Null: return "NULL";
+    case Value::Kind::Int: return std::to_string(v.i);
+    case Value::Kind::Double: return formatDouble(v.d);
+    case Value::Kind::String: return v.s;
+    }
+    return "";
+}
+
+// Orden de ORDER BY ... ASC: NULL primero, números por valor y cadenas byte
+// a byte
+inline int compare(const Value& a, const Value& b) {
+    if (a.isNull() || b.isNull()) return int(!a.isNull()) - int(!b.isNull());
+    if (a.kind == Value::Kind::String && b.kind == Value::Kind::String) {
+        return a.s < b.s ? -1 : a.s > b.s ? 1 : 0;
+    }
+    if (a.kind == Value::Kind::Int && b.kind == Value::Kind::Int) return a.i < b.i ? -1 : a.i > b.i ? 1 : 0;
+    double x = a.number(), y = b.number();
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+using ResultRow = std::vector<Value>;
+
+struct SortKey {
+    size_t column;
+    bool descending = false;
+};
+
+// ORDER BY; stable, así que las filas iguales conservan su orden
+inline void orderBy(std::vector<ResultRow>& rows, const std::vector<SortKey>& keys) {
+    std::stable_sort(rows.begin(), rows.end(), [&](const ResultRow& a, const ResultRow& b) {
+        for (const SortKey& k : keys) {
+            int c = compare(a[k.column], b[k.column]);
+            if (c != 0) return k.descending ? c > 0 : c < 0;
+        }
+        return false;
+    });
+}
+
+// Recorre files en trozos de líneas completas sobre el pool con robo de
+// trabajo: fn(texto, hilo) por cada trozo
+template <class Fn>
+void scanChunks(const std::vector<std::string>& files, size_t numThreads, Fn&& fn,
+                uint64_t chunkBytes = kDefaultChunkBytes) {
+    std::vector<FileChunk> chunks = plan_chunks(files, chunkBytes, true);
+    run_work_stealing(chunks.size(), numThreads, [&](size_t task, size_t worker) {
+        thread_local std::string buffer;
+        {
+            instr::Scope scope(instr::Stage::Read);
+            if (!read_chunk(files[chunks[task].file], chunks[task], buffer)) return;
+        }
+        instr::add_bytes(buffer.size());
+        fn(std::string_view(buffer), worker);
+    });
+}
+
+}  // namespace table
@@ -0,0 +1,102 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/tokenizer.h"
+#include "roaring.h"
+
+// Consultas booleanas sobre bitmaps de documentos.
+//
+//   casa AND roja          (también "casa roja": AND implícito)
+//   perro OR gato
+//   casa NOT roja          NOT tiene la mayor precedencia, luego AND, luego OR
+//   (perro OR gato) AND NOT casa
+//
+// NOT x se evalúa como "todos los documentos" menos x.
+namespace boolean {
+
+class Evaluator {
+public:
+    // lookup(término) devuelve el bitmap del término o nullptr si no existe
+    template <class Lookup>
+    static roaring::Bitmap run(std::string_view text, Lookup&& lookup, uint32_t numDocs) {
+        Evaluator e(text, numDocs);
+        return e.parseOr(lookup);
+    }
+
+private:
+    Evaluator(std::string_view text, uint32_t numDocs) : numDocs_(numDocs) {
+        size_t i = 0;
+        while (i < text.size()) {
+            if (tok::is_space(text[i])) {
+                ++i;
+            } else if (text[i] == '(' || text[i] == ')') {
+                tokens_.emplace_back(text.substr(i, 1));
+                ++i;
+            } else {
+                size_t end = i;
+                while (end < text.size() && !tok::is_space(text[end]) && text[end] != '(' && text[end] != ')') ++end;
+                tokens_.emplace_back(text.substr(i, end - i));
+                i = end;
+            }
+        }
+    }
+
+    bool atEnd() const { return pos_ >= tokens_.size(); }
+    bool peek(std::string_view token) const { return !atEnd() && tokens_[pos_] == token; }
+
+    template <class Lookup>
+    roaring::Bitmap parseOr(Lookup& lookup) {
+        roaring::Bitmap result = parseAnd(lookup);
+        while (peek("OR")) {
+            ++pos_;
+            result |= parseAnd(lookup);
+        }
+        return result;
+    }
+
+    template <class Lookup>
+    roaring::Bitmap parseAnd(Lookup& lookup) {
+        roaring::Bitmap result = parseNot(lookup);
+        while (!atEnd() && !peek("OR") && !peek(")")) {
+            if (peek("AND")) ++pos_;
+            // a NOT b se calcula como a - b, sin construir el complemento
+            if (peek("NOT")) {
+                ++pos_;
+                result = result - parseNot(lookup);
+            } else {
+                result = result & parseNot(lookup);
+            }
+        }
+        return result;
+    }
+
+    template <class Lookup>
+    roaring::Bitmap parseNot(Lookup& lookup) {
+        if (atEnd()) return {};
+        if (peek("NOT")) {
+            ++pos_;
+            return roaring::Bitmap::range(numDocs_) - parseNot(lookup);
+        }
+        if (peek("(")) {
+            ++pos_;
+            roaring::Bitmap result = parseOr(lookup);
+            if (peek(")")) ++pos_;
+            return result;
+        }
+        std::string term = tok::normalize(tokens_[pos_++]);
+        const roaring::Bitmap* bitmap = lookup(term);
+        return bitmap ? *bitmap : roaring::Bitmap();
+    }
+
+    std::vector<std::string_view> tokens_;
+    size_t pos_ = 0;
+    uint32_t numDocs_;
+};
+
+template <class Lookup>
+roaring::Bitmap evaluate(std::string_view text, Lookup&& lookup, uint32_t numDocs) {
+    return Evaluator::run(text, lookup, numDocs);
+}
+
+}  // namespace boolean
@@ -0,0 +1,94 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../common/work_pool.h"
+#include "roaring.h"
+
+// Índice booleano término -> documentos con enteros en vez de cadenas.
+// Cada hilo asigna termIds locales y guarda un bitmap comprimido de docIds
+// por término; la unión remapea los termIds locales a los globales y hace el
+// OR de los bitmaps en paralelo, así que ni las rutas ni las palabras se
+// copian por cada aparición.
+namespace dictionary {
+
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+using TermIds = std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>>;
+
+// Índice de un hilo: termId local -> docIds
+struct LocalIndex {
+    TermIds termIds;
+    std::vector<roaring::Bitmap> postings;
+
+    void add(std::string_view term, uint32_t docId) {
+        auto it = termIds.find(term);
+        if (it == termIds.end()) {
+            it = termIds.emplace(std::string(term), uint32_t(postings.size())).first;
+            postings.emplace_back();
+        }
+        postings[it->second].add(docId);
+    }
+};
+
+// Índice global: termId -> docIds
+struct GlobalIndex {
+    TermIds termIds;
+    std::vector<std::string_view> terms;  // vistas sobre las claves de termIds
+    std::vector<roaring::Bitmap> postings;
+
+    // nullptr si el término no está
+    const roaring::Bitmap* find(std::string_view term) const {
+        auto it = termIds.find(term);
+        return it == termIds.end() ? nullptr : &postings[it->second];
+    }
+
+    size_t sizeInBytes() const {
+        size_t total = 0;
+        for (const auto& bitmap : postings) total += bitmap.sizeInBytes();
+        return total;
+    }
+};
+
+// Une los índices locales en global (los locales quedan vacíos). Las claves
+// nuevas se mueven al diccionario global sin copiar la cadena; después cada
+// término hace el OR de sus bitmaps locales, repartiendo términos entre hilos.
+inline void merge(std::vector<LocalIndex>& locals, GlobalIndex& global, size_t numThreads) {
+    std::vector<std::vector<roaring::Bitmap*>> sources(global.postings.size());
+    for (auto& local : locals) {
+        while (!local.termIds.empty()) {
+            auto node = local.termIds.extract(local.termIds.begin());
+            roaring::Bitmap* source = &local.postings[node.mapped()];
+            auto it = global.termIds.find(node.key());
+            if (it == global.termIds.end()) {
+                node.mapped() = uint32_t(global.postings.size());
+                it = global.termIds.insert(std::move(node)).position;
+                global.terms.push_back(it->first);
+                global.postings.emplace_back();
+                sources.emplace_back();
+            }
+            sources[it->second].push_back(source);
+        }
+    }
+
+    run_work_stealing(global.postings.size(), numThreads, [&](size_t t, size_t) {
+        roaring::Bitmap& target = global.postings[t];
+        for (roaring::Bitmap* source : sources[t]) {
+            if (target.empty()) target = std::move(*source);
+            else target |= *source;
+        }
+        target.optimize();
+    });
+
+    for (auto& local : locals) local = LocalIndex();
+}
+
+}  // namespace dictionary
@@ -0,0 +1,356 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "../common/instrument.h"
+#include "../common/mapped_file.h"
+#include "../common/tokenizer.h"
+#include "query.h"
+#include "search.h"
+#include "segment.h"
+#include "spimi.h"
+
+// Indexación incremental: el índice es un conjunto de segmentos más un
+// manifiesto de texto con el tamaño, la fecha de modificación y el hash de
+// cada archivo indexado. Solo los archivos nuevos o cambiados se indexan en
+// un segmento nuevo; los borrados o reemplazados quedan como tombstones
+// (docIds marcados en su segmento) hasta que una mezcla los purga.
+//
+// Manifiesto:
+//   generacion N
+//   segmento <ruta> <num_docs>
+//   borrado <segmento> <docId>
+//   archivo <segmento> <docId> <tamaño> <mtime_ns> <hash> <ruta del archivo>
+namespace incremental {
+
+constexpr const char* kManifestPath = "index_manifest.txt";
+// Segmentos de un mismo nivel que disparan una mezcla
+constexpr size_t kMergeFactor = 4;
+// Tamaño máximo de un segmento del nivel 0; cada nivel es kMergeFactor veces mayor
+constexpr uint64_t kTierBase = uint64_t(1) << 20;
+
+struct FileEntry {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    uint64_t hash = 0;
+    std::string segment;
+    uint32_t docId = 0;
+};
+
+struct SegmentEntry {
+    std::string path;
+    uint32_t numDocs = 0;
+    std::set<uint32_t> deleted;  // tombstones
+};
+
+struct Manifest {
+    uint64_t generation = 0;
+    std::vector<SegmentEntry> segments;
+    std::vector<FileEntry> files;  // solo archivos vivos
+
+    SegmentEntry* segment(const std::string& path) {
+        for (auto& s : segments) {
+            if (s.path == path) return &s;
+        }
+        return nullptr;
+    }
+
+    std::string nextSegmentPath() { return "inverted_index." + std::to_string(++generation) + ".seg"; }
+
+    // Marca el documento de un archivo como borrado y lo quita de la lista
+    void remove(size_t fileIndex) {
+        const FileEntry& entry = files[fileIndex];
+        if (SegmentEntry* s = segment(entry.segment)) s->deleted.insert(entry.docId);
+        files.erase(files.begin() + fileIndex);
+    }
+
+    // false si no existe: se empieza con un manifiesto vacío
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in.is_open()) return false;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string kind;
+            fields >> kind;
+            if (kind == "generacion") {
+                fields >> generation;
+            } else if (kind == "segmento") {
+                SegmentEntry s;
+                fields >> s.path >> s.numDocs;
+                segments.push_back(s);
+            } else if (kind == "borrado") {
+                std::string seg;
+                uint32_t docId;
+                fields >> seg >> docId;
+                if (SegmentEntry* s = segment(seg)) s->deleted.insert(docId);
+            } else if (kind == "archivo") {
+                FileEntry f;
+                fields >> f.segment >> f.docId >> f.size >> f.mtime >> f.hash;
+                fields.get();
+                std::getline(fields, f.path);
+                files.push_back(f);
+            }
+        }
+        return true;
+    }
+
+    // Escribe en un temporal y lo renombra: un corte nunca deja el manifiesto a medias
+    bool save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp);
+            if (!out.is_open()) return false;
+            out << "generacion " << generation << '\n';
+            for (const auto& s : segments) {
+                out << "segmento " << s.path << ' ' << s.numDocs << '\n';
+                for (uint32_t docId : s.deleted) out << "borrado " << s.path << ' ' << docId << '\n';
+            }
+            for (const auto& f : files) {
+                out << "archivo " << f.segment << ' ' << f.docId << ' ' << f.size << ' ' << f.mtime << ' '
+                    << f.hash << ' ' << f.path << '\n';
+            }
+            if (!out) return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+};
+
+inline uint64_t fileHash(const std::string& path) {
+    MappedFile file;
+    if (!file.open(path)) return 0;
+    return tok::hash_word(file.view());
+}
+
+inline int64_t modificationTime(const struct stat& st) {
+    return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// Mezcla segmentos en uno nuevo sin los documentos borrados. Los docIds
+// nuevos siguen el orden de las entradas; remap[i][docId viejo] es el nuevo
+// docId o -1. Devuelve false si no se pudo escribir.
+inline bool mergeSegments(const std::vector<const segment::SegmentReader*>& inputs,
+                          const std::vector<const std::set<uint32_t>*>& deleted, const std::string& path,
+                          std::vector<std::vector<int64_t>>& remap) {
+    instr::Scope merge(instr::Stage::Merge);
+    std::vector<uint32_t> docLengths;
+    bool withPositions = true;
+    remap.assign(inputs.size(), {});
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        withPositions = withPositions && inputs[i]->hasPositions();
+        remap[i].assign(inputs[i]->numDocs(), -1);
+        for (uint32_t docId = 0; docId < inputs[i]->numDocs(); ++docId) {
+            if (deleted[i]->count(docId)) continue;
+            remap[i][docId] = docLengths.size();
+            docLengths.push_back(inputs[i]->docLength(docId));
+        }
+    }
+
+    segment::SegmentWriter writer;
+    if (!writer.open(path, docLengths, withPositions)) return false;
+
+    std::vector<segment::SegmentReader::TermIterator> terms;
+    for (const auto* input : inputs) terms.emplace_back(*input);
+    auto greater = [&](size_t a, size_t b) {
+        return terms[a].term() != terms[b].term() ? terms[a].term() > terms[b].term() : a > b;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (terms[i].next()) heap.push(i);
+    }
+
+    // Las entradas salen del heap en orden, así que los docIds ya quedan ordenados
+    std::string term;
+    std::vector<spimi::Posting> merged;
+    std::vector<uint32_t> docIds, freqs;
+    while (!heap.empty()) {
+        term = std::string(terms[heap.top()].term());
+        merged.clear();
+        while (!heap.empty() && terms[heap.top()].term() == term) {
+            size_t i = heap.top();
+            heap.pop();
+            segment::PostingList list = terms[i].list();
+            segment::decodeDocIds(list, docIds);
+            segment::decodeFrequencies(list, freqs);
+            segment::PositionCursor cursor(list);
+            for (size_t k = 0; k < docIds.size(); ++k) {
+                int64_t newId = remap[i][docIds[k]];
+                if (newId < 0) continue;
+                spimi::Posting posting{uint32_t(newId), freqs[k], {}};
+                if (withPositions) cursor.positionsAt(k, posting.positions);
+                merged.push_back(std::move(posting));
+            }
+            if (terms[i].next()) heap.push(i);
+        }
+        if (!merged.empty()) writer.add(term, merged);
+    }
+    return writer.finish();
+}
+
+// Nivel de un segmento según su tamaño en bytes
+inline size_t tierOf(uint64_t bytes) {
+    if (bytes < kTierBase) return 0;
+    return 1 + size_t(std::log(double(bytes) / kTierBase) / std::log(double(kMergeFactor)));
+}
+
+// Índice vivo: los segmentos del manifiesto abiertos para consultar, y un
+// hilo en segundo plano que los compacta con una política por niveles. Las
+// consultas se reparten entre todos los segmentos vivos.
+class LiveIndex {
+public:
+    LiveIndex(Manifest manifest, std::string manifestPath)
+        : manifest_(std::move(manifest)), manifestPath_(std::move(manifestPath)) {
+        for (const auto& s : manifest_.segments) {
+            auto reader = std::make_shared<segment::SegmentReader>();
+            if (reader->open(s.path)) readers_[s.path] = reader;
+        }
+        rebuildPaths();
+    }
+
+    ~LiveIndex() { waitMerges(); }
+
+    void startMerges() { merger_ = std::thread([this] { mergeLoop(); }); }
+
+    void waitMerges() {
+        if (merger_.joinable()) merger_.join();
+    }
+
+    size_t numSegments() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return manifest_.segments.size();
+    }
+
+    // Rutas de los documentos vivos que cumplen la consulta, en todos los segmentos
+    std::vector<std::string> search(const std::string& text) const {
+        query::Query q = query::parse(text);
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::string> results;
+        for (const auto& s : manifest_.segments) {
+            auto it = readers_.find(s.path);
+            if (it == readers_.end()) continue;
+            if (q.needsPositions() && !it->second->hasPositions()) continue;
+            const std::vector<std::string>& paths = paths_.at(s.path);
+            for (uint32_t docId : search::evaluate(*it->second, q)) {
+                if (!s.deleted.count(docId) && docId < paths.size()) results.push_back(paths[docId]);
+            }
+        }
+        return results;
+    }
+
+private:
+    // docId -> ruta, por segmento
+    void rebuildPaths() {
+        paths_.clear();
+        for (const auto& s : manifest_.segments) paths_[s.path].resize(s.numDocs);
+        for (const auto& f : manifest_.files) {
+            auto it = paths_.find(f.segment);
+            if (it != paths_.end() && f.docId < it->second.size()) it->second[f.docId] = f.path;
+        }
+    }
+
+    // Elige qué mezclar: kMergeFactor segmentos del nivel más bajo que los
+    // tenga, o un segmento con más de la mitad de sus documentos borrados
+    std::vector<std::string> pickMerge() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<size_t, std::vector<std::string>> tiers;
+        for (const auto& s : manifest_.segments) {
+            auto it = readers_.find(s.path);
+            if (it == readers_.end()) continue;
+            if (s.deleted.size() * 2 > s.numDocs) return {s.path};
+            tiers[tierOf(it->second->fileSize())].push_back(s.path);
+        }
+        for (auto& [tier, paths] : tiers) {
+            if (paths.size() >= kMergeFactor) {
+                paths.resize(kMergeFactor);
+                return paths;
+            }
+        }
+        return {};
+    }
+
+    void mergeLoop() {
+        while (true) {
+            std::vector<std::string> chosen = pickMerge();
+            if (chosen.empty()) return;
+
+            // Nadie más cambia el manifiesto mientras se mezcla: basta una copia
+            // de las entradas; el archivo nuevo se escribe sin el candado
+            std::vector<const segment::SegmentReader*> inputs;
+            std::vector<std::shared_ptr<segment::SegmentReader>> keepAlive;
+            std::vector<SegmentEntry> entries;
+            std::string output;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& path : chosen) {
+                    keepAlive.push_back(readers_.at(path));
+                    inputs.push_back(keepAlive.back().get());
+                    entries.push_back(*manifest_.segment(path));
+                }
+                output = manifest_.nextSegmentPath();
+            }
+            std::vector<const std::set<uint32_t>*> deleted;
+            uint64_t liveDocs = 0;
+            for (const auto& e : entries) {
+                deleted.push_back(&e.deleted);
+                liveDocs += e.numDocs - e.deleted.size();
+            }
+
+            std::vector<std::vector<int64_t>> remap;
+            auto reader = std::make_shared<segment::SegmentReader>();
+            if (liveDocs > 0 && (!mergeSegments(inputs, deleted, output, remap) || !reader->open(output))) {
+                return;  // se reintenta en la próxima ejecución
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto& segs = manifest_.segments;
+                size_t insertAt = segs.size();
+                for (size_t i = 0; i < segs.size();) {
+                    if (std::find(chosen.begin(), chosen.end(), segs[i].path) != chosen.end()) {
+                        insertAt = std::min(insertAt, i);
+                        segs.erase(segs.begin() + i);
+                    } else {
+                        ++i;
+                    }
+                }
+                if (liveDocs > 0) {
+                    segs.insert(segs.begin() + insertAt, SegmentEntry{output, uint32_t(liveDocs), {}});
+                    readers_[output] = reader;
+                }
+                for (auto& f : manifest_.files) {
+                    auto it = std::find(chosen.begin(), chosen.end(), f.segment);
+                    if (it == chosen.end()) continue;
+                    f.segment = output;
+                    f.docId = uint32_t(remap[it - chosen.begin()][f.docId]);
+                }
+                for (const auto& path : chosen) readers_.erase(path);
+                rebuildPaths();
+                manifest_.save(manifestPath_);
+            }
+            // Borrar un archivo todavía mapeado es seguro en POSIX
+            for (const auto& path : chosen) std::remove(path.c_str());
+        }
+    }
+
+    mutable std::mutex mutex_;
+    Manifest manifest_;
+    std::string manifestPath_;
+    std::map<std::string, std::shared_ptr<segment::SegmentReader>> readers_;
+    std::map<std::string, std::vector<std::string>> paths_;
+    std::thread merger_;
+};
+
+}  // namespace incremental
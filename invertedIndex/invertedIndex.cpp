@@ -1,87 +1,42 @@
 #include <bits/stdc++.h>
 #include <dirent.h>
-#include <pthread.h>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/read_pipeline.h"
+#include "../common/tokenizer.h"
+#include "boolean.h"
+#include "dictionary.h"
 using namespace std;
 using namespace chrono;
 
-const size_t BUFFER_SIZE = 1 << 16; // 20 = 1MB
-
-mutex global_mutex;
-unordered_map<string, unordered_set<string>> global_index;
-
-struct ThreadData {
-    vector<string> files;
-};
-
-void to_lowercase(string& word) {
-    transform(word.begin(), word.end(), word.begin(), ::tolower);
+using dictionary::LocalIndex;
+
+// término -> docIds, con docId = posición del archivo en la lista de archivos
+dictionary::GlobalIndex global_index;
+
+// Etapa de tokenización: un búfer ya leído (un rango del archivo que empieza
+// y termina en espacios) se tokeniza entero, sin copiar las palabras
+void process_buffer(const ReadBuffer& buffer, uint32_t doc_id, LocalIndex& local_index) {
+    instr::Scope tokenize_scope(instr::Stage::Tokenize);
+    uint64_t tokens = 0;
+    tok::thread_tokenizer().for_each_word(buffer.view(), [&](string_view word) {
+        local_index.add(word, doc_id);
+        tokens++;
+    });
+    instr::add_tokens(tokens);
 }
 
-vector<string> tokenize(const string& text, string& carry) {
-    vector<string> tokens;
-    size_t start = 0, end = 0;
-    string chunk = carry + text;
-    carry.clear();
-
-    while (end < chunk.size()) {
-        while (end < chunk.size() && !isspace(chunk[end])) ++end;
-        string word = chunk.substr(start, end - start);
-        to_lowercase(word);
-        word.erase(remove_if(word.begin(), word.end(), ::ispunct), word.end());
-        if (!word.empty()) tokens.push_back(word);
-
-        // saltar espacios en blanco
-        while (end < chunk.size() && isspace(chunk[end])) ++end;
-        start = end;
+// Consultas AND/OR/NOT desde stdin, evaluadas como operaciones de bitmaps
+void answer_queries(const dictionary::GlobalIndex& index, const vector<string>& files) {
+    string query;
+    while (getline(cin, query) && query != "salir") {
+        roaring::Bitmap result = boolean::evaluate(
+            query, [&](string_view term) { return index.find(term); }, uint32_t(files.size()));
+        cout << "Resultados para: " << query << "\n";
+        cout << "Documentos encontrados: " << result.cardinality() << "\n";
+        result.forEach([&](uint32_t doc_id) { cout << "- " << files[doc_id] << "\n"; });
+        cout << endl;
     }
-
-    // Si la ultima palabra esta incompleta, guardar
-    if (!chunk.empty() && !isspace(chunk.back())) {
-        carry = tokens.empty() ? chunk.substr(start) : tokens.back();
-        if (!tokens.empty()) tokens.pop_back(); // quitar ultima incompleta
-    }
-
-    return tokens;
-}
-
-void* process_files(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    unordered_map<string, unordered_set<string>> local_index;
-    char buffer[BUFFER_SIZE];
-
-    for (const string& file : data->files) {
-        ifstream infile(file, ios::binary);
-        if (!infile.is_open()) {
-            cerr << "No se pudo abrir " << file << endl;
-            continue;
-        }
-
-        string carry; // para manejar palabras cortadas
-        while (infile.read(buffer, BUFFER_SIZE) || infile.gcount() > 0) {
-            size_t bytes_read = infile.gcount();
-            string chunk(buffer, bytes_read);
-            vector<string> words = tokenize(chunk, carry);
-
-            for (const string& word : words) {
-                local_index[word].insert(file);
-            }
-        }
-
-        if (!carry.empty()) {
-            to_lowercase(carry);
-            carry.erase(remove_if(carry.begin(), carry.end(), ::ispunct), carry.end());
-            local_index[carry].insert(file);
-        }
-
-        infile.close();
-    }
-
-    lock_guard<mutex> lock(global_mutex);
-    for (const auto& [word, files] : local_index) {
-        global_index[word].insert(files.begin(), files.end());
-    }
-
-    return nullptr;
 }
 
 vector<string> list_text_files(const string& dir_path) {
@@ -105,12 +60,21 @@ vector<string> list_text_files(const string& dir_path) {
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        cerr << "Uso: " << argv[0] << " <directorio_de_textos> <num_hilos>" << endl;
+        cerr << "Uso: " << argv[0] << " <directorio_de_textos> <num_hilos> [--consultas] [--buffer MB] [--cola N]" << endl;
         return 1;
     }
 
     string dir_path = argv[1];
-    int num_threads = stoi(argv[2]);
+    int num_threads = max(1, stoi(argv[2]));
+    bool interactive = false;
+    uint64_t buffer_bytes = kDefaultChunkBytes;  // tamaño de cada lectura
+    size_t queue_depth = 8;                      // lecturas en vuelo
+    for (int i = 3; i < argc; ++i) {
+        string flag = argv[i];
+        if (flag == "--consultas") interactive = true;
+        else if (flag == "--buffer" && i + 1 < argc) buffer_bytes = stoull(argv[++i]) << 20;
+        else if (flag == "--cola" && i + 1 < argc) queue_depth = stoul(argv[++i]);
+    }
 
     vector<string> files = list_text_files(dir_path);
     if (files.empty()) {
@@ -118,38 +82,57 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    vector<pthread_t> threads(num_threads);
-    vector<ThreadData> thread_data(num_threads);
-
-    for (size_t i = 0; i < files.size(); ++i) {
-        thread_data[i % num_threads].files.push_back(files[i]);
-    }
-
     auto start_time = high_resolution_clock::now();
 
-    for (int i = 0; i < num_threads; ++i) {
-        pthread_create(&threads[i], nullptr, process_files, &thread_data[i]);
+    // Un hilo lector llena búferes con rangos de buffer_bytes (cortados en
+    // espacios) mientras num_threads hilos los tokenizan: disco y CPU se solapan
+    ReadPipeline pipeline(files, plan_chunks(files, buffer_bytes), queue_depth, num_threads);
+    vector<LocalIndex> local_indexes(num_threads);
+    vector<thread> workers;
+    for (int w = 0; w < num_threads; ++w) {
+        workers.emplace_back([&, w] {
+            ReadBuffer* buffer;
+            while (pipeline.next(buffer)) {
+                size_t file = pipeline.chunks()[buffer->chunk].file;
+                if (!buffer->ok) cerr << "No se pudo leer " << files[file] << endl;
+                process_buffer(*buffer, uint32_t(file), local_indexes[w]);
+                pipeline.release(buffer);
+            }
+            instr::add_unique_keys(local_indexes[w].termIds.size());
+        });
     }
+    for (auto& worker : workers) worker.join();
 
-    for (int i = 0; i < num_threads; ++i) {
-        pthread_join(threads[i], nullptr);
+    auto merge_start = high_resolution_clock::now();
+    {
+        instr::Scope merge(instr::Stage::Merge);
+        dictionary::merge(local_indexes, global_index, local_indexes.size());
     }
+    duration<double> merge_elapsed = high_resolution_clock::now() - merge_start;
 
     auto end_time = high_resolution_clock::now();
     duration<double> elapsed = end_time - start_time;
-    cout << "Índice invertido creado en " << elapsed.count() << " segundos\n";
-
-    ofstream out("indice_invertido.txt");
-    for (const auto& [word, file_set] : global_index) {
-        out << word << ": ";
-        for (const auto& file : file_set) {
-            out << file << " ";
+    cout << "Índice invertido creado en " << elapsed.count() << " segundos (lectura con "
+         << pipeline.backend() << ")\n";
+    cout << "Unión de índices locales: " << merge_elapsed.count() << " segundos\n";
+    cout << "Memoria de los bitmaps: " << global_index.sizeInBytes() / 1024 << " KB\n";
+
+    {
+        instr::Scope serialize(instr::Stage::Serialize);
+        ofstream out("indice_invertido.txt");
+        for (size_t term_id = 0; term_id < global_index.terms.size(); ++term_id) {
+            out << global_index.terms[term_id] << ": ";
+            global_index.postings[term_id].forEach([&](uint32_t doc_id) {
+                out << files[doc_id] << " ";
+            });
+            out << "\n";
         }
-        out << "\n";
+        out.close();
     }
-    out.close();
 
     cout << "Índice invertido guardado como 'indice_invertido.txt'.\n";
+
+    if (interactive) answer_queries(global_index, files);
     return 0;
 }
 
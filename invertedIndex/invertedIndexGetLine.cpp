@@ -1,67 +1,59 @@
 #include <bits/stdc++.h>
 #include <dirent.h>
-#include <pthread.h>
 #include <sys/stat.h>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/read_pipeline.h"
+#include "../common/tokenizer.h"
+#include "boolean.h"
+#include "dictionary.h"
 using namespace std;
 using namespace chrono;
 
-mutex global_mutex;
-unordered_map<string, unordered_set<string>> global_index;
+using dictionary::LocalIndex;
 
-struct ThreadData {
-    vector<string> files;
-};
-
-void to_lowercase(string& word) {
-    for (char& c : word) c = tolower(c);
-}
+// término -> docIds, con docId = posición del archivo en la lista de archivos
+dictionary::GlobalIndex global_index;
 
 vector<string> tokenize(const string& line) {
-    vector<string> tokens;
-    string word;
-    for (char c : line) {
-        if (isalnum(c)) {
-            word += tolower(c);
-        } else if (!word.empty()) {
-            tokens.push_back(word);
-            word.clear();
-        }
-    }
-    if (!word.empty()) tokens.push_back(word);
-    return tokens;
+    return tok::thread_tokenizer().tokenize(line);
 }
 
-void* process_files(void* arg) {
-    ThreadData* data = (ThreadData*)arg;
-    unordered_map<string, unordered_set<string>> local_index;
-    local_index.reserve(100000);  // Ajusta si tienes una idea del número de palabras
-
-    for (const string& file : data->files) {
-        ifstream infile(file);
-        if (!infile.is_open()) {
-            cerr << "No se pudo abrir: " << file << endl;
-            continue;
-        }
-
-        string line;
-        while (getline(infile, line)) {
-            vector<string> words = tokenize(line);
-            for (const string& word : words) {
-                if (!word.empty()) {
-                    local_index[word].insert(file);
-                }
+// Procesa las líneas de un búfer ya leído (los rangos empiezan y terminan
+// en saltos de línea)
+void process_buffer(const ReadBuffer& buffer, uint32_t doc_id, LocalIndex& local_index) {
+    instr::Scope tokenize_scope(instr::Stage::Tokenize);
+    string_view data = buffer.view();
+    uint64_t tokens = 0;
+    string line;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find('\n', pos);
+        if (end == string_view::npos) end = data.size();
+        line.assign(data.substr(pos, end - pos));
+        pos = end + 1;
+        vector<string> words = tokenize(line);
+        for (const string& word : words) {
+            if (!word.empty()) {
+                local_index.add(word, doc_id);
+                tokens++;
             }
         }
-        infile.close();
     }
+    instr::add_tokens(tokens);
+}
 
-    // Unir resultados al índice global (una sola vez al final del hilo)
-    lock_guard<mutex> lock(global_mutex);
-    for (const auto& [word, files] : local_index) {
-        global_index[word].insert(files.begin(), files.end());
+// Consultas AND/OR/NOT desde stdin, evaluadas como operaciones de bitmaps
+void answer_queries(const dictionary::GlobalIndex& index, const vector<string>& files) {
+    string query;
+    while (getline(cin, query) && query != "salir") {
+        roaring::Bitmap result = boolean::evaluate(
+            query, [&](string_view term) { return index.find(term); }, uint32_t(files.size()));
+        cout << "Resultados para: " << query << "\n";
+        cout << "Documentos encontrados: " << result.cardinality() << "\n";
+        result.forEach([&](uint32_t doc_id) { cout << "- " << files[doc_id] << "\n"; });
+        cout << endl;
     }
-
-    return nullptr;
 }
 
 vector<string> list_text_files(const string& dir_path) {
@@ -86,12 +78,21 @@ vector<string> list_text_files(const string& dir_path) {
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        cerr << "Uso: " << argv[0] << " <directorio> <num_hilos>" << endl;
+        cerr << "Uso: " << argv[0] << " <directorio> <num_hilos> [--consultas] [--buffer MB] [--cola N]" << endl;
         return 1;
     }
 
     string dir_path = argv[1];
-    int num_threads = stoi(argv[2]);
+    int num_threads = max(1, stoi(argv[2]));
+    bool interactive = false;
+    uint64_t buffer_bytes = kDefaultChunkBytes;  // tamaño de cada lectura
+    size_t queue_depth = 8;                      // lecturas en vuelo
+    for (int i = 3; i < argc; ++i) {
+        string flag = argv[i];
+        if (flag == "--consultas") interactive = true;
+        else if (flag == "--buffer" && i + 1 < argc) buffer_bytes = stoull(argv[++i]) << 20;
+        else if (flag == "--cola" && i + 1 < argc) queue_depth = stoul(argv[++i]);
+    }
 
     vector<string> files = list_text_files(dir_path);
     if (files.empty()) {
@@ -99,38 +100,54 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    vector<pthread_t> threads(num_threads);
-    vector<ThreadData> thread_data(num_threads);
-
-    // Distribuir archivos equitativamente
-    for (size_t i = 0; i < files.size(); ++i) {
-        thread_data[i % num_threads].files.push_back(files[i]);
-    }
-
     auto start = high_resolution_clock::now();
 
-    for (int i = 0; i < num_threads; ++i) {
-        pthread_create(&threads[i], nullptr, process_files, &thread_data[i]);
+    // Un hilo lector llena búferes con rangos de líneas completas mientras
+    // num_threads hilos los tokenizan
+    ReadPipeline pipeline(files, plan_chunks(files, buffer_bytes, true), queue_depth, num_threads);
+    vector<LocalIndex> local_indexes(num_threads);
+    vector<thread> workers;
+    for (int w = 0; w < num_threads; ++w) {
+        workers.emplace_back([&, w] {
+            local_indexes[w].termIds.reserve(100000);  // Ajusta si tienes una idea del número de palabras
+            ReadBuffer* buffer;
+            while (pipeline.next(buffer)) {
+                size_t file = pipeline.chunks()[buffer->chunk].file;
+                if (!buffer->ok) cerr << "No se pudo leer: " << files[file] << endl;
+                process_buffer(*buffer, uint32_t(file), local_indexes[w]);
+                pipeline.release(buffer);
+            }
+            instr::add_unique_keys(local_indexes[w].termIds.size());
+        });
     }
+    for (auto& worker : workers) worker.join();
 
-    for (int i = 0; i < num_threads; ++i) {
-        pthread_join(threads[i], nullptr);
+    // Unir resultados al índice global: OR de bitmaps en paralelo
+    {
+        instr::Scope merge(instr::Stage::Merge);
+        dictionary::merge(local_indexes, global_index, local_indexes.size());
     }
 
     auto end = high_resolution_clock::now();
     duration<double> elapsed = end - start;
-    cout << "Indice invertido creado en " << elapsed.count() << " segundos.\n";
-
-    ofstream out("indice_invertido.txt");
-    for (const auto& [word, file_set] : global_index) {
-        out << word << ": ";
-        for (const string& file : file_set) {
-            out << file << " ";
+    cout << "Indice invertido creado en " << elapsed.count() << " segundos (lectura con "
+         << pipeline.backend() << ").\n";
+
+    {
+        instr::Scope serialize(instr::Stage::Serialize);
+        ofstream out("indice_invertido.txt");
+        for (size_t term_id = 0; term_id < global_index.terms.size(); ++term_id) {
+            out << global_index.terms[term_id] << ": ";
+            global_index.postings[term_id].forEach([&](uint32_t doc_id) {
+                out << files[doc_id] << " ";
+            });
+            out << "\n";
         }
-        out << "\n";
+        out.close();
     }
-    out.close();
 
     cout << "Indice guardado en 'indice_invertido.txt'.\n";
+
+    if (interactive) answer_queries(global_index, files);
     return 0;
 }
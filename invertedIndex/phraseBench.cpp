@@ -0,0 +1,155 @@
+#include <bits/stdc++.h>
+#include "query.h"
+#include "search.h"
+#include "segment.h"
+using namespace std;
+using namespace chrono;
+
+// Benchmark del costo de las posiciones: reescribe un segmento sin
+// posiciones y compara tamaño y latencia de consultas AND, frase y NEAR.
+// Las frases se toman de secuencias reales de un documento para que
+// tengan resultados.
+
+struct BenchPosting {
+    uint32_t docId;
+    uint32_t frequency;
+    vector<uint64_t> positions;
+};
+
+using BenchIndex = unordered_map<string, vector<BenchPosting>>;
+
+// Cuántas posiciones iniciales de cada documento muestreado se reconstruyen
+const uint64_t SAMPLE_WINDOW = 100000;
+
+// Intentos de muestreo por consulta antes de rendirse (documentos de una
+// palabra o sin pares de palabras consecutivas)
+const size_t SAMPLE_ATTEMPTS = 64;
+
+BenchIndex loadIndex(const segment::SegmentReader& reader) {
+    BenchIndex index;
+    index.reserve(reader.numTerms());
+    reader.forEachTerm([&](string_view term, const segment::PostingList& list) {
+        vector<uint32_t> docIds, freqs;
+        segment::decodeDocIds(list, docIds);
+        segment::decodeFrequencies(list, freqs);
+        segment::PositionCursor cursor(list);
+        vector<BenchPosting>& postings = index[string(term)];
+        postings.resize(docIds.size());
+        for (size_t i = 0; i < docIds.size(); ++i) {
+            postings[i].docId = docIds[i];
+            postings[i].frequency = freqs[i];
+            cursor.positionsAt(i, postings[i].positions);
+        }
+    });
+    return index;
+}
+
+// Texto (primeras SAMPLE_WINDOW posiciones) de un documento, reconstruido del índice
+vector<string> documentText(const BenchIndex& index, uint32_t docId) {
+    vector<string> words;
+    for (const auto& [term, postings] : index) {
+        auto it = lower_bound(postings.begin(), postings.end(), docId,
+            [](const BenchPosting& p, uint32_t id) { return p.docId < id; });
+        if (it == postings.end() || it->docId != docId) continue;
+        for (uint64_t pos : it->positions) {
+            if (pos >= SAMPLE_WINDOW) break;
+            if (pos >= words.size()) words.resize(pos + 1);
+            words[pos] = term;
+        }
+    }
+    return words;
+}
+
+struct Stats {
+    double p50, p99, mean;
+    double avgResults;
+};
+
+Stats run(const segment::SegmentReader& reader, const vector<string>& queries) {
+    vector<double> micros;
+    size_t results = 0;
+    for (const auto& text : queries) {
+        auto start = high_resolution_clock::now();
+        query::Query q = query::parse(text);
+        results += search::evaluate(reader, q).size();
+        duration<double, micro> elapsed = high_resolution_clock::now() - start;
+        micros.push_back(elapsed.count());
+    }
+    sort(micros.begin(), micros.end());
+    Stats s{};
+    if (micros.empty()) return s;
+    s.p50 = micros[micros.size() / 2];
+    s.p99 = micros[min(micros.size() - 1, micros.size() * 99 / 100)];
+    s.mean = accumulate(micros.begin(), micros.end(), 0.0) / micros.size();
+    s.avgResults = double(results) / queries.size();
+    return s;
+}
+
+void report(const string& name, const Stats& s) {
+    cout << left << setw(28) << name << right << fixed << setprecision(1)
+         << setw(10) << s.p50 << setw(10) << s.p99 << setw(10) << s.mean
+         << setw(12) << s.avgResults << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Uso: " << argv[0] << " <inverted_index.seg> [num_consultas] [semilla]" << endl;
+        return 1;
+    }
+    string path = argv[1];
+    size_t numQueries = argc >= 3 ? stoul(argv[2]) : 1000;
+    unsigned seed = argc >= 4 ? stoul(argv[3]) : 42;
+
+    segment::SegmentReader positional;
+    if (!positional.open(path) || !positional.hasPositions()) {
+        cerr << "Se necesita un segmento con posiciones: " << path << endl;
+        return 1;
+    }
+
+    // Copia del mismo índice sin posiciones
+    BenchIndex index = loadIndex(positional);
+    string noPosPath = path + ".nopos";
+    if (!segment::writeSegment(noPosPath, index, positional.docLengths(), false)) {
+        cerr << "Error al crear " << noPosPath << endl;
+        return 1;
+    }
+    segment::SegmentReader plain;
+    if (!plain.open(noPosPath)) {
+        cerr << "Error al abrir " << noPosPath << endl;
+        return 1;
+    }
+
+    // Consultas: pares de palabras consecutivas de documentos al azar
+    mt19937 gen(seed);
+    vector<string> andQueries, phraseQueries, nearQueries;
+    vector<string> text;
+    size_t attempts = 0;
+    while (andQueries.size() < numQueries) {
+        if (++attempts > numQueries * SAMPLE_ATTEMPTS) {
+            cerr << "No se encontraron pares de palabras consecutivas en el segmento" << endl;
+            return 1;
+        }
+        if (text.size() < 2 || gen() % 64 == 0) {
+            text = documentText(index, gen() % max<uint64_t>(1, positional.numDocs()));
+            if (text.size() < 2) continue;
+        }
+        size_t p = gen() % (text.size() - 1);
+        if (text[p].empty() || text[p + 1].empty()) continue;
+        andQueries.push_back(text[p] + " " + text[p + 1]);
+        phraseQueries.push_back("\"" + text[p] + " " + text[p + 1] + "\"");
+        nearQueries.push_back(text[p] + " NEAR/5 " + text[p + 1]);
+    }
+
+    cout << "Segmento con posiciones: " << positional.fileSize() << " bytes" << endl;
+    cout << "Segmento sin posiciones: " << plain.fileSize() << " bytes ("
+         << fixed << setprecision(2) << double(positional.fileSize()) / max<uint64_t>(1, plain.fileSize())
+         << "x)" << endl;
+    cout << numQueries << " consultas por tipo, latencia en microsegundos" << endl;
+    cout << left << setw(28) << "Consulta" << right << setw(10) << "p50" << setw(10) << "p99"
+         << setw(10) << "media" << setw(12) << "docs/cons" << endl;
+    report("AND sin posiciones", run(plain, andQueries));
+    report("AND con posiciones", run(positional, andQueries));
+    report("Frase", run(positional, phraseQueries));
+    report("NEAR/5", run(positional, nearQueries));
+    return 0;
+}
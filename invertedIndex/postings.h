@@ -0,0 +1,119 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POSTINGS_X86 1
+#endif
+
+// Intersección de listas ordenadas de docIds (sin repetidos).
+namespace postings {
+
+// Si la lista larga es más de kGallopRatio veces la corta conviene galopar
+constexpr size_t kGallopRatio = 32;
+
+// Mezcla clásica de dos listas
+inline void intersectMerge(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                           std::vector<uint32_t>& out) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) ++i;
+        else if (b[j] < a[i]) ++j;
+        else {
+            out.push_back(a[i]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// Primer índice >= from con b[índice] >= x: búsqueda exponencial y luego binaria
+inline size_t gallop(const uint32_t* b, size_t nb, size_t from, uint32_t x) {
+    size_t step = 1, lo = from, hi = from;
+    while (hi < nb && b[hi] < x) {
+        lo = hi + 1;
+        hi = from + step;
+        step *= 2;
+    }
+    hi = std::min(hi, nb);
+    return std::lower_bound(b + lo, b + hi, x) - b;
+}
+
+// a es la lista corta: cada elemento se busca galopando en b
+inline void intersectGalloping(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                               std::vector<uint32_t>& out) {
+    size_t j = 0;
+    for (size_t i = 0; i < na && j < nb; ++i) {
+        j = gallop(b, nb, j, a[i]);
+        if (j < nb && b[j] == a[i]) out.push_back(a[i]);
+    }
+}
+
+#ifdef POSTINGS_X86
+// Listas densas: b se recorre en bloques de 8 y cada elemento de a se
+// compara contra su bloque con una sola instrucción AVX2
+__attribute__((target("avx2")))
+inline void intersectBlocksAvx2(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                                std::vector<uint32_t>& out) {
+    size_t i = 0, j = 0;
+    while (i < na && j + 8 <= nb) {
+        uint32_t x = a[i];
+        while (j + 8 <= nb && b[j + 7] < x) j += 8;
+        if (j + 8 > nb) break;
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        __m256i eq = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(int(x)));
+        if (_mm256_movemask_epi8(eq)) out.push_back(x);
+        ++i;
+    }
+    intersectMerge(a + i, na - i, b + j, nb - j, out);
+}
+
+inline bool hasAvx2() {
+    static const bool avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return avx2;
+}
+#endif
+
+// Intersección de dos listas eligiendo el algoritmo según sus tamaños
+inline void intersect(const uint32_t* a, size_t na, const uint32_t* b, size_t nb,
+                      std::vector<uint32_t>& out) {
+    if (na > nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    out.clear();
+    if (na == 0) return;
+    if (nb / na >= kGallopRatio) {
+        intersectGalloping(a, na, b, nb, out);
+        return;
+    }
+#ifdef POSTINGS_X86
+    if (hasAvx2()) {
+        intersectBlocksAvx2(a, na, b, nb, out);
+        return;
+    }
+#endif
+    intersectMerge(a, na, b, nb, out);
+}
+
+// AND de varias listas: se empieza por la más rara y se corta en cuanto el
+// resultado queda vacío
+inline std::vector<uint32_t> intersectAll(std::vector<const std::vector<uint32_t>*> lists) {
+    std::vector<uint32_t> result, scratch;
+    if (lists.empty()) return result;
+    std::sort(lists.begin(), lists.end(),
+              [](const auto* a, const auto* b) { return a->size() < b->size(); });
+    result = *lists[0];
+    for (size_t k = 1; k < lists.size() && !result.empty(); ++k) {
+        intersect(result.data(), result.size(), lists[k]->data(), lists[k]->size(), scratch);
+        result.swap(scratch);
+    }
+    return result;
+}
+
+}  // namespace postings
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/tokenizer.h"
+
+// Consultas con frases y proximidad.
+//
+//   casa roja            AND de términos
+//   "nueva york" hotel   frase exacta (posiciones consecutivas) AND hotel
+//   perro NEAR/3 gato    ambos términos a 3 posiciones o menos, en cualquier orden
+//
+// Todas las cláusulas se combinan con AND. Primero se intersectan los docIds
+// de todos los términos; las posiciones solo se leen para los documentos que
+// pasan esa intersección.
+namespace query {
+
+struct Clause {
+    enum Kind { Phrase, Near };
+    Kind kind;
+    std::vector<std::string> terms;
+    size_t distance = 0;  // solo Near
+};
+
+struct Query {
+    std::vector<std::string> terms;  // todos los términos, sin repetir
+    std::vector<Clause> clauses;     // cláusulas que necesitan posiciones
+
+    bool needsPositions() const { return !clauses.empty(); }
+};
+
+inline void addTerm(Query& q, const std::string& term) {
+    if (std::find(q.terms.begin(), q.terms.end(), term) == q.terms.end()) q.terms.push_back(term);
+}
+
+// Devuelve k si token es NEAR/k
+inline bool parseNear(std::string_view token, size_t& k) {
+    if (token.size() <= 5 || token.substr(0, 5) != "NEAR/") return false;
+    k = 0;
+    for (char c : token.substr(5)) {
+        if (c < '0' || c > '9') return false;
+        k = k * 10 + size_t(c - '0');
+    }
+    return true;
+}
+
+inline Query parse(std::string_view text) {
+    Query q;
+    std::string lastTerm;
+    size_t pendingNear = 0;
+    bool nearPending = false;
+    size_t i = 0;
+    while (i < text.size()) {
+        if (tok::is_space(text[i])) {
+            ++i;
+            continue;
+        }
+        if (text[i] == '"') {
+            size_t close = text.find('"', i + 1);
+            if (close == std::string_view::npos) close = text.size();
+            std::vector<std::string> words = tok::thread_tokenizer().tokenize(text.substr(i + 1, close - i - 1));
+            for (const auto& w : words) addTerm(q, w);
+            if (words.size() > 1) q.clauses.push_back({Clause::Phrase, words, 0});
+            lastTerm.clear();
+            nearPending = false;
+            i = close + 1;
+            continue;
+        }
+        size_t end = i;
+        while (end < text.size() && !tok::is_space(text[end]) && text[end] != '"') ++end;
+        std::string_view raw = text.substr(i, end - i);
+        i = end;
+
+        size_t k;
+        if (parseNear(raw, k)) {
+            nearPending = !lastTerm.empty();
+            pendingNear = k;
+            continue;
+        }
+        std::string term = tok::normalize(raw);
+        if (term.empty()) continue;
+        addTerm(q, term);
+        if (nearPending) q.clauses.push_back({Clause::Near, {lastTerm, term}, pendingNear});
+        nearPending = false;
+        lastTerm = term;
+    }
+    return q;
+}
+
+// ¿Aparecen los términos en posiciones consecutivas? positions[i] son las
+// posiciones ordenadas del i-ésimo término de la frase. Sale en la primera
+// coincidencia.
+inline bool matchPhrase(const std::vector<const std::vector<uint64_t>*>& positions) {
+    if (positions.empty()) return false;
+    std::vector<size_t> cursor(positions.size(), 0);
+    for (uint64_t start : *positions[0]) {
+        bool ok = true;
+        for (size_t t = 1; t < positions.size() && ok; ++t) {
+            const auto& p = *positions[t];
+            size_t& j = cursor[t];
+            while (j < p.size() && p[j] < start + t) ++j;
+            if (j == p.size()) return false;
+            ok = p[j] == start + t;
+        }
+        if (ok) return true;
+    }
+    return false;
+}
+
+// ¿Hay una posición de a y otra de b a distancia <= k?
+inline bool matchNear(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b, size_t k) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        uint64_t diff = a[i] > b[j] ? a[i] - b[j] : b[j] - a[i];
+        if (diff <= k) return true;
+        if (a[i] < b[j]) ++i;
+        else ++j;
+    }
+    return false;
+}
+
+// Verifica las cláusulas de un documento. positionsOf(term) devuelve las
+// posiciones del término en ese documento; se llama solo para los términos
+// de las cláusulas y se corta en la primera cláusula que falla.
+template <class PositionsOf>
+bool matchClauses(const Query& q, PositionsOf&& positionsOf) {
+    std::vector<const std::vector<uint64_t>*> lists;
+    for (const auto& clause : q.clauses) {
+        lists.clear();
+        for (const auto& term : clause.terms) lists.push_back(&positionsOf(term));
+        bool ok = clause.kind == Clause::Phrase ? matchPhrase(lists)
+                                                : matchNear(*lists[0], *lists[1], clause.distance);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+}  // namespace query
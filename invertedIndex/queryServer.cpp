@@ -0,0 +1,186 @@
+#include <bits/stdc++.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../common/mapped_file.h"
+#include "../common/tokenizer.h"
+#include "query.h"
+#include "ranking.h"
+#include "search.h"
+#include "segment.h"
+using namespace std;
+
+// Servidor de consultas sobre un segmento ya guardado por test.cpp.
+// El segmento y el mapeo de documentos se mapean en memoria: no se
+// reconstruye ningún índice, así que arranca en milisegundos y la memoria
+// residente crece solo con las páginas que las consultas tocan.
+
+// Mapeo docId -> ruta, con vistas sobre document_mapping.txt mapeado
+struct DocumentTable {
+    MappedFile file;
+    vector<string_view> paths;
+
+    bool load(const string& path) {
+        if (!file.open(path)) return false;
+        string_view data = file.view();
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t end = data.find('\n', pos);
+            if (end == string_view::npos) end = data.size();
+            string_view line = data.substr(pos, end - pos);
+            size_t space = line.find(' ');
+            if (space != string_view::npos) {
+                size_t id = 0;
+                from_chars(line.data(), line.data() + space, id);
+                if (id >= paths.size()) paths.resize(id + 1);
+                paths[id] = line.substr(space + 1);
+            }
+            pos = end + 1;
+        }
+        return true;
+    }
+};
+
+// Función para buscar en el segmento: AND de términos, frases "..." y NEAR/k
+string searchSegment(const segment::SegmentReader& index, const DocumentTable& docs, const string& query) {
+    query::Query parsed = query::parse(query);
+    if (parsed.needsPositions() && !index.hasPositions()) {
+        return "El segmento no tiene posiciones: no admite frases ni NEAR\n";
+    }
+
+    vector<uint32_t> resultDocs = search::evaluate(index, parsed);
+
+    ostringstream out;
+    out << "Resultados para: " << query << "\n";
+    out << "Documentos encontrados: " << resultDocs.size() << "\n";
+    for (uint32_t docId : resultDocs) {
+        out << "- " << (docId < docs.paths.size() ? docs.paths[docId] : string_view("?")) << "\n";
+    }
+    return out.str();
+}
+
+// Función para buscar los k documentos más relevantes (BM25, OR de términos)
+string searchRanked(const segment::SegmentReader& index, const DocumentTable& docs, const string& query, size_t k) {
+    query::Query parsed = query::parse(query);
+    vector<ranking::ScoredDoc> resultDocs = ranking::topK(index, parsed.terms, k);
+
+    ostringstream out;
+    out << "Resultados para: " << query << "\n";
+    out << "Documentos encontrados: " << resultDocs.size() << "\n";
+    out << fixed << setprecision(4);
+    for (const auto& result : resultDocs) {
+        out << "- " << (result.docId < docs.paths.size() ? docs.paths[result.docId] : string_view("?"))
+            << " (" << result.score << ")\n";
+    }
+    return out.str();
+}
+
+// Con topK > 0 se responde con ranking; si no, con la búsqueda booleana
+string answer(const segment::SegmentReader& index, const DocumentTable& docs, const string& query, size_t topK) {
+    return topK ? searchRanked(index, docs, query, topK) : searchSegment(index, docs, query);
+}
+
+// Atiende una conexión: una consulta por línea, respuesta terminada en línea vacía
+void serveClient(int fd, const segment::SegmentReader& index, const DocumentTable& docs, size_t topK) {
+    string pending;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, n);
+        size_t newline;
+        while ((newline = pending.find('\n')) != string::npos) {
+            string query = pending.substr(0, newline);
+            pending.erase(0, newline + 1);
+            if (query == "salir") {
+                close(fd);
+                return;
+            }
+            string response = answer(index, docs, query, topK) + "\n";
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t w = write(fd, response.data() + sent, response.size() - sent);
+                if (w <= 0) {
+                    close(fd);
+                    return;
+                }
+                sent += w;
+            }
+        }
+    }
+    close(fd);
+}
+
+int serveSocket(const string& socketPath, const segment::SegmentReader& index, const DocumentTable& docs,
+                size_t topK) {
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        cerr << "Error al crear socket" << endl;
+        return 1;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << "Ruta de socket demasiado larga: " << socketPath << endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+    unlink(socketPath.c_str());
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(server, 64) < 0) {
+        cerr << "Error al escuchar en " << socketPath << endl;
+        return 1;
+    }
+    cout << "Escuchando en " << socketPath << endl;
+
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+        thread(serveClient, client, cref(index), cref(docs), topK).detach();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Un cliente que se desconecta a mitad de respuesta no debe matar al servidor
+    signal(SIGPIPE, SIG_IGN);
+
+    if (argc < 3) {
+        cerr << "Uso: " << argv[0] << " <inverted_index.seg> <document_mapping.txt> [--top K] [--socket ruta]" << endl;
+        return 1;
+    }
+
+    // --top K: ranking BM25 de los K mejores documentos en vez de AND
+    size_t topK = 0;
+    string socketPath;
+    for (int i = 3; i + 1 < argc; i += 2) {
+        string flag = argv[i];
+        if (flag == "--top") topK = stoul(argv[i + 1]);
+        else if (flag == "--socket") socketPath = argv[i + 1];
+    }
+
+    auto startTime = chrono::high_resolution_clock::now();
+
+    segment::SegmentReader index;
+    if (!index.open(argv[1])) {
+        cerr << "Error al abrir segmento: " << argv[1] << endl;
+        return 1;
+    }
+    DocumentTable docs;
+    if (!docs.load(argv[2])) {
+        cerr << "Error al abrir mapeo de documentos: " << argv[2] << endl;
+        return 1;
+    }
+
+    auto endTime = chrono::high_resolution_clock::now();
+    chrono::duration<double, milli> elapsed = endTime - startTime;
+    cerr << "Segmento cargado en " << elapsed.count() << " ms (" << index.numTerms()
+         << " términos, " << index.numDocs() << " documentos)" << endl;
+
+    if (!socketPath.empty()) {
+        return serveSocket(socketPath, index, docs, topK);
+    }
+
+    // Consultas desde stdin
+    string query;
+    while (getline(cin, query) && query != "salir") {
+        cout << answer(index, docs, query, topK) << endl;
+    }
+    return 0;
+}
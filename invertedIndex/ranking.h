@@ -0,0 +1,205 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include "segment.h"
+
+// Recuperación rankeada top-k con BM25 y block-max WAND sobre un segmento.
+//
+// Cada lista guarda por bloque de 128 postings su último docId y la cota
+// máxima de BM25 del bloque. WAND elige un pivote con las cotas globales de
+// cada término y, antes de decodificar nada, comprueba las cotas de los
+// bloques que contendrían al pivote: si no alcanzan el umbral del heap se
+// salta hasta el final del bloque más corto sin puntuar ningún documento.
+namespace ranking {
+
+constexpr uint32_t kEndDoc = std::numeric_limits<uint32_t>::max();
+
+struct ScoredDoc {
+    uint32_t docId;
+    double score;
+};
+
+// Cursor sobre la lista de un término que decodifica bloque a bloque
+class TermCursor {
+public:
+    TermCursor(const segment::PostingList& list, double idf) : list_(list), idf_(idf) {
+        double maxTf = 0;
+        for (size_t b = 0; b < list_.numBlocks(); ++b) maxTf = std::max<double>(maxTf, list_.block(b).maxTf);
+        upper_ = idf_ * maxTf;
+        if (list_.numBlocks() > 0) loadBlock(0);
+    }
+
+    uint32_t doc() const { return doc_; }
+    uint32_t freq() const { return freqs_[pos_] + 1; }
+    double idf() const { return idf_; }
+    // Cota de toda la lista
+    double upperBound() const { return upper_; }
+
+    void next() {
+        if (doc_ == kEndDoc) return;
+        if (++pos_ < count_) {
+            doc_ = docs_[pos_];
+        } else if (block_ + 1 < list_.numBlocks()) {
+            loadBlock(block_ + 1);
+        } else {
+            doc_ = kEndDoc;
+        }
+    }
+
+    // Primer documento >= target
+    void nextGEQ(uint32_t target) {
+        if (doc_ >= target) return;
+        size_t b = findBlock(target);
+        if (b == list_.numBlocks()) {
+            doc_ = kEndDoc;
+            return;
+        }
+        if (b != block_) loadBlock(b);
+        pos_ = std::lower_bound(docs_ + pos_, docs_ + count_, target) - docs_;
+        doc_ = docs_[pos_];
+    }
+
+    // Mueve solo el puntero de bloques al que contendría target, sin decodificar
+    void shallowTo(uint32_t target) { shallow_ = findBlock(target); }
+    double blockMax() const {
+        return shallow_ < list_.numBlocks() ? idf_ * list_.block(shallow_).maxTf : 0.0;
+    }
+    uint32_t blockLast() const {
+        return shallow_ < list_.numBlocks() ? list_.block(shallow_).lastDocId : kEndDoc;
+    }
+
+private:
+    size_t findBlock(uint32_t target) const {
+        size_t b = block_;
+        while (b < list_.numBlocks() && list_.block(b).lastDocId < target) ++b;
+        return b;
+    }
+
+    void loadBlock(size_t b) {
+        segment::BlockInfo info = list_.block(b);
+        count_ = std::min<size_t>(segment::kPackBlock, list_.df - b * segment::kPackBlock);
+        segment::decodeBlock(list_.docs.data() + info.docsOffset, count_, docs_);
+        segment::decodeBlock(list_.freqs.data() + info.freqsOffset, count_, freqs_);
+        uint32_t doc = b == 0 ? 0 : list_.block(b - 1).lastDocId;
+        for (size_t i = 0; i < count_; ++i) {
+            doc += docs_[i];
+            docs_[i] = doc;
+        }
+        block_ = b;
+        pos_ = 0;
+        doc_ = docs_[0];
+    }
+
+    segment::PostingList list_;
+    double idf_;
+    double upper_ = 0;
+    size_t block_ = 0;
+    size_t shallow_ = 0;
+    size_t count_ = 0;
+    size_t pos_ = 0;
+    uint32_t doc_ = kEndDoc;
+    uint32_t docs_[segment::kPackBlock];
+    uint32_t freqs_[segment::kPackBlock];
+};
+
+// Los k documentos con mayor BM25 para los términos (OR), ordenados por score
+inline std::vector<ScoredDoc> topK(const segment::SegmentReader& index,
+                                   const std::vector<std::string>& terms, size_t k) {
+    std::vector<TermCursor> cursors;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (std::find(terms.begin(), terms.begin() + i, terms[i]) != terms.begin() + i) continue;
+        if (auto list = index.find(terms[i])) {
+            cursors.emplace_back(*list, segment::bm25Idf(list->df, index.numDocs()));
+        }
+    }
+    if (k == 0 || cursors.empty()) return {};
+
+    double avgDocLength = index.avgDocLength();
+    auto worse = [](const ScoredDoc& a, const ScoredDoc& b) {
+        return a.score > b.score || (a.score == b.score && a.docId < b.docId);
+    };
+    std::vector<ScoredDoc> heap;  // min-heap de los k mejores
+    double threshold = 0;
+
+    std::vector<TermCursor*> order;
+    for (auto& c : cursors) order.push_back(&c);
+
+    while (true) {
+        std::sort(order.begin(), order.end(),
+                  [](const TermCursor* a, const TermCursor* b) { return a->doc() < b->doc(); });
+
+        // Pivote: primer término en que la suma de cotas supera el umbral
+        double acc = 0;
+        size_t p = 0;
+        bool found = false;
+        for (; p < order.size() && order[p]->doc() != kEndDoc; ++p) {
+            acc += order[p]->upperBound();
+            if (acc > threshold) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) break;
+        uint32_t pivotDoc = order[p]->doc();
+        while (p + 1 < order.size() && order[p + 1]->doc() == pivotDoc) ++p;
+
+        // Cotas de los bloques que contendrían al pivote
+        double blockSum = 0;
+        for (size_t i = 0; i <= p; ++i) {
+            order[i]->shallowTo(pivotDoc);
+            blockSum += order[i]->blockMax();
+        }
+
+        if (blockSum > threshold) {
+            if (order[0]->doc() == pivotDoc) {
+                // Todos los cursores hasta p están en el pivote: puntuar
+                uint32_t length = index.docLength(pivotDoc);
+                double score = 0;
+                for (size_t i = 0; i <= p; ++i) {
+                    score += order[i]->idf() * segment::bm25Tf(order[i]->freq(), length, avgDocLength);
+                    order[i]->next();
+                }
+                ScoredDoc candidate{pivotDoc, score};
+                if (heap.size() < k) {
+                    heap.push_back(candidate);
+                    std::push_heap(heap.begin(), heap.end(), worse);
+                } else if (worse(candidate, heap.front())) {
+                    std::pop_heap(heap.begin(), heap.end(), worse);
+                    heap.back() = candidate;
+                    std::push_heap(heap.begin(), heap.end(), worse);
+                }
+                if (heap.size() == k) threshold = heap.front().score;
+            } else {
+                // Acercar al pivote el término previo con mayor cota
+                size_t best = 0;
+                for (size_t i = 1; i < p && order[i]->doc() < pivotDoc; ++i) {
+                    if (order[i]->upperBound() > order[best]->upperBound()) best = i;
+                }
+                order[best]->nextGEQ(pivotDoc);
+            }
+        } else {
+            // Ningún documento antes del fin del bloque más corto puede entrar
+            uint32_t next = kEndDoc;
+            for (size_t i = 0; i <= p; ++i) {
+                uint32_t last = order[i]->blockLast();
+                next = std::min(next, last == kEndDoc ? kEndDoc : last + 1);
+            }
+            if (p + 1 < order.size()) next = std::min(next, order[p + 1]->doc());
+            if (next <= pivotDoc) next = pivotDoc + 1;
+
+            size_t best = 0;
+            for (size_t i = 1; i <= p; ++i) {
+                if (order[i]->upperBound() > order[best]->upperBound()) best = i;
+            }
+            order[best]->nextGEQ(next);
+        }
+    }
+
+    std::sort(heap.begin(), heap.end(), worse);
+    return heap;
+}
+
+}  // namespace ranking
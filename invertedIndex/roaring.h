@@ -0,0 +1,336 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Conjuntos de docIds comprimidos al estilo Roaring: los 16 bits altos eligen
+// un contenedor y los 16 bajos se guardan en el contenedor más pequeño de
+// tres: arreglo ordenado (hasta 4096 valores), mapa de 65536 bits o lista de
+// corridas (inicio, largo - 1). Una palabra que aparece en todos los archivos
+// ocupa una sola corrida por contenedor.
+namespace roaring {
+
+constexpr uint32_t kArrayMax = 4096;
+constexpr size_t kBitsWords = 1024;
+
+struct Container {
+    enum Kind : uint8_t { Array, Bits, Run };
+    Kind kind = Array;
+    uint32_t card = 0;
+    std::vector<uint16_t> values;  // Array: valores; Run: pares (inicio, largo - 1)
+    std::vector<uint64_t> bits;    // Bits: kBitsWords palabras
+
+    bool contains(uint16_t low) const {
+        switch (kind) {
+        case Array:
+            return std::binary_search(values.begin(), values.end(), low);
+        case Bits:
+            return (bits[low >> 6] >> (low & 63)) & 1;
+        case Run:
+            for (size_t lo = 0, hi = values.size() / 2; lo < hi;) {
+                size_t mid = (lo + hi) / 2;
+                uint32_t start = values[2 * mid], last = start + values[2 * mid + 1];
+                if (low < start) hi = mid;
+                else if (low > last) lo = mid + 1;
+                else return true;
+            }
+            return false;
+        }
+        return false;
+    }
+
+    template <class Fn>
+    void forEach(Fn&& fn) const {
+        switch (kind) {
+        case Array:
+            for (uint16_t v : values) fn(v);
+            break;
+        case Bits:
+            for (size_t w = 0; w < kBitsWords; ++w) {
+                for (uint64_t word = bits[w]; word; word &= word - 1) {
+                    fn(uint16_t(w * 64 + __builtin_ctzll(word)));
+                }
+            }
+            break;
+        case Run:
+            for (size_t i = 0; i < values.size(); i += 2) {
+                for (uint32_t v = values[i]; v <= uint32_t(values[i]) + values[i + 1]; ++v) fn(uint16_t(v));
+            }
+            break;
+        }
+    }
+
+    std::vector<uint64_t> toBits() const {
+        if (kind == Bits) return bits;
+        std::vector<uint64_t> out(kBitsWords, 0);
+        if (kind == Run) {
+            for (size_t i = 0; i < values.size(); i += 2) {
+                uint32_t start = values[i], end = start + values[i + 1] + 1;
+                for (uint32_t v = start; v < end;) {
+                    // palabras enteras cuando se puede
+                    if ((v & 63) == 0 && v + 64 <= end) {
+                        out[v >> 6] = ~uint64_t(0);
+                        v += 64;
+                    } else {
+                        out[v >> 6] |= uint64_t(1) << (v & 63);
+                        ++v;
+                    }
+                }
+            }
+        } else {
+            for (uint16_t v : values) out[v >> 6] |= uint64_t(1) << (v & 63);
+        }
+        return out;
+    }
+
+    // Arreglo si caben kArrayMax valores, si no mapa de bits
+    static Container fromBits(std::vector<uint64_t> words) {
+        Container c;
+        for (uint64_t w : words) c.card += uint32_t(__builtin_popcountll(w));
+        if (c.card > kArrayMax) {
+            c.kind = Bits;
+            c.bits = std::move(words);
+            return c;
+        }
+        c.values.reserve(c.card);
+        for (size_t w = 0; w < kBitsWords; ++w) {
+            for (uint64_t word = words[w]; word; word &= word - 1) {
+                c.values.push_back(uint16_t(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        return c;
+    }
+
+    static Container fromArray(std::vector<uint16_t> sorted) {
+        Container c;
+        c.card = uint32_t(sorted.size());
+        c.values = std::move(sorted);
+        return c;
+    }
+
+    void add(uint16_t low) {
+        if (kind == Run) *this = fromBits(toBits());
+        if (kind == Bits) {
+            uint64_t& word = bits[low >> 6];
+            uint64_t mask = uint64_t(1) << (low & 63);
+            card += (word & mask) == 0;
+            word |= mask;
+            return;
+        }
+        // Los docIds suelen llegar en orden: añadir al final es el caso común
+        if (values.empty() || values.back() < low) {
+            values.push_back(low);
+        } else {
+            auto it = std::lower_bound(values.begin(), values.end(), low);
+            if (*it == low) return;
+            values.insert(it, low);
+        }
+        if (++card > kArrayMax) *this = fromBits(toBits());
+    }
+
+    // Elige la representación más pequeña, incluidas las corridas
+    void optimize() {
+        size_t runs = 0;
+        int64_t previous = -2;
+        forEach([&](uint16_t v) {
+            if (v != previous + 1) ++runs;
+            previous = v;
+        });
+        size_t runBytes = runs * 4;
+        size_t plainBytes = card <= kArrayMax ? card * 2 : kBitsWords * 8;
+        if (runBytes < plainBytes) {
+            if (kind == Run) return;
+            std::vector<uint16_t> pairs;
+            pairs.reserve(runs * 2);
+            forEach([&](uint16_t v) {
+                if (!pairs.empty() && uint32_t(pairs[pairs.size() - 2]) + pairs.back() + 1 == v) {
+                    ++pairs.back();
+                } else {
+                    pairs.push_back(v);
+                    pairs.push_back(0);
+                }
+            });
+            values = std::move(pairs);
+            bits.clear();
+            bits.shrink_to_fit();
+            kind = Run;
+        } else if (kind == Run) {
+            *this = fromBits(toBits());
+        }
+        values.shrink_to_fit();
+    }
+
+    size_t sizeInBytes() const { return values.size() * sizeof(uint16_t) + bits.size() * sizeof(uint64_t); }
+};
+
+inline Container unite(const Container& a, const Container& b) {
+    if (a.kind == Container::Array && b.kind == Container::Array && a.card + b.card <= kArrayMax) {
+        std::vector<uint16_t> out;
+        out.reserve(a.card + b.card);
+        std::set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                       std::back_inserter(out));
+        return Container::fromArray(std::move(out));
+    }
+    std::vector<uint64_t> words = a.toBits();
+    if (b.kind == Container::Array) {
+        for (uint16_t v : b.values) words[v >> 6] |= uint64_t(1) << (v & 63);
+    } else {
+        std::vector<uint64_t> other = b.toBits();
+        for (size_t w = 0; w < kBitsWords; ++w) words[w] |= other[w];
+    }
+    return Container::fromBits(std::move(words));
+}
+
+inline Container intersect(const Container& a, const Container& b) {
+    // Con un arreglo basta filtrarlo contra el otro contenedor
+    if (a.kind == Container::Array || b.kind == Container::Array) {
+        const Container& small = a.kind == Container::Array ? a : b;
+        const Container& other = a.kind == Container::Array ? b : a;
+        std::vector<uint16_t> out;
+        for (uint16_t v : small.values) {
+            if (other.contains(v)) out.push_back(v);
+        }
+        return Container::fromArray(std::move(out));
+    }
+    std::vector<uint64_t> words = a.toBits();
+    std::vector<uint64_t> other = b.toBits();
+    for (size_t w = 0; w < kBitsWords; ++w) words[w] &= other[w];
+    return Container::fromBits(std::move(words));
+}
+
+// a sin los elementos de b
+inline Container subtract(const Container& a, const Container& b) {
+    if (a.kind == Container::Array) {
+        std::vector<uint16_t> out;
+        for (uint16_t v : a.values) {
+            if (!b.contains(v)) out.push_back(v);
+        }
+        return Container::fromArray(std::move(out));
+    }
+    std::vector<uint64_t> words = a.toBits();
+    if (b.kind == Container::Array) {
+        for (uint16_t v : b.values) words[v >> 6] &= ~(uint64_t(1) << (v & 63));
+    } else {
+        std::vector<uint64_t> other = b.toBits();
+        for (size_t w = 0; w < kBitsWords; ++w) words[w] &= ~other[w];
+    }
+    return Container::fromBits(std::move(words));
+}
+
+class Bitmap {
+public:
+    // [0, n) como corridas
+    static Bitmap range(uint32_t n) {
+        Bitmap out;
+        for (uint64_t start = 0; start < n; start += 65536) {
+            Container c;
+            c.kind = Container::Run;
+            c.card = uint32_t(std::min<uint64_t>(65536, n - start));
+            c.values = {0, uint16_t(c.card - 1)};
+            out.keys_.push_back(uint16_t(start >> 16));
+            out.containers_.push_back(std::move(c));
+        }
+        return out;
+    }
+
+    void add(uint32_t x) {
+        uint16_t key = uint16_t(x >> 16);
+        if (keys_.empty() || keys_.back() < key) {
+            keys_.push_back(key);
+            containers_.emplace_back();
+            containers_.back().add(uint16_t(x));
+            return;
+        }
+        size_t i = std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+        if (keys_[i] != key) {
+            keys_.insert(keys_.begin() + i, key);
+            containers_.insert(containers_.begin() + i, Container());
+        }
+        containers_[i].add(uint16_t(x));
+    }
+
+    bool contains(uint32_t x) const {
+        uint16_t key = uint16_t(x >> 16);
+        auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+        return it != keys_.end() && *it == key && containers_[it - keys_.begin()].contains(uint16_t(x));
+    }
+
+    bool empty() const { return keys_.empty(); }
+
+    uint64_t cardinality() const {
+        uint64_t total = 0;
+        for (const auto& c : containers_) total += c.card;
+        return total;
+    }
+
+    size_t sizeInBytes() const {
+        size_t total = keys_.size() * (sizeof(uint16_t) + sizeof(Container));
+        for (const auto& c : containers_) total += c.sizeInBytes();
+        return total;
+    }
+
+    void optimize() {
+        for (auto& c : containers_) c.optimize();
+    }
+
+    // fn(docId) en orden creciente
+    template <class Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            uint32_t high = uint32_t(keys_[i]) << 16;
+            containers_[i].forEach([&](uint16_t low) { fn(high | low); });
+        }
+    }
+
+    std::vector<uint32_t> toVector() const {
+        std::vector<uint32_t> out;
+        out.reserve(cardinality());
+        forEach([&](uint32_t x) { out.push_back(x); });
+        return out;
+    }
+
+    Bitmap& operator|=(const Bitmap& other) {
+        if (keys_.empty()) return *this = other;
+        *this = combine(*this, other, unite, true, true);
+        return *this;
+    }
+
+    friend Bitmap operator|(const Bitmap& a, const Bitmap& b) { return combine(a, b, unite, true, true); }
+    friend Bitmap operator&(const Bitmap& a, const Bitmap& b) { return combine(a, b, intersect, false, false); }
+    // a AND NOT b
+    friend Bitmap operator-(const Bitmap& a, const Bitmap& b) { return combine(a, b, subtract, true, false); }
+
+private:
+    // Recorre las claves de a y b en orden; keepA/keepB dicen si se conservan
+    // los contenedores que solo aparecen en uno de los dos
+    template <class Op>
+    static Bitmap combine(const Bitmap& a, const Bitmap& b, Op op, bool keepA, bool keepB) {
+        Bitmap out;
+        size_t i = 0, j = 0;
+        auto push = [&](uint16_t key, Container c) {
+            if (c.card == 0) return;
+            out.keys_.push_back(key);
+            out.containers_.push_back(std::move(c));
+        };
+        while (i < a.keys_.size() || j < b.keys_.size()) {
+            if (j == b.keys_.size() || (i < a.keys_.size() && a.keys_[i] < b.keys_[j])) {
+                if (keepA) push(a.keys_[i], a.containers_[i]);
+                ++i;
+            } else if (i == a.keys_.size() || b.keys_[j] < a.keys_[i]) {
+                if (keepB) push(b.keys_[j], b.containers_[j]);
+                ++j;
+            } else {
+                push(a.keys_[i], op(a.containers_[i], b.containers_[j]));
+                ++i;
+                ++j;
+            }
+        }
+        return out;
+    }
+
+    std::vector<uint16_t> keys_;
+    std::vector<Container> containers_;
+};
+
+}  // namespace roaring
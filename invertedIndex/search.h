@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "postings.h"
+#include "query.h"
+#include "segment.h"
+
+// Evaluación de consultas sobre un segmento mapeado.
+namespace search {
+
+// docIds (ordenados) que cumplen la consulta. Las frases y NEAR requieren un
+// segmento con posiciones; sin ellas solo se evalúa el AND de los términos.
+inline std::vector<uint32_t> evaluate(const segment::SegmentReader& index, const query::Query& q) {
+    // Primero se buscan todos los términos en el diccionario: si alguno
+    // falta no se decodifica ninguna lista
+    std::vector<segment::PostingList> found;
+    for (const auto& term : q.terms) {
+        auto list = index.find(term);
+        if (!list) {
+            return {};
+        }
+        found.push_back(*list);
+    }
+
+    std::vector<std::vector<uint32_t>> termDocs(found.size());
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (size_t i = 0; i < found.size(); ++i) {
+        segment::decodeDocIds(found[i], termDocs[i]);
+        lists.push_back(&termDocs[i]);
+    }
+    // Intersección desde el término más raro
+    std::vector<uint32_t> resultDocs = postings::intersectAll(lists);
+
+    // Frases y proximidad: las posiciones de cada término se decodifican solo
+    // para los documentos que pasaron la intersección; el resto se salta
+    if (q.needsPositions() && index.hasPositions()) {
+        std::vector<segment::PositionCursor> cursors;
+        std::vector<size_t> next(found.size(), 0);
+        std::vector<std::vector<uint64_t>> positions(found.size());
+        for (const auto& list : found) cursors.emplace_back(list);
+
+        std::vector<uint32_t> matched;
+        for (uint32_t docId : resultDocs) {
+            std::vector<bool> loaded(found.size(), false);
+            auto positionsOf = [&](const std::string& term) -> const std::vector<uint64_t>& {
+                size_t t = std::find(q.terms.begin(), q.terms.end(), term) - q.terms.begin();
+                if (!loaded[t]) {
+                    // Índice del documento dentro de la lista del término (avanza siempre)
+                    const std::vector<uint32_t>& ids = termDocs[t];
+                    next[t] = std::lower_bound(ids.begin() + next[t], ids.end(), docId) - ids.begin();
+                    cursors[t].positionsAt(next[t], positions[t]);
+                    ++next[t];
+                    loaded[t] = true;
+                }
+                return positions[t];
+            };
+            if (query::matchClauses(q, positionsOf)) matched.push_back(docId);
+        }
+        resultDocs.swap(matched);
+    }
+
+    return resultDocs;
+}
+
+}  // namespace search
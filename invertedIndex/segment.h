@@ -0,0 +1,637 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../common/mapped_file.h"
+
+// Formato binario de un segmento del índice invertido posicional.
+//
+//   [Cabecera 64 bytes]
+//   [Postings]   listas de cada término, en el orden del diccionario
+//   [Diccionario] bloques de kDictBlock términos con front coding
+//   [Índice de bloques] u64 por bloque: offset del bloque en el archivo
+//   [Longitudes]  u64 total de tokens + u32 por documento (para BM25)
+//
+// Cada entrada del diccionario guarda df y el tamaño de su lista; el primer
+// término de cada bloque está completo y lleva el offset absoluto de su
+// lista. Buscar un término es una búsqueda binaria sobre los bloques y una
+// sola lectura de sus postings.
+//
+// Lista de postings de un término:
+//   varint bytes_docs, varint bytes_freqs, varint num_bloques
+//   tabla de bloques: por cada 128 postings el último docId, la cota
+//          máxima de BM25 (sin idf) y dónde empieza en docs y en freqs,
+//          para saltar bloques sin decodificarlos (block-max WAND)
+//   docs:  deltas de docId en bloques de 128 empaquetados a bits (FOR),
+//          el resto del último bloque como varints
+//   freqs: frecuencia - 1, mismo esquema
+//   posiciones: por documento varint bytes + deltas en varint
+//               (ausentes si la cabecera tiene kFlagNoPositions)
+namespace segment {
+
+constexpr char kMagic[8] = {'B', 'D', 'S', 'E', 'G', 0, 0, 1};
+constexpr uint32_t kVersion = 2;
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kDictBlock = 16;
+constexpr size_t kPackBlock = 128;
+
+// flags de la cabecera
+constexpr uint32_t kFlagNoPositions = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t numTerms;
+    uint64_t numDocs;
+    uint64_t dictOffset;
+    uint64_t blockIndexOffset;
+    uint64_t numBlocks;
+    uint64_t docLengthsOffset;
+};
+static_assert(sizeof(Header) == kHeaderSize, "cabecera de 64 bytes");
+
+// Parámetros de BM25
+constexpr double kBm25K1 = 1.2;
+constexpr double kBm25B = 0.75;
+
+// Parte de BM25 que depende del documento; el score es idf * bm25Tf
+inline double bm25Tf(uint32_t tf, uint32_t docLength, double avgDocLength) {
+    double norm = kBm25K1 * (1.0 - kBm25B + kBm25B * docLength / avgDocLength);
+    return tf * (kBm25K1 + 1.0) / (tf + norm);
+}
+
+inline double bm25Idf(uint64_t df, uint64_t numDocs) {
+    return std::log(1.0 + (numDocs - df + 0.5) / (df + 0.5));
+}
+
+// Entrada de la tabla de bloques de una lista
+struct BlockInfo {
+    uint32_t lastDocId;
+    float maxTf;           // cota superior de bm25Tf en el bloque
+    uint32_t docsOffset;   // desde el inicio de docs
+    uint32_t freqsOffset;  // desde el inicio de freqs
+};
+static_assert(sizeof(BlockInfo) == 16, "bloque de 16 bytes");
+
+// ---- Codificación de enteros ----
+
+inline void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+inline uint64_t getVarint(const char*& p) {
+    uint64_t v = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = uint8_t(*p++);
+        v |= uint64_t(b & 0x7F) << shift;
+        if (b < 0x80) return v;
+    }
+}
+
+inline void putU64(std::string& out, uint64_t v) { out.append(reinterpret_cast<const char*>(&v), 8); }
+
+inline uint64_t getU64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+// Empaqueta 128 valores con el ancho de bits del mayor (1 byte de ancho + 16 * bits bytes)
+inline void packBlock(std::string& out, const uint32_t* values) {
+    uint32_t maxValue = 0;
+    for (size_t i = 0; i < kPackBlock; ++i) maxValue |= values[i];
+    int bits = maxValue ? 32 - __builtin_clz(maxValue) : 0;
+    out += char(bits);
+    uint64_t acc = 0;
+    int filled = 0;
+    for (size_t i = 0; i < kPackBlock; ++i) {
+        acc |= uint64_t(values[i]) << filled;
+        filled += bits;
+        while (filled >= 8) {
+            out += char(acc & 0xFF);
+            acc >>= 8;
+            filled -= 8;
+        }
+    }
+}
+
+inline void unpackBlock(const char*& p, uint32_t* values) {
+    int bits = uint8_t(*p++);
+    uint64_t mask = bits == 32 ? 0xFFFFFFFFull : ((1ull << bits) - 1);
+    uint64_t acc = 0;
+    int filled = 0;
+    for (size_t i = 0; i < kPackBlock; ++i) {
+        while (filled < bits) {
+            acc |= uint64_t(uint8_t(*p++)) << filled;
+            filled += 8;
+        }
+        values[i] = uint32_t(acc & mask);
+        acc >>= bits;
+        filled -= bits;
+    }
+}
+
+// Decodifica un solo bloque de count valores (count < kPackBlock solo en el último)
+inline void decodeBlock(const char* p, size_t count, uint32_t* values) {
+    if (count == kPackBlock) {
+        unpackBlock(p, values);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) values[i] = uint32_t(getVarint(p));
+}
+
+inline void decodeInts(const char* p, size_t count, std::vector<uint32_t>& values) {
+    values.resize(count);
+    size_t i = 0;
+    for (; i + kPackBlock <= count; i += kPackBlock) unpackBlock(p, values.data() + i);
+    for (; i < count; ++i) values[i] = uint32_t(getVarint(p));
+}
+
+// ---- Escritura ----
+
+// Búfer de una sección de la lista que se está escribiendo. Guarda hasta
+// kSpillBytes en memoria y el resto lo pasa a un archivo temporal, así una
+// lista enorme no tiene que caber entera en RAM antes de escribirse.
+class SpillBuffer {
+public:
+    static constexpr size_t kSpillBytes = size_t(4) << 20;
+
+    SpillBuffer() = default;
+    SpillBuffer(const SpillBuffer&) = delete;
+    SpillBuffer& operator=(const SpillBuffer&) = delete;
+    ~SpillBuffer() {
+        if (file_.is_open()) {
+            file_.close();
+            std::remove(path_.c_str());
+        }
+    }
+
+    void setPath(std::string path) { path_ = std::move(path); }
+
+    std::string& bytes() { return buffer_; }
+    uint64_t size() const { return spilled_ + buffer_.size(); }
+
+    // Pasa el búfer al archivo temporal si ya es grande
+    bool spillIfFull() {
+        if (buffer_.size() < kSpillBytes) return true;
+        if (!file_.is_open()) {
+            file_.open(path_, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!file_.is_open()) return false;
+        }
+        file_.seekp(std::streamoff(spilled_));
+        file_.write(buffer_.data(), buffer_.size());
+        spilled_ += buffer_.size();
+        buffer_.clear();
+        return bool(file_);
+    }
+
+    // Copia todo el contenido a out y queda vacío para el siguiente término
+    bool copyTo(std::ofstream& out) {
+        if (spilled_ > 0) {
+            file_.flush();
+            file_.seekg(0);
+            std::string chunk(kSpillBytes, 0);
+            for (uint64_t left = spilled_; left > 0;) {
+                size_t n = size_t(std::min<uint64_t>(left, chunk.size()));
+                file_.read(chunk.data(), n);
+                if (!file_) return false;
+                out.write(chunk.data(), n);
+                left -= n;
+            }
+            spilled_ = 0;
+        }
+        out.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return bool(out);
+    }
+
+private:
+    std::string path_;
+    std::fstream file_;
+    std::string buffer_;
+    uint64_t spilled_ = 0;
+};
+
+// Escritor incremental: recibe los términos en orden creciente y sus
+// postings una a una (docId creciente). Codifica y suelta cada bloque de
+// kPackBlock postings en cuanto se llena; la cabecera y la tabla de bloques
+// de la lista se escriben al cerrar el término. Solo el diccionario (unos
+// bytes por término) se queda en memoria hasta finish().
+class SegmentWriter {
+public:
+    // docLengths[docId] es el número de tokens de cada documento
+    bool open(const std::string& path, std::vector<uint32_t> docLengths, bool withPositions = true) {
+        out_.open(path, std::ios::binary);
+        if (!out_.is_open()) return false;
+        blocks_.setPath(path + ".blocks.tmp");
+        docs_.setPath(path + ".docs.tmp");
+        freqs_.setPath(path + ".freqs.tmp");
+        positions_.setPath(path + ".positions.tmp");
+        docLengths_ = std::move(docLengths);
+        withPositions_ = withPositions;
+        uint64_t numDocs = docLengths_.size();
+        totalTokens_ = 0;
+        for (uint32_t length : docLengths_) totalTokens_ += length;
+        avgDocLength_ = numDocs ? std::max(1.0, double(totalTokens_) / numDocs) : 1.0;
+
+        header_ = Header{};
+        std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+        header_.version = kVersion;
+        header_.numDocs = numDocs;
+        header_.flags = withPositions ? 0 : kFlagNoPositions;
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        offset_ = kHeaderSize;
+        ok_ = bool(out_);
+        return ok_;
+    }
+
+    void beginTerm(std::string_view term) {
+        term_.assign(term);
+        df_ = 0;
+        prevDoc_ = 0;
+        blockCount_ = 0;
+        blockMaxTf_ = 0;
+    }
+
+    // Añade la posting de un documento al término actual
+    template <class Positions>
+    void addPosting(uint32_t docId, uint32_t frequency, const Positions& positions) {
+        deltas_[blockCount_] = uint32_t(docId - prevDoc_);
+        blockFreqs_[blockCount_] = frequency - 1;
+        prevDoc_ = docId;
+        uint32_t length = docId < docLengths_.size() ? docLengths_[docId] : 0;
+        blockMaxTf_ = std::max(blockMaxTf_, bm25Tf(frequency, length, avgDocLength_));
+        ++blockCount_;
+        ++df_;
+
+        if (withPositions_) {
+            entry_.clear();
+            uint64_t prevPos = 0;
+            for (auto pos : positions) {
+                putVarint(entry_, pos - prevPos);
+                prevPos = pos;
+            }
+            putVarint(positions_.bytes(), entry_.size());
+            positions_.bytes() += entry_;
+            ok_ = positions_.spillIfFull() && ok_;
+        }
+        if (blockCount_ == kPackBlock) flushBlock();
+    }
+
+    // Cierra el término actual: cabecera de la lista, tabla de bloques y secciones
+    void endTerm() {
+        if (blockCount_ > 0) flushBlock();
+        uint64_t numBlocks = blocks_.size() / sizeof(BlockInfo);
+        std::string head;
+        putVarint(head, docs_.size());
+        putVarint(head, freqs_.size());
+        putVarint(head, numBlocks);
+        uint64_t listSize = head.size() + blocks_.size() + docs_.size() + freqs_.size() + positions_.size();
+        out_.write(head.data(), head.size());
+        ok_ = blocks_.copyTo(out_) && ok_;
+        ok_ = docs_.copyTo(out_) && ok_;
+        ok_ = freqs_.copyTo(out_) && ok_;
+        ok_ = positions_.copyTo(out_) && ok_;
+
+        if (header_.numTerms % kDictBlock == 0) {
+            blockOffsets_.push_back(dict_.size());
+            putVarint(dict_, term_.size());
+            dict_ += term_;
+            putVarint(dict_, offset_);
+        } else {
+            size_t shared = 0;
+            size_t limit = std::min(prevTerm_.size(), term_.size());
+            while (shared < limit && prevTerm_[shared] == term_[shared]) ++shared;
+            putVarint(dict_, shared);
+            putVarint(dict_, term_.size() - shared);
+            dict_.append(term_, shared);
+        }
+        putVarint(dict_, df_);
+        putVarint(dict_, listSize);
+        offset_ += listSize;
+        prevTerm_.swap(term_);
+        header_.numTerms++;
+    }
+
+    // Término completo de una vez; Posting debe tener docId, frequency y
+    // positions, con las postings ordenadas por docId
+    template <class Posting>
+    void add(std::string_view term, const std::vector<Posting>& postings) {
+        beginTerm(term);
+        for (const auto& posting : postings) {
+            addPosting(uint32_t(posting.docId), uint32_t(posting.frequency), posting.positions);
+        }
+        endTerm();
+    }
+
+    // Escribe diccionario, índice de bloques y longitudes, y completa la cabecera
+    bool finish() {
+        std::string blockIndex;
+        header_.dictOffset = offset_;
+        out_.write(dict_.data(), dict_.size());
+        header_.blockIndexOffset = offset_ + dict_.size();
+        header_.numBlocks = blockOffsets_.size();
+        for (uint64_t blockOffset : blockOffsets_) putU64(blockIndex, header_.dictOffset + blockOffset);
+        out_.write(blockIndex.data(), blockIndex.size());
+
+        std::string lengths;
+        putU64(lengths, totalTokens_);
+        lengths.append(reinterpret_cast<const char*>(docLengths_.data()), docLengths_.size() * sizeof(uint32_t));
+        header_.docLengthsOffset = header_.blockIndexOffset + blockIndex.size();
+        out_.write(lengths.data(), lengths.size());
+
+        out_.seekp(0);
+        out_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+        out_.close();
+        return ok_ && bool(out_);
+    }
+
+private:
+    // Codifica el bloque pendiente: empaquetado si está lleno, varints si es
+    // la cola de la lista, con su entrada en la tabla de bloques
+    void flushBlock() {
+        // Redondeo hacia arriba para que siga siendo cota al pasar a float
+        BlockInfo info{prevDoc_, std::nextafter(float(blockMaxTf_), std::numeric_limits<float>::infinity()),
+                       uint32_t(docs_.size()), uint32_t(freqs_.size())};
+        blocks_.bytes().append(reinterpret_cast<const char*>(&info), sizeof(info));
+        if (blockCount_ == kPackBlock) {
+            packBlock(docs_.bytes(), deltas_);
+            packBlock(freqs_.bytes(), blockFreqs_);
+        } else {
+            for (size_t i = 0; i < blockCount_; ++i) putVarint(docs_.bytes(), deltas_[i]);
+            for (size_t i = 0; i < blockCount_; ++i) putVarint(freqs_.bytes(), blockFreqs_[i]);
+        }
+        ok_ = blocks_.spillIfFull() && docs_.spillIfFull() && freqs_.spillIfFull() && ok_;
+        blockCount_ = 0;
+        blockMaxTf_ = 0;
+    }
+
+    std::ofstream out_;
+    Header header_{};
+    std::vector<uint32_t> docLengths_;
+    uint64_t totalTokens_ = 0;
+    double avgDocLength_ = 1.0;
+    bool withPositions_ = true;
+    bool ok_ = true;
+    uint64_t offset_ = 0;
+    std::string dict_;
+    std::vector<uint64_t> blockOffsets_;
+    std::string prevTerm_;
+
+    // Término en curso
+    std::string term_;
+    uint64_t df_ = 0;
+    uint32_t prevDoc_ = 0;
+    uint32_t deltas_[kPackBlock];
+    uint32_t blockFreqs_[kPackBlock];
+    size_t blockCount_ = 0;
+    double blockMaxTf_ = 0;
+    std::string entry_;
+    SpillBuffer blocks_, docs_, freqs_, positions_;
+};
+
+// Escribe el índice (mapa término -> vector<Posting>) como segmento binario.
+// docLengths[docId] es el número de tokens de cada documento.
+template <class Index>
+bool writeSegment(const std::string& path, const Index& index,
+                  const std::vector<uint32_t>& docLengths, bool withPositions = true) {
+    SegmentWriter writer;
+    if (!writer.open(path, docLengths, withPositions)) return false;
+
+    std::vector<const typename Index::value_type*> terms;
+    terms.reserve(index.size());
+    for (const auto& entry : index) terms.push_back(&entry);
+    std::sort(terms.begin(), terms.end(),
+              [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    for (const auto* entry : terms) writer.add(entry->first, entry->second);
+    return writer.finish();
+}
+
+// ---- Lectura ----
+
+// Vista sobre la lista codificada de un término
+struct PostingList {
+    uint32_t df = 0;
+    std::string_view blocks;  // tabla de BlockInfo
+    std::string_view docs;
+    std::string_view freqs;
+    std::string_view positions;
+
+    size_t numBlocks() const { return blocks.size() / sizeof(BlockInfo); }
+    BlockInfo block(size_t b) const {
+        BlockInfo info;
+        std::memcpy(&info, blocks.data() + b * sizeof(BlockInfo), sizeof(info));
+        return info;
+    }
+};
+
+// docIds absolutos de la lista
+inline void decodeDocIds(const PostingList& list, std::vector<uint32_t>& docIds) {
+    decodeInts(list.docs.data(), list.df, docIds);
+    uint32_t doc = 0;
+    for (auto& d : docIds) {
+        doc += d;
+        d = doc;
+    }
+}
+
+inline void decodeFrequencies(const PostingList& list, std::vector<uint32_t>& freqs) {
+    decodeInts(list.freqs.data(), list.df, freqs);
+    for (auto& f : freqs) ++f;
+}
+
+// Recorre las posiciones documento por documento; solo decodifica las de
+// los documentos que se piden, los demás se saltan con su tamaño.
+class PositionCursor {
+public:
+    explicit PositionCursor(const PostingList& list) : p_(list.positions.data()) {}
+
+    // Posiciones del documento número `index` dentro de la lista (índices crecientes)
+    void positionsAt(size_t index, std::vector<uint64_t>& out) {
+        while (current_ < index) {
+            uint64_t bytes = getVarint(p_);
+            p_ += bytes;
+            ++current_;
+        }
+        out.clear();
+        uint64_t bytes = getVarint(p_);
+        const char* stop = p_ + bytes;
+        uint64_t pos = 0;
+        while (p_ < stop) {
+            pos += getVarint(p_);
+            out.push_back(pos);
+        }
+        ++current_;
+    }
+
+private:
+    const char* p_;
+    size_t current_ = 0;
+};
+
+// Lector de un segmento mapeado en memoria. No parsea nada al abrir: el
+// diccionario se consulta en el propio archivo.
+class SegmentReader {
+public:
+    bool open(const std::string& path) {
+        if (!file_.open(path) || file_.size() < kHeaderSize) return false;
+        std::memcpy(&header_, file_.data(), kHeaderSize);
+        if (std::memcmp(header_.magic, kMagic, sizeof(kMagic)) != 0 || header_.version != kVersion) {
+            file_.close();
+            return false;
+        }
+        return true;
+    }
+
+    const Header& header() const { return header_; }
+    uint64_t numTerms() const { return header_.numTerms; }
+    uint64_t numDocs() const { return header_.numDocs; }
+    bool hasPositions() const { return !(header_.flags & kFlagNoPositions); }
+    uint64_t fileSize() const { return file_.size(); }
+
+    uint32_t docLength(uint32_t docId) const {
+        uint32_t length;
+        std::memcpy(&length, file_.data() + header_.docLengthsOffset + 8 + size_t(docId) * 4, 4);
+        return length;
+    }
+    double avgDocLength() const {
+        uint64_t total = getU64(file_.data() + header_.docLengthsOffset);
+        return header_.numDocs ? std::max(1.0, double(total) / header_.numDocs) : 1.0;
+    }
+    std::vector<uint32_t> docLengths() const {
+        std::vector<uint32_t> lengths(header_.numDocs);
+        std::memcpy(lengths.data(), file_.data() + header_.docLengthsOffset + 8, lengths.size() * 4);
+        return lengths;
+    }
+
+    std::optional<PostingList> find(std::string_view term) const {
+        if (header_.numBlocks == 0) return std::nullopt;
+        // Último bloque cuyo primer término es <= term
+        size_t lo = 0, hi = header_.numBlocks;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (firstTerm(mid) <= term) lo = mid;
+            else hi = mid;
+        }
+
+        const char* p = file_.data() + blockOffset(lo);
+        std::string current;
+        uint64_t offset = 0;
+        size_t inBlock = std::min<uint64_t>(kDictBlock, header_.numTerms - lo * kDictBlock);
+        for (size_t i = 0; i < inBlock; ++i) {
+            if (i == 0) {
+                uint64_t len = getVarint(p);
+                current.assign(p, len);
+                p += len;
+                offset = getVarint(p);
+            } else {
+                uint64_t shared = getVarint(p);
+                uint64_t len = getVarint(p);
+                current.resize(shared);
+                current.append(p, len);
+                p += len;
+            }
+            uint64_t df = getVarint(p);
+            uint64_t size = getVarint(p);
+            if (current == term) return listAt(offset, df, size);
+            if (current > term) break;
+            offset += size;
+        }
+        return std::nullopt;
+    }
+
+    // Recorre el diccionario en orden sin callbacks (para mezclar segmentos)
+    class TermIterator {
+    public:
+        explicit TermIterator(const SegmentReader& reader)
+            : reader_(&reader), p_(reader.file_.data() + reader.header_.dictOffset) {}
+
+        // Avanza al siguiente término; false al terminar
+        bool next() {
+            if (index_ >= reader_->header_.numTerms) return false;
+            offset_ += size_;
+            if (index_ % kDictBlock == 0) {
+                uint64_t len = getVarint(p_);
+                current_.assign(p_, len);
+                p_ += len;
+                offset_ = getVarint(p_);
+            } else {
+                uint64_t shared = getVarint(p_);
+                uint64_t len = getVarint(p_);
+                current_.resize(shared);
+                current_.append(p_, len);
+                p_ += len;
+            }
+            df_ = getVarint(p_);
+            size_ = getVarint(p_);
+            ++index_;
+            return true;
+        }
+
+        std::string_view term() const { return current_; }
+        PostingList list() const { return reader_->listAt(offset_, df_, size_); }
+
+    private:
+        const SegmentReader* reader_;
+        const char* p_;
+        std::string current_;
+        uint64_t index_ = 0;
+        uint64_t offset_ = 0;
+        uint64_t df_ = 0;
+        uint64_t size_ = 0;
+    };
+
+    // Recorre todo el diccionario en orden: fn(term, PostingList)
+    template <class Fn>
+    void forEachTerm(Fn&& fn) const {
+        TermIterator it(*this);
+        while (it.next()) fn(it.term(), it.list());
+    }
+
+private:
+    uint64_t blockOffset(size_t block) const {
+        return getU64(file_.data() + header_.blockIndexOffset + block * 8);
+    }
+
+    std::string_view firstTerm(size_t block) const {
+        const char* p = file_.data() + blockOffset(block);
+        uint64_t len = getVarint(p);
+        return {p, len};
+    }
+
+    PostingList listAt(uint64_t offset, uint64_t df, uint64_t size) const {
+        const char* start = file_.data() + offset;
+        const char* p = start;
+        uint64_t docsBytes = getVarint(p);
+        uint64_t freqsBytes = getVarint(p);
+        uint64_t numBlocks = getVarint(p);
+        PostingList list;
+        list.df = uint32_t(df);
+        list.blocks = {p, numBlocks * sizeof(BlockInfo)};
+        p += list.blocks.size();
+        list.docs = {p, docsBytes};
+        list.freqs = {p + docsBytes, freqsBytes};
+        const char* positions = p + docsBytes + freqsBytes;
+        list.positions = {positions, size_t(start + size - positions)};
+        return list;
+    }
+
+    MappedFile file_;
+    Header header_{};
+};
+
+}  // namespace segment
@@ -0,0 +1,359 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "segment.h"
+
+// Construcción del índice en memoria externa (SPIMI: single-pass in-memory
+// indexing). Cada hilo llena su índice parcial hasta agotar su parte del
+// presupuesto de memoria y entonces lo vuelca ordenado a un run en disco.
+// Al final los runs se mezclan en streaming (k vías) directamente en el
+// segmento, documento a documento. Nunca hay más de kMergeFactor runs
+// abiertos (con más, pasadas intermedias los mezclan en runs mayores) y sus
+// búferes salen del presupuesto, así que la memoria máxima depende del
+// presupuesto y no del tamaño del corpus ni del término más frecuente.
+//
+// Formato de un run, términos en orden creciente:
+//   varint largo, término
+//   por posting (docId creciente, una por documento): varint docId + 1,
+//                varint frecuencia, frecuencia varints con los deltas de
+//                las posiciones
+//   varint 0 cierra la lista del término
+namespace spimi {
+
+struct Posting {
+    uint32_t docId;
+    uint32_t frequency;
+    std::vector<uint64_t> positions;
+};
+
+constexpr size_t kMergeFactor = 64;
+constexpr size_t kMinRunBuffer = size_t(64) << 10;
+constexpr size_t kMaxRunBuffer = size_t(1) << 20;
+
+// Búfer de lectura o escritura de cada run según el presupuesto: caben los
+// kMergeFactor lectores y el escritor de una pasada
+inline size_t runBufferBytes(size_t memoryBudget) {
+    return std::clamp(memoryBudget / (2 * (kMergeFactor + 1)), kMinRunBuffer, kMaxRunBuffer);
+}
+
+// Escribe un run término a término y posting a posting
+class RunWriter {
+public:
+    bool open(const std::string& path, size_t bufferBytes = kMaxRunBuffer) {
+        out_.open(path, std::ios::binary);
+        bufferBytes_ = bufferBytes;
+        return out_.is_open();
+    }
+
+    void beginTerm(std::string_view term) {
+        segment::putVarint(buffer_, term.size());
+        buffer_ += term;
+    }
+
+    template <class Positions>
+    void addPosting(uint32_t docId, uint32_t frequency, const Positions& positions) {
+        segment::putVarint(buffer_, uint64_t(docId) + 1);
+        segment::putVarint(buffer_, frequency);
+        uint64_t prev = 0;
+        for (auto pos : positions) {
+            segment::putVarint(buffer_, pos - prev);
+            prev = pos;
+        }
+        if (buffer_.size() >= bufferBytes_) flush();
+    }
+
+    void endTerm() { segment::putVarint(buffer_, 0); }
+
+    bool finish() {
+        flush();
+        out_.close();
+        return bool(out_);
+    }
+
+private:
+    void flush() {
+        out_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+    std::ofstream out_;
+    std::string buffer_;
+    size_t bufferBytes_ = kMaxRunBuffer;
+};
+
+// Vuelca un índice parcial (término -> vector<Posting>) a un run ordenado.
+// Las postings de cada término se ordenan por docId y las de un mismo
+// documento (rangos distintos del archivo, posiciones disjuntas) se unen.
+template <class Index>
+bool writeRun(const std::string& path, const Index& index) {
+    RunWriter out;
+    if (!out.open(path)) return false;
+
+    std::vector<const typename Index::value_type*> terms;
+    terms.reserve(index.size());
+    for (const auto& entry : index) terms.push_back(&entry);
+    std::sort(terms.begin(), terms.end(),
+              [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    using PostingType = typename Index::mapped_type::value_type;
+    std::vector<const PostingType*> sorted;
+    std::vector<uint64_t> positions;
+    for (const auto* entry : terms) {
+        sorted.clear();
+        for (const auto& posting : entry->second) sorted.push_back(&posting);
+        std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) {
+            return a->docId != b->docId ? a->docId < b->docId : a->positions.front() < b->positions.front();
+        });
+
+        out.beginTerm(entry->first);
+        for (size_t i = 0; i < sorted.size();) {
+            size_t end = i + 1;
+            while (end < sorted.size() && sorted[end]->docId == sorted[i]->docId) ++end;
+            if (end == i + 1) {
+                out.addPosting(uint32_t(sorted[i]->docId), uint32_t(sorted[i]->frequency), sorted[i]->positions);
+            } else {
+                uint64_t frequency = 0;
+                positions.clear();
+                for (size_t k = i; k < end; ++k) {
+                    frequency += sorted[k]->frequency;
+                    positions.insert(positions.end(), sorted[k]->positions.begin(), sorted[k]->positions.end());
+                }
+                out.addPosting(uint32_t(sorted[i]->docId), uint32_t(frequency), positions);
+            }
+            i = end;
+        }
+        out.endTerm();
+    }
+    return out.finish();
+}
+
+// Lee un run con un búfer fijo: primero el término, luego sus postings de
+// una en una, sin cargar la lista entera
+class RunReader {
+public:
+    bool open(const std::string& path, size_t bufferBytes = kMaxRunBuffer) {
+        in_.open(path, std::ios::binary);
+        buffer_.resize(bufferBytes);
+        return in_.is_open();
+    }
+
+    // Carga el siguiente término (las postings del anterior deben estar
+    // leídas); false al terminar el run o si está dañado
+    bool next() {
+        if (failed_) return false;
+        if (inTerm_ || !fill(1)) {
+            failed_ = inTerm_ || in_.bad();
+            return false;
+        }
+        std::string previous = std::move(term_);
+        term_.resize(readVarint());
+        for (auto& c : term_) c = readByte();
+        if (started_ && term_ <= previous) failed_ = true;
+        started_ = true;
+        inTerm_ = true;
+        hasPosting_ = false;
+        return !failed_;
+    }
+
+    // Carga la siguiente posting del término actual; false si no quedan o
+    // si el run está dañado
+    bool nextPosting() {
+        if (failed_ || !inTerm_) return false;
+        uint64_t docId = readVarint();
+        if (docId == 0) {
+            // Fin de la lista; un término sin postings es un run dañado
+            inTerm_ = false;
+            failed_ = !hasPosting_;
+            return false;
+        }
+        --docId;
+        uint64_t frequency = readVarint();
+        if (frequency == 0 || docId > UINT32_MAX || (hasPosting_ && docId <= posting_.docId)) failed_ = true;
+        posting_.docId = uint32_t(docId);
+        posting_.frequency = uint32_t(frequency);
+        posting_.positions.clear();
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < frequency && !failed_; ++i) {
+            pos += readVarint();
+            posting_.positions.push_back(pos);
+        }
+        hasPosting_ = true;
+        return !failed_;
+    }
+
+    // true si el run terminó antes de tiempo o tiene datos incoherentes
+    bool failed() const { return failed_; }
+
+    const std::string& term() const { return term_; }
+    const Posting& posting() const { return posting_; }
+
+private:
+    // Deja al menos `bytes` bytes en el búfer si el archivo los tiene
+    bool fill(size_t bytes) {
+        if (end_ - pos_ >= bytes) return true;
+        std::copy(buffer_.begin() + pos_, buffer_.begin() + end_, buffer_.begin());
+        end_ -= pos_;
+        pos_ = 0;
+        in_.read(buffer_.data() + end_, buffer_.size() - end_);
+        end_ += size_t(in_.gcount());
+        return end_ - pos_ >= bytes;
+    }
+
+    char readByte() {
+        if (!fill(1)) {
+            failed_ = true;
+            return 0;
+        }
+        return buffer_[pos_++];
+    }
+
+    uint64_t readVarint() {
+        uint64_t v = 0;
+        for (int shift = 0;; shift += 7) {
+            uint8_t byte = uint8_t(readByte());
+            v |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80) || shift >= 63) return v;
+        }
+    }
+
+    std::ifstream in_;
+    std::vector<char> buffer_;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    std::string term_;
+    bool inTerm_ = false;
+    bool started_ = false;
+    bool hasPosting_ = false;
+    bool failed_ = false;
+    Posting posting_;
+};
+
+// Mezcla de k vías de runs abiertos en writer (SegmentWriter o RunWriter).
+// Devuelve el número de términos, o -1 si algún run termina antes de tiempo.
+template <class Writer>
+int64_t mergeInto(std::vector<RunReader>& runs, Writer& writer) {
+    // Heap de runs por su término actual (el menor arriba)
+    auto greater = [&](size_t a, size_t b) { return runs[a].term() > runs[b].term(); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (runs[i].next()) heap.push(i);
+    }
+
+    // Heap de los runs del término actual por el docId de su posting
+    auto laterDoc = [&](size_t a, size_t b) { return runs[a].posting().docId > runs[b].posting().docId; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(laterDoc)> docs(laterDoc);
+
+    int64_t numTerms = 0;
+    std::string term;
+    std::vector<size_t> active;
+    std::vector<uint64_t> positions;
+    while (!heap.empty()) {
+        term = runs[heap.top()].term();
+        active.clear();
+        while (!heap.empty() && runs[heap.top()].term() == term) {
+            active.push_back(heap.top());
+            heap.pop();
+        }
+        for (size_t i : active) {
+            if (runs[i].nextPosting()) docs.push(i);
+        }
+
+        // Un documento por vuelta; si aparece en varios runs sus posiciones
+        // son disjuntas y se intercalan en orden
+        writer.beginTerm(term);
+        while (!docs.empty()) {
+            uint32_t docId = runs[docs.top()].posting().docId;
+            uint32_t frequency = 0;
+            positions.clear();
+            while (!docs.empty() && runs[docs.top()].posting().docId == docId) {
+                size_t i = docs.top();
+                docs.pop();
+                const Posting& posting = runs[i].posting();
+                size_t middle = positions.size();
+                frequency += posting.frequency;
+                positions.insert(positions.end(), posting.positions.begin(), posting.positions.end());
+                std::inplace_merge(positions.begin(), positions.begin() + middle, positions.end());
+                if (runs[i].nextPosting()) docs.push(i);
+            }
+            writer.addPosting(docId, frequency, positions);
+        }
+        writer.endTerm();
+        numTerms++;
+
+        for (size_t i : active) {
+            if (runs[i].next()) heap.push(i);
+        }
+    }
+    for (const auto& run : runs) {
+        if (run.failed()) return -1;
+    }
+    return numTerms;
+}
+
+inline bool openRuns(const std::vector<std::string>& paths, size_t bufferBytes, std::vector<RunReader>& runs) {
+    runs = std::vector<RunReader>(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!runs[i].open(paths[i], bufferBytes)) return false;
+    }
+    return true;
+}
+
+// Mezcla los runs en el segmento final con a lo sumo kMergeFactor abiertos
+// a la vez; memoryBudget fija el tamaño de sus búferes. Devuelve el número
+// de términos, o -1 si algún archivo no se pudo abrir o escribir o si algún
+// run termina antes de tiempo (entonces no deja el segmento).
+inline int64_t mergeRuns(const std::vector<std::string>& runPaths, const std::string& path,
+                         const std::vector<uint32_t>& docLengths, size_t memoryBudget) {
+    size_t bufferBytes = runBufferBytes(memoryBudget);
+    std::vector<std::string> pending = runPaths;
+    std::vector<std::string> intermediate;
+    auto cleanup = [&] {
+        for (const auto& run : intermediate) std::remove(run.c_str());
+    };
+
+    // Pasadas intermedias mientras haya más runs de los que se abren a la vez
+    std::vector<RunReader> runs;
+    while (pending.size() > kMergeFactor) {
+        std::vector<std::string> group(pending.begin(), pending.begin() + long(kMergeFactor));
+        pending.erase(pending.begin(), pending.begin() + long(kMergeFactor));
+        std::string passPath = path + ".pass" + std::to_string(intermediate.size());
+        intermediate.push_back(passPath);
+        pending.push_back(passPath);
+
+        RunWriter out;
+        bool ok = openRuns(group, bufferBytes, runs) && out.open(passPath, bufferBytes) &&
+                  mergeInto(runs, out) >= 0;
+        ok = out.finish() && ok;
+        runs.clear();
+        // Los runs intermedios ya mezclados se borran en seguida; los de
+        // entrada los borra quien los creó
+        for (const auto& run : group) {
+            if (std::find(intermediate.begin(), intermediate.end(), run) != intermediate.end()) {
+                std::remove(run.c_str());
+            }
+        }
+        if (!ok) {
+            cleanup();
+            return -1;
+        }
+    }
+
+    segment::SegmentWriter writer;
+    if (!openRuns(pending, bufferBytes, runs) || !writer.open(path, docLengths)) {
+        cleanup();
+        return -1;
+    }
+    int64_t numTerms = mergeInto(runs, writer);
+    bool ok = writer.finish() && numTerms >= 0;
+    cleanup();
+    if (!ok) std::remove(path.c_str());
+    return ok ? numTerms : -1;
+}
+
+}  // namespace spimi
@@ -1,10 +1,22 @@
 #include <bits/stdc++.h>
+#include <sys/resource.h>
+#include "../common/file_chunks.h"
+#include "../common/instrument.h"
+#include "../common/tokenizer.h"
+#include "../common/work_pool.h"
+#include "incremental.h"
+#include "postings.h"
+#include "query.h"
+#include "search.h"
+#include "segment.h"
+#include "spimi.h"
 namespace fs = std::filesystem;
 using namespace std;
 // Estructura que define un documento
 struct Document {
     string path;
     size_t id;
+    uint32_t length = 0;  // número de tokens, para BM25
 };
 
 // Estructura que almacena las apariciones de un término en un documento
@@ -20,112 +32,76 @@ using PartialIndex = unordered_map<string, vector<Posting>>;
 // Tipo para el índice invertido global
 using InvertedIndex = unordered_map<string, vector<Posting>>;
 
-// Mutex para proteger el acceso al índice global
-mutex indexMutex;
+// Listas ordenadas de docIds por término, usadas para intersectar en las búsquedas
+using DocIdLists = unordered_map<string, vector<uint32_t>>;
 
-// Lista global de documentos
+// Lista global de documentos (docs[docId])
 vector<Document> documents;
-mutex documentsMutex;
 
-// Contador global para asignar IDs a documentos
-atomic<size_t> nextDocId(0);
-
-// Argumentos para la función de los hilos trabajadores
-struct ThreadArgs {
-    vector<string> filePaths;
-    PartialIndex* partialIndex;
-    size_t threadId;
-};
-
-// Función para normalizar un término (convertir a minúsculas y eliminar signos de puntuación)
-string normalizeToken(const string& token) {
-    string normalized;
-    for (char c : token) {
-        if (isalnum(c)) {
-            normalized += tolower(c);
-        }
-    }
-    return normalized;
+// Función para leer un rango de un archivo, contando el tiempo y los bytes
+bool readChunk(const string& filePath, const FileChunk& chunk, string& text) {
+    instr::Scope read(instr::Stage::Read);
+    bool ok = read_chunk(filePath, chunk, text);
+    instr::add_bytes(text.size());
+    return ok;
 }
 
-// Función para tokenizar un texto en palabras
-vector<string> tokenize(const string& text) {
-    vector<string> tokens;
-    istringstream iss(text);
-    string token;
-    
-    while (iss >> token) {
-        token = normalizeToken(token);
-        if (!token.empty()) {
-            tokens.push_back(token);
-        }
+// Función para contar los tokens de un rango de un archivo (primera pasada)
+size_t countTokens(const string& filePath, const FileChunk& chunk) {
+    string text;
+    if (!readChunk(filePath, chunk, text)) {
+        cerr << "Error al leer archivo: " << filePath << endl;
     }
-    
-    return tokens;
+    instr::Scope tokenize(instr::Stage::Tokenize);
+    size_t count = 0;
+    tok::thread_tokenizer().for_each_word(text, [&](string_view) { count++; });
+    return count;
 }
 
-// Función para procesar un archivo y actualizar el índice parcial
-void processFile(const string& filePath, PartialIndex& partialIndex) {
-    ifstream file(filePath);
-    if (!file.is_open()) {
-        cerr << "Error al abrir archivo: " << filePath << endl;
-        return;
+// Función para procesar un rango de un archivo y actualizar el índice parcial.
+// firstPosition es el número de tokens del documento antes del rango, así
+// las posiciones son las mismas que si el archivo se leyera entero.
+// Devuelve una estimación de los bytes que el rango añadió al índice parcial.
+size_t processChunk(const string& filePath, const FileChunk& chunk, size_t docId,
+                  size_t firstPosition, PartialIndex& partialIndex) {
+    string text;
+    if (!readChunk(filePath, chunk, text)) {
+        cerr << "Error al leer archivo: " << filePath << endl;
     }
     
-    // Registrar documento y obtener ID
-    Document doc;
-    doc.path = filePath;
-    doc.id = nextDocId.fetch_add(1);
-    
-    {
-        lock_guard<mutex> lock(documentsMutex);
-        documents.push_back(doc);
-    }
+    size_t position = firstPosition;
     
-    // Leer archivo y construir índice
-    string line;
-    size_t position = 0;
-    
-    // Mapa temporal para este documento
+    // Mapa temporal para este rango
     unordered_map<string, Posting> docPostings;
     
-    while (getline(file, line)) {
-        vector<string> tokens = tokenize(line);
+    {
+        instr::Scope tokenize(instr::Stage::Tokenize);
+        tok::thread_tokenizer().for_each_word(text, [&](string_view word) {
+            string token(word);
         
-        for (const auto& token : tokens) {
-            if (token.empty()) continue;
-            
-            // Si es la primera aparición de este término en el documento, crear nueva posting
+            // Si es la primera aparición de este término en el rango, crear nueva posting
             if (docPostings.find(token) == docPostings.end()) {
-                docPostings[token] = Posting{doc.id, 1, {position}};
+                docPostings[token] = Posting{docId, 1, {position}};
             } else {
                 // Incrementar frecuencia y añadir posición
                 docPostings[token].frequency++;
                 docPostings[token].positions.push_back(position);
             }
-            
+        
             position++;
-        }
+        });
     }
     
-    // Actualizar el índice parcial con las apariciones en este documento
-    for (const auto& [term, posting] : docPostings) {
-        partialIndex[term].push_back(posting);
-    }
+    instr::add_tokens(position - firstPosition);
     
-    file.close();
-}
-
-// Función para el hilo trabajador
-void* workerThread(void* args) {
-    ThreadArgs* threadArgs = static_cast<ThreadArgs*>(args);
-    PartialIndex& partialIndex = *threadArgs->partialIndex;
-    
-    for (const auto& filePath : threadArgs->filePaths) {
-        processFile(filePath, partialIndex);
+    // Actualizar el índice parcial con las apariciones en este rango
+    instr::Scope insert(instr::Stage::Insert);
+    size_t bytes = 0;
+    for (auto& [term, posting] : docPostings) {
+        bytes += term.size() + sizeof(Posting) + 64 + posting.positions.size() * sizeof(size_t);
+        partialIndex[term].push_back(move(posting));
     }
-    
-    return nullptr;
+    return bytes;
 }
 
 // Función para obtener todos los archivos en un directorio y subdirectorios
@@ -139,6 +115,7 @@ void getFilesRecursively(const string& directory, vector<string>& files) {
 
 // Función para unir índices parciales en el índice global
 void mergePartialIndices(const vector<PartialIndex>& partialIndices, InvertedIndex& globalIndex) {
+    instr::Scope merge(instr::Stage::Merge);
     for (const auto& partialIndex : partialIndices) {
         for (const auto& [term, postings] : partialIndex) {
             // Añadir postings al índice global
@@ -148,15 +125,31 @@ void mergePartialIndices(const vector<PartialIndex>& partialIndices, InvertedInd
         }
     }
     
-    // Opcional: Ordenar las postings por docId para cada término
+    // Ordenar las postings por docId y unir las de un mismo documento que
+    // vienen de rangos distintos (sus posiciones no se solapan)
     for (auto& [term, postings] : globalIndex) {
-        sort(postings.begin(), postings.end(), 
-                 [](const Posting& a, const Posting& b) { return a.docId < b.docId; });
+        sort(postings.begin(), postings.end(), [](const Posting& a, const Posting& b) {
+            return a.docId != b.docId ? a.docId < b.docId : a.positions.front() < b.positions.front();
+        });
+        size_t out = 0;
+        for (size_t i = 0; i < postings.size(); ++i) {
+            if (out > 0 && postings[out - 1].docId == postings[i].docId) {
+                Posting& target = postings[out - 1];
+                target.frequency += postings[i].frequency;
+                target.positions.insert(target.positions.end(),
+                                        postings[i].positions.begin(), postings[i].positions.end());
+            } else {
+                if (out != i) postings[out] = move(postings[i]);
+                out++;
+            }
+        }
+        postings.resize(out);
     }
 }
 
-// Función para guardar el índice invertido en un archivo
+// Función para exportar el índice invertido como texto (opción --text)
 void saveInvertedIndex(const InvertedIndex& index, const string& outputFile) {
+    instr::Scope serialize(instr::Stage::Serialize);
     ofstream outFile(outputFile);
     if (!outFile.is_open()) {
         cerr << "Error al crear archivo de salida: " << outputFile << endl;
@@ -172,7 +165,7 @@ void saveInvertedIndex(const InvertedIndex& index, const string& outputFile) {
             }
             outFile << "| ";
         }
-        outFile << endl;
+        outFile << '\n';
     }
     
     outFile.close();
@@ -180,6 +173,7 @@ void saveInvertedIndex(const InvertedIndex& index, const string& outputFile) {
 
 // Función para guardar el mapeo de docId a ruta del archivo
 void saveDocumentMapping(const vector<Document>& docs, const string& outputFile) {
+    instr::Scope serialize(instr::Stage::Serialize);
     ofstream outFile(outputFile);
     if (!outFile.is_open()) {
         cerr << "Error al crear archivo de mapeo: " << outputFile << endl;
@@ -193,64 +187,317 @@ void saveDocumentMapping(const vector<Document>& docs, const string& outputFile)
     outFile.close();
 }
 
-// Función para buscar términos en el índice
-void searchIndex(const InvertedIndex& index, const vector<Document>& docs, const string& query) {
-    vector<string> queryTerms = tokenize(query);
-    
-    // Documentos que contienen todos los términos de la consulta
-    set<size_t> resultDocs;
-    bool firstTerm = true;
-    
-    for (const auto& term : queryTerms) {
-        if (index.find(term) == index.end()) {
-            // Si algún término no está en el índice, no hay resultados
-            resultDocs.clear();
-            break;
+// Función para extraer la lista ordenada de docIds de cada término (para las búsquedas)
+DocIdLists buildDocIdLists(const InvertedIndex& index) {
+    DocIdLists lists;
+    lists.reserve(index.size());
+    for (const auto& [term, postings] : index) {
+        vector<uint32_t>& ids = lists[term];
+        ids.reserve(postings.size());
+        for (const auto& posting : postings) {
+            ids.push_back(uint32_t(posting.docId));
         }
-        
-        // Conjunto de documentos que contienen este término
-        set<size_t> termDocs;
-        for (const auto& posting : index.at(term)) {
-            termDocs.insert(posting.docId);
+    }
+    return lists;
+}
+
+// Función para buscar en el índice: AND de términos, frases "..." y NEAR/k
+// docs debe estar ordenado por id (docs[docId])
+void searchIndex(const InvertedIndex& index, const DocIdLists& docIdLists,
+                 const vector<Document>& docs, const string& query) {
+    query::Query parsed = query::parse(query);
+    
+    // Listas de los términos; si alguno no está en el índice, no hay resultados
+    vector<const vector<uint32_t>*> lists;
+    for (const auto& term : parsed.terms) {
+        auto it = docIdLists.find(term);
+        if (it == docIdLists.end()) {
+            lists.clear();
+            break;
         }
-        
-        if (firstTerm) {
-            resultDocs = termDocs;
-            firstTerm = false;
-        } else {
-            // Intersección con términos anteriores
-            set<size_t> intersection;
-            set_intersection(
-                resultDocs.begin(), resultDocs.end(),
-                termDocs.begin(), termDocs.end(),
-                inserter(intersection, intersection.begin())
-            );
-            resultDocs = intersection;
+        lists.push_back(&it->second);
+    }
+    
+    // Documentos que contienen todos los términos de la consulta,
+    // intersectando desde el término más raro
+    vector<uint32_t> resultDocs = postings::intersectAll(lists);
+    
+    // Frases y proximidad: solo se miran las posiciones de los documentos
+    // que pasaron la intersección
+    if (parsed.needsPositions()) {
+        vector<uint32_t> matched;
+        for (uint32_t docId : resultDocs) {
+            auto positionsOf = [&](const string& term) -> const vector<size_t>& {
+                const vector<Posting>& termPostings = index.at(term);
+                auto it = lower_bound(termPostings.begin(), termPostings.end(), docId,
+                    [](const Posting& p, uint32_t id) { return p.docId < id; });
+                return it->positions;
+            };
+            if (query::matchClauses(parsed, positionsOf)) {
+                matched.push_back(docId);
+            }
         }
+        resultDocs.swap(matched);
     }
     
     // Mostrar resultados
     cout << "Resultados para: " << query << endl;
     cout << "Documentos encontrados: " << resultDocs.size() << endl;
     
-    for (size_t docId : resultDocs) {
-        for (const auto& doc : docs) {
-            if (doc.id == docId) {
-                cout << "- " << doc.path << endl;
-                break;
+    for (uint32_t docId : resultDocs) {
+        cout << "- " << docs[docId].path << endl;
+    }
+}
+
+// Función para buscar en el segmento ya escrito (modo --memoria, sin índice en RAM)
+void searchSegment(const segment::SegmentReader& index, const vector<Document>& docs, const string& query) {
+    vector<uint32_t> resultDocs = search::evaluate(index, query::parse(query));
+    
+    cout << "Resultados para: " << query << endl;
+    cout << "Documentos encontrados: " << resultDocs.size() << endl;
+    
+    for (uint32_t docId : resultDocs) {
+        cout << "- " << docs[docId].path << endl;
+    }
+}
+
+// Rangos y posiciones de una construcción
+struct BuildPlan {
+    vector<FileChunk> chunks;
+    vector<size_t> docOfFile;       // docId de cada archivo (SIZE_MAX si no se pudo abrir)
+    vector<size_t> firstPositions;  // posición del primer token de cada rango
+    vector<uint32_t> docLengths;
+};
+
+// Función para planear la construcción: rangos de ~32 MB cortados en
+// espacios (un archivo grande se reparte entre varios hilos), un documento
+// por archivo legible y primera pasada de conteo de tokens
+BuildPlan planBuild(const vector<string>& files, size_t numThreads, vector<Document>& docs) {
+    BuildPlan plan;
+    plan.chunks = plan_chunks(files);
+    const vector<FileChunk>& chunks = plan.chunks;
+    
+    // Ids densos en orden de archivo
+    plan.docOfFile.assign(files.size(), SIZE_MAX);
+    for (const auto& chunk : chunks) {
+        if (plan.docOfFile[chunk.file] != SIZE_MAX) continue;
+        plan.docOfFile[chunk.file] = docs.size();
+        docs.push_back(Document{files[chunk.file], docs.size()});
+    }
+    for (size_t f = 0; f < files.size(); f++) {
+        if (plan.docOfFile[f] == SIZE_MAX) cerr << "Error al abrir archivo: " << files[f] << endl;
+    }
+    
+    // Primera pasada: tokens por rango
+    vector<size_t> tokenCounts(chunks.size());
+    run_work_stealing(chunks.size(), numThreads, [&](size_t c, size_t) {
+        tokenCounts[c] = countTokens(files[chunks[c].file], chunks[c]);
+    });
+    
+    // Suma prefija por documento: posición del primer token de cada rango
+    plan.firstPositions.resize(chunks.size());
+    for (size_t c = 0; c < chunks.size(); c++) {
+        Document& doc = docs[plan.docOfFile[chunks[c].file]];
+        plan.firstPositions[c] = doc.length;
+        doc.length += uint32_t(tokenCounts[c]);
+    }
+    
+    plan.docLengths.resize(docs.size());
+    for (const auto& doc : docs) plan.docLengths[doc.id] = doc.length;
+    return plan;
+}
+
+// Función para construir el índice en memoria: segunda pasada con un índice
+// parcial por hilo (robo de trabajo entre hilos) y unión en el global
+void buildInMemory(const vector<string>& files, const BuildPlan& plan, size_t numThreads,
+                   InvertedIndex& globalIndex) {
+    const vector<FileChunk>& chunks = plan.chunks;
+    vector<PartialIndex> partialIndices(numThreads);
+    run_work_stealing(chunks.size(), numThreads, [&](size_t c, size_t worker) {
+        processChunk(files[chunks[c].file], chunks[c], plan.docOfFile[chunks[c].file],
+                     plan.firstPositions[c], partialIndices[worker]);
+    });
+    for (const auto& partialIndex : partialIndices) instr::add_unique_keys(partialIndex.size());
+    mergePartialIndices(partialIndices, globalIndex);
+}
+
+// Modo SPIMI: cada hilo vuelca su índice parcial a un run cuando supera su
+// parte del presupuesto y al final los runs se mezclan en el segmento.
+// Devuelve el número de términos, o -1 si hubo un error de E/S.
+int64_t buildWithRuns(const vector<string>& allFiles, const BuildPlan& plan,
+                      size_t numThreads, size_t memoryBudget) {
+    const vector<FileChunk>& chunks = plan.chunks;
+    size_t threadBudget = max<size_t>(1, memoryBudget / numThreads);
+    vector<PartialIndex> partialIndices(numThreads);
+    vector<size_t> partialBytes(numThreads, 0);
+    vector<string> runs;
+    mutex runsMutex;
+    atomic<bool> failed(false);
+    
+    auto flush = [&](size_t worker) {
+        string path;
+        {
+            auto lock = instr::timed_lock(runsMutex);
+            path = "inverted_index.run." + to_string(runs.size());
+            runs.push_back(path);
+        }
+        instr::add_unique_keys(partialIndices[worker].size());
+        instr::Scope serialize(instr::Stage::Serialize);
+        if (!spimi::writeRun(path, partialIndices[worker])) failed = true;
+        PartialIndex().swap(partialIndices[worker]);
+        partialBytes[worker] = 0;
+    };
+    
+    // El texto del rango que se va a leer cuenta en el presupuesto: si no
+    // cabe junto al índice parcial, este se vuelca antes de leerlo
+    run_work_stealing(chunks.size(), numThreads, [&](size_t c, size_t worker) {
+        size_t textBytes = chunks[c].end - chunks[c].begin;
+        if (!partialIndices[worker].empty() && partialBytes[worker] + textBytes >= threadBudget) flush(worker);
+        partialBytes[worker] += processChunk(allFiles[chunks[c].file], chunks[c], plan.docOfFile[chunks[c].file],
+                                             plan.firstPositions[c], partialIndices[worker]);
+        if (partialBytes[worker] >= threadBudget) flush(worker);
+    });
+    for (size_t worker = 0; worker < numThreads; worker++) {
+        if (!partialIndices[worker].empty()) flush(worker);
+    }
+    
+    cout << "Runs escritos: " << runs.size() << endl;
+    int64_t numTerms = -1;
+    if (!failed) {
+        instr::Scope merge(instr::Stage::Merge);
+        numTerms = spimi::mergeRuns(runs, "inverted_index.seg", plan.docLengths, memoryBudget);
+    }
+    for (const auto& path : runs) remove(path.c_str());
+    return numTerms;
+}
+
+// Modo incremental: indexa solo los archivos nuevos o cambiados en un
+// segmento nuevo, marca los borrados con tombstones y responde consultas
+// sobre todos los segmentos mientras un hilo los compacta en segundo plano
+int runIncremental(const string& dataDirectory, size_t numThreads) {
+    auto startTime = chrono::high_resolution_clock::now();
+    
+    incremental::Manifest manifest;
+    manifest.load(incremental::kManifestPath);
+    
+    vector<string> allFiles;
+    getFilesRecursively(dataDirectory, allFiles);
+    
+    unordered_map<string, size_t> known;
+    for (size_t i = 0; i < manifest.files.size(); i++) known[manifest.files[i].path] = i;
+    
+    // Tamaño y fecha deciden si hace falta leer el archivo; el hash evita
+    // reindexar archivos tocados pero iguales
+    vector<incremental::FileEntry> pending;
+    vector<size_t> removed;
+    unordered_set<string> present;
+    for (const auto& path : allFiles) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) continue;
+        present.insert(path);
+        incremental::FileEntry entry;
+        entry.path = path;
+        entry.size = uint64_t(st.st_size);
+        entry.mtime = incremental::modificationTime(st);
+        
+        auto it = known.find(path);
+        if (it != known.end()) {
+            incremental::FileEntry& old = manifest.files[it->second];
+            if (old.size == entry.size && old.mtime == entry.mtime) continue;
+            entry.hash = incremental::fileHash(path);
+            if (old.size == entry.size && old.hash == entry.hash) {
+                old.mtime = entry.mtime;
+                continue;
             }
+            removed.push_back(it->second);
+        } else {
+            entry.hash = incremental::fileHash(path);
+        }
+        pending.push_back(entry);
+    }
+    size_t numDeleted = 0;
+    for (size_t i = 0; i < manifest.files.size(); i++) {
+        if (!present.count(manifest.files[i].path)) {
+            removed.push_back(i);
+            numDeleted++;
+        }
+    }
+    sort(removed.rbegin(), removed.rend());
+    for (size_t i : removed) manifest.remove(i);
+    
+    if (!pending.empty()) {
+        vector<string> files;
+        for (const auto& entry : pending) files.push_back(entry.path);
+        vector<Document> docs;
+        BuildPlan plan = planBuild(files, numThreads, docs);
+        InvertedIndex index;
+        buildInMemory(files, plan, numThreads, index);
+        
+        string segmentPath = manifest.nextSegmentPath();
+        bool written;
+        {
+            instr::Scope serialize(instr::Stage::Serialize);
+            written = segment::writeSegment(segmentPath, index, plan.docLengths);
+        }
+        if (!written) {
+            cerr << "Error al crear archivo de salida: " << segmentPath << endl;
+            return 1;
         }
+        manifest.segments.push_back({segmentPath, uint32_t(docs.size()), {}});
+        for (size_t f = 0; f < pending.size(); f++) {
+            if (plan.docOfFile[f] == SIZE_MAX) continue;
+            pending[f].segment = segmentPath;
+            pending[f].docId = uint32_t(plan.docOfFile[f]);
+            manifest.files.push_back(pending[f]);
+        }
+    }
+    if (!manifest.save(incremental::kManifestPath)) {
+        cerr << "Error al guardar " << incremental::kManifestPath << endl;
+        return 1;
     }
+    
+    chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - startTime;
+    cout << "Indexación incremental completada en " << elapsed.count() << " segundos." << endl;
+    cout << "Archivos nuevos o modificados: " << pending.size() << endl;
+    cout << "Archivos borrados: " << numDeleted << endl;
+    cout << "Segmentos: " << manifest.segments.size() << endl;
+    
+    incremental::LiveIndex live(move(manifest), incremental::kManifestPath);
+    live.startMerges();
+    
+    string query;
+    cout << "Ingrese una consulta (o 'salir' para terminar): ";
+    while (getline(cin, query) && query != "salir") {
+        vector<string> results = live.search(query);
+        cout << "Resultados para: " << query << endl;
+        cout << "Documentos encontrados: " << results.size() << endl;
+        for (const auto& path : results) cout << "- " << path << endl;
+        cout << "\nIngrese una consulta (o 'salir' para terminar): ";
+    }
+    
+    live.waitMerges();
+    cout << "Segmentos tras la compactación: " << live.numSegments() << endl;
+    return 0;
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        cerr << "Uso: " << argv[0] << " <directorio_datos> <num_hilos>" << endl;
+        cerr << "Uso: " << argv[0] << " <directorio_datos> <num_hilos> [--text] [--memoria MB] [--incremental]" << endl;
         return 1;
     }
     
     string dataDirectory = argv[1];
     int numThreads = stoi(argv[2]);
+    bool exportText = false;
+    bool incrementalMode = false;
+    size_t memoryBudget = 0;  // bytes; 0 = todo el índice en memoria
+    for (int i = 3; i < argc; i++) {
+        string flag = argv[i];
+        if (flag == "--text") exportText = true;
+        else if (flag == "--memoria" && i + 1 < argc) memoryBudget = stoull(argv[++i]) << 20;
+        else if (flag == "--incremental") incrementalMode = true;
+    }
+    if (incrementalMode) return runIncremental(dataDirectory, max(1, numThreads));
     
     auto startTime = chrono::high_resolution_clock::now();
     
@@ -260,49 +507,42 @@ int main(int argc, char* argv[]) {
     
     cout << "Encontrados " << allFiles.size() << " archivos para indexar." << endl;
     
-    // Ajustar el número de hilos si hay menos archivos que hilos
-    numThreads = min(numThreads, static_cast<int>(allFiles.size()));
+    numThreads = max(1, numThreads);
+    BuildPlan plan = planBuild(allFiles, numThreads, documents);
     
-    // Distribuir archivos entre hilos
-    vector<ThreadArgs> threadArgs(numThreads);
-    vector<PartialIndex> partialIndices(numThreads);
-    
-    size_t filesPerThread = allFiles.size() / numThreads;
-    size_t remainingFiles = allFiles.size() % numThreads;
-    
-    size_t fileIndex = 0;
-    for (int i = 0; i < numThreads; i++) {
-        size_t numFilesForThisThread = filesPerThread + (i < remainingFiles ? 1 : 0);
+    if (memoryBudget > 0) {
+        int64_t numTerms = buildWithRuns(allFiles, plan, numThreads, memoryBudget);
+        if (numTerms < 0) {
+            cerr << "Error al escribir los runs o inverted_index.seg" << endl;
+            return 1;
+        }
+        chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - startTime;
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
         
-        threadArgs[i].threadId = i;
-        threadArgs[i].partialIndex = &partialIndices[i];
+        cout << "Indexación completada en " << elapsed.count() << " segundos." << endl;
+        cout << "Términos únicos: " << numTerms << endl;
+        cout << "Documentos procesados: " << documents.size() << endl;
+        cout << "Memoria máxima (RSS): " << usage.ru_maxrss / 1024 << " MB" << endl;
+        saveDocumentMapping(documents, "document_mapping.txt");
+        cout << "Índice guardado en inverted_index.seg" << endl;
+        if (exportText) cout << "--text no está disponible con --memoria" << endl;
+        cout << "Mapeo de documentos guardado en document_mapping.txt" << endl;
         
-        // Asignar archivos a este hilo
-        for (size_t j = 0; j < numFilesForThisThread; j++) {
-            if (fileIndex < allFiles.size()) {
-                threadArgs[i].filePaths.push_back(allFiles[fileIndex++]);
-            }
+        // Búsquedas directamente sobre el segmento
+        segment::SegmentReader index;
+        if (!index.open("inverted_index.seg")) return 1;
+        string query;
+        cout << "Ingrese una consulta (o 'salir' para terminar): ";
+        while (getline(cin, query) && query != "salir") {
+            searchSegment(index, documents, query);
+            cout << "\nIngrese una consulta (o 'salir' para terminar): ";
         }
+        return 0;
     }
     
-    // Crear los hilos
-    vector<pthread_t> threads(numThreads);
-    for (int i = 0; i < numThreads; i++) {
-        int rc = pthread_create(&threads[i], nullptr, workerThread, &threadArgs[i]);
-        if (rc) {
-            cerr << "Error al crear hilo: " << rc << endl;
-            return 1;
-        }
-    }
-    
-    // Esperar a que todos los hilos terminen
-    for (int i = 0; i < numThreads; i++) {
-        pthread_join(threads[i], nullptr);
-    }
-    
-    // Unir índices parciales en el índice global
     InvertedIndex globalIndex;
-    mergePartialIndices(partialIndices, globalIndex);
+    buildInMemory(allFiles, plan, numThreads, globalIndex);
     
     auto endTime = chrono::high_resolution_clock::now();
     chrono::duration<double> elapsed = endTime - startTime;
@@ -311,20 +551,32 @@ int main(int argc, char* argv[]) {
     cout << "Términos únicos: " << globalIndex.size() << endl;
     cout << "Documentos procesados: " << documents.size() << endl;
     
-    // Guardar el índice y mapeo de documentos
-    saveInvertedIndex(globalIndex, "inverted_index.idx");
+    // Guardar el índice (segmento binario) y mapeo de documentos
+    bool written;
+    {
+        instr::Scope serialize(instr::Stage::Serialize);
+        written = segment::writeSegment("inverted_index.seg", globalIndex, plan.docLengths);
+    }
+    if (!written) {
+        cerr << "Error al crear archivo de salida: inverted_index.seg" << endl;
+    }
     saveDocumentMapping(documents, "document_mapping.txt");
     
-    cout << "Índice guardado en inverted_index.idx" << endl;
+    cout << "Índice guardado en inverted_index.seg" << endl;
+    if (exportText) {
+        saveInvertedIndex(globalIndex, "inverted_index.idx");
+        cout << "Índice exportado como texto en inverted_index.idx" << endl;
+    }
     cout << "Mapeo de documentos guardado en document_mapping.txt" << endl;
     
     // Modo interactivo de búsqueda (opcional)
+    DocIdLists docIdLists = buildDocIdLists(globalIndex);
     string query;
     cout << "Ingrese una consulta (o 'salir' para terminar): ";
     getline(cin, query);
     
     while (query != "salir") {
-        searchIndex(globalIndex, documents, query);
+        searchIndex(globalIndex, docIdLists, documents, query);
         cout << "\nIngrese una consulta (o 'salir' para terminar): ";
         getline(cin, query);
     }
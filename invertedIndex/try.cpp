@@ -10,6 +10,7 @@
 #include <pthread.h>
 #include <mutex>
 #include <algorithm>
+#include "../common/instrument.h"
 
 using namespace std;
 
@@ -40,28 +41,37 @@ vector<string> tokenize(const string& line) {
 void* process_files(void* arg) {
     ThreadData* data = (ThreadData*)arg;
     unordered_map<string, unordered_set<string>> local_index;
+    uint64_t tokens = 0;
+
+    {
+        instr::Scope tokenize_scope(instr::Stage::Tokenize);
+        for (const auto& file : data->files) {
+            ifstream infile(file);
+            if (!infile.is_open()) {
+                cerr << "No se pudo abrir " << file << endl;
+                continue;
+            }
 
-    for (const auto& file : data->files) {
-        ifstream infile(file);
-        if (!infile.is_open()) {
-            cerr << "No se pudo abrir " << file << endl;
-            continue;
-        }
-
-        string line;
-        while (getline(infile, line)) {
-            vector<string> words = tokenize(line);
-            for (const string& word : words) {
-                if (!word.empty()) {
-                    local_index[word].insert(file);
+            string line;
+            while (getline(infile, line)) {
+                instr::add_bytes(line.size() + 1);
+                vector<string> words = tokenize(line);
+                for (const string& word : words) {
+                    if (!word.empty()) {
+                        local_index[word].insert(file);
+                        tokens++;
+                    }
                 }
             }
+            infile.close();
         }
-        infile.close();
     }
+    instr::add_tokens(tokens);
+    instr::add_unique_keys(local_index.size());
 
     // Combinar con índice global
-    lock_guard<mutex> lock(global_mutex);
+    auto lock = instr::timed_lock(global_mutex);
+    instr::Scope merge(instr::Stage::Merge);
     for (const auto& [word, files] : local_index) {
         global_index[word].insert(files.begin(), files.end());
     }
@@ -119,6 +129,7 @@ int main(int argc, char* argv[]) {
     }
 
     // Guardar índice invertido en archivo
+    instr::Scope serialize(instr::Stage::Serialize);
     ofstream out("indice_invertido.txt");
     for (const auto& [word, file_set] : global_index) {
         out << word << ": ";
@@ -0,0 +1,275 @@
+#include <bits/stdc++.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include "../common/map_reduce.h"
+#include "../common/tokenizer.h"
+using namespace std;
+using namespace chrono;
+
+// wordCount e invertedIndex como trabajos MapReduce de varios procesos
+// (common/map_reduce.h): un coordinador reparte trozos de la entrada a
+// procesos trabajadores, cada map combina y reparte sus pares por hash en
+// archivos ordenados y cada reduce los trae por socket y los mezcla.
+//
+//   mapReduce --trabajo wordcount|indice ENTRADA... [opciones]
+//     ENTRADA              archivos o directorios (de un directorio, sus .txt)
+//     --salida DIR         part-00000... (por defecto ./salida_mapreduce)
+//     --reductores R       particiones del shuffle (por defecto 4)
+//     --trabajadores W     procesos trabajadores locales (por defecto uno
+//                          por núcleo; 0 = solo los que se conecten)
+//     --trozo MB           bytes de entrada por tarea map
+//     --memoria MB         tabla del combinador antes de volcarla a disco
+//     --direccion D        dónde escucha el coordinador: unix:RUTA o
+//                          tcp:HOST:PUERTO para trabajadores de otras máquinas
+//     --temporal DIR       archivos intermedios
+//
+//   mapReduce --trabajador DIRECCION [--temporal DIR]
+//     un trabajador que se une al coordinador de DIRECCION
+//
+// Entre máquinas la entrada y --salida tienen que verse con la misma ruta
+// en todas (un sistema de archivos compartido); el shuffle va por sockets.
+
+// wordcount: (palabra, 1), el combinador suma
+struct WordCountJob {
+    using Input = uint64_t;
+    using Value = uint64_t;
+
+    template <class Emit>
+    void map(string_view text, uint32_t, Emit&& emit) const {
+        tok::thread_tokenizer().for_each_hashed_word(text, [&](string_view word, uint64_t hash) { emit(word, hash, 1); });
+    }
+    static Value make(Input n) { return n; }
+    static size_t accumulate(Value& count, Input n) {
+        count += n;
+        return 0;
+    }
+    static void combine(Value& count, Value&& other) { count += other; }
+    static size_t bytes(const Value&) { return 0; }
+    static void encode(const Value& count, string& out) { mr::put_varint(out, count); }
+    static Value decode(string_view in) {
+        uint64_t count = 0;
+        mr::get_varint(in, count);
+        return count;
+    }
+    void write(string_view word, const Value& count, string& out) const {
+        out.append(word).append("\t").append(to_string(count)).append("\n");
+    }
+};
+
+// indice: (término, docId) con docId = posición del archivo; el combinador
+// junta los docIds de un término en una lista ordenada sin repetidos. La
+// salida tiene el formato de indice_invertido.txt.
+struct IndexJob {
+    using Input = uint32_t;
+    using Value = vector<uint32_t>;
+
+    const vector<string>* files = nullptr;
+
+    template <class Emit>
+    void map(string_view text, uint32_t doc, Emit&& emit) const {
+        tok::thread_tokenizer().for_each_hashed_word(text, [&](string_view term, uint64_t hash) { emit(term, hash, doc); });
+    }
+    static Value make(Input doc) { return {doc}; }
+    // Un map lee un solo archivo: los docIds llegan en orden
+    static size_t accumulate(Value& docs, Input doc) {
+        if (docs.back() == doc) return 0;
+        docs.push_back(doc);
+        return sizeof(uint32_t);
+    }
+    static void combine(Value& docs, Value&& other) {
+        Value merged;
+        merged.reserve(docs.size() + other.size());
+        set_union(docs.begin(), docs.end(), other.begin(), other.end(), back_inserter(merged));
+        docs = move(merged);
+    }
+    static size_t bytes(const Value& docs) { return docs.capacity() * sizeof(uint32_t); }
+    // Diferencias con el docId anterior
+    static void encode(const Value& docs, string& out) {
+        uint32_t last = 0;
+        for (uint32_t doc : docs) {
+            mr::put_varint(out, doc - last);
+            last = doc;
+        }
+    }
+    static Value decode(string_view in) {
+        Value docs;
+        uint64_t delta;
+        uint32_t last = 0;
+        while (!in.empty() && mr::get_varint(in, delta)) docs.push_back(last += uint32_t(delta));
+        return docs;
+    }
+    void write(string_view term, const Value& docs, string& out) const {
+        out.append(term).append(": ");
+        for (uint32_t doc : docs) out.append((*files)[doc]).append(" ");
+        out.append("\n");
+    }
+};
+
+const set<string> kJobs = {"wordcount", "indice"};
+
+// Los .txt de un directorio, en el orden de readdir como invertedIndex
+vector<string> listTextFiles(const string& dirPath) {
+    vector<string> files;
+    DIR* dir = opendir(dirPath.c_str());
+    if (!dir) return files;
+    while (dirent* entry = readdir(dir)) {
+        string name = entry->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".txt") files.push_back(dirPath + "/" + name);
+    }
+    closedir(dir);
+    return files;
+}
+
+int runWorker(const string& address, const string& scratch) {
+    mr::Worker worker;
+    string error;
+    if (!worker.connect(address, scratch, error)) {
+        cerr << "Trabajador: " << error << endl;
+        return 1;
+    }
+    bool ok = false;
+    if (worker.job() == "wordcount") {
+        ok = worker.run(WordCountJob{});
+    } else if (worker.job() == "indice") {
+        IndexJob job;
+        job.files = &worker.files();
+        ok = worker.run(job);
+    } else {
+        cerr << "Trabajador: trabajo desconocido " << worker.job() << endl;
+        return 1;
+    }
+    return ok ? 0 : 1;
+}
+
+// Lanza un trabajador local: este mismo ejecutable con --trabajador. Con
+// BIGDATA_STATS o BIGDATA_TRACE cada uno escribe su propio archivo.
+pid_t spawnWorker(const string& address, const string& scratch, size_t n) {
+    pid_t pid = fork();
+    if (pid != 0) return pid;
+    for (const char* var : {"BIGDATA_STATS", "BIGDATA_TRACE"}) {
+        if (const char* path = getenv(var)) setenv(var, (string(path) + ".trabajador" + to_string(n)).c_str(), 1);
+    }
+    execl("/proc/self/exe", "mapReduce", "--trabajador", address.c_str(), "--temporal", scratch.c_str(), nullptr);
+    _exit(127);
+}
+
+void usage(const char* program) {
+    cerr << "Uso: " << program << " --trabajo wordcount|indice ENTRADA... [--salida DIR] [--reductores R]\n"
+         << "         [--trabajadores W] [--trozo MB] [--memoria MB] [--direccion unix:RUTA|tcp:HOST:PUERTO]\n"
+         << "         [--temporal DIR]\n"
+         << "     " << program << " --trabajador DIRECCION [--temporal DIR]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    // Un par que se cae no debe matar al proceso: write devuelve error
+    signal(SIGPIPE, SIG_IGN);
+
+    mr::JobSpec spec;
+    spec.output_dir = "salida_mapreduce";
+    size_t numWorkers = max(1u, thread::hardware_concurrency());
+    string address, workerOf, scratch;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            inputs.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--trabajo") spec.name = value;
+        else if (arg == "--salida") spec.output_dir = value;
+        else if (arg == "--reductores") spec.partitions = max(1ul, stoul(value));
+        else if (arg == "--trabajadores") numWorkers = stoul(value);
+        else if (arg == "--trozo") spec.chunk_bytes = max<uint64_t>(1, uint64_t(stod(value) * (1 << 20)));
+        else if (arg == "--memoria") spec.memory = uint64_t(stod(value) * (1 << 20));
+        else if (arg == "--direccion") address = value;
+        else if (arg == "--trabajador") workerOf = value;
+        else if (arg == "--temporal") scratch = value;
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!workerOf.empty()) return runWorker(workerOf, scratch.empty() ? filesystem::temp_directory_path().string() : scratch);
+
+    if (!kJobs.count(spec.name) || inputs.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    for (const string& input : inputs) {
+        if (filesystem::is_directory(input)) {
+            vector<string> files = listTextFiles(input);
+            spec.files.insert(spec.files.end(), files.begin(), files.end());
+        } else {
+            spec.files.push_back(input);
+        }
+    }
+    if (spec.files.empty()) {
+        cerr << "No hay archivos de entrada." << endl;
+        return 1;
+    }
+
+    error_code ec;
+    bool ownScratch = scratch.empty();
+    if (ownScratch) scratch = (filesystem::temp_directory_path() / ("mapreduce_" + to_string(getpid()))).string();
+    filesystem::create_directories(scratch, ec);
+    // Los part-* de una corrida anterior con más reductores confundirían
+    filesystem::create_directories(spec.output_dir, ec);
+    for (const auto& entry : filesystem::directory_iterator(spec.output_dir, ec)) {
+        if (entry.path().filename().string().rfind("part-", 0) == 0) filesystem::remove(entry.path(), ec);
+    }
+    if (ec) {
+        cerr << "No se pudo crear " << spec.output_dir << endl;
+        return 1;
+    }
+    if (address.empty()) address = "unix:" + scratch + "/coordinador.sock";
+
+    auto startTime = high_resolution_clock::now();
+    mr::Coordinator coordinator(spec);
+    if (!coordinator.listen(address)) {
+        cerr << "No se pudo escuchar en " << address << endl;
+        return 1;
+    }
+    if (numWorkers == 0) cerr << "Esperando trabajadores en " << coordinator.address() << endl;
+    vector<pid_t> workers;
+    for (size_t w = 0; w < numWorkers; ++w) workers.push_back(spawnWorker(coordinator.address(), scratch, w));
+
+    mr::Summary summary;
+    string error;
+    // Sin trabajadores locales vivos solo queda esperar a los remotos
+    size_t running = workers.size();
+    auto alive = [&] {
+        for (pid_t& pid : workers) {
+            if (pid > 0 && waitpid(pid, nullptr, WNOHANG) == pid) {
+                pid = -1;
+                --running;
+            }
+        }
+        return numWorkers == 0 || running > 0;
+    };
+    bool ok = coordinator.run(summary, error, alive);
+    for (pid_t pid : workers) {
+        if (pid <= 0) continue;
+        if (!ok) kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+    duration<double> elapsed = high_resolution_clock::now() - startTime;
+    if (ownScratch) filesystem::remove_all(scratch, ec);
+    if (!ok) {
+        cerr << "El trabajo falló: " << error << endl;
+        return 1;
+    }
+
+    cout << "Trabajo " << spec.name << " terminado en " << elapsed.count() << " segundos\n";
+    cout << "Trabajadores: " << summary.workers << ", tareas map: " << summary.map_tasks
+         << ", tareas reduce: " << summary.reduce_tasks << ", reintentos: " << summary.retries << "\n";
+    cout << "Volcados del combinador: " << summary.spills << ", pares tras combinar: " << summary.map_records << "\n";
+    cout << "Bytes del shuffle: " << summary.shuffle_bytes << "\n";
+    cout << "Claves en la salida: " << summary.output_records << " (en " << spec.output_dir << "/part-*)" << endl;
+    return 0;
+}
@@ -3,114 +3,233 @@
 #include <vector>
 #include <string>
 #include <random>
-#include <ctime>
 #include <chrono>
-#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../common/corpus.h"
+#include "../common/work_pool.h"
 using namespace std;
 using namespace chrono;
+
+// Deterministic corpus generator for wordCount and invertedIndex.
+//
+// Every file is cut into fixed-size blocks and each block is filled by its
+// own generator seeded from (seed, file, block), then written at its offset
+// with pwrite. Blocks are independent, so any number of threads produces the
+// same bytes for the same seed.
+//
+// With --files N the vocabulary is split like the old fileGen.py: a shared
+// fraction (--shared, 0.6 by default) appears in every file and the rest is
+// divided into exclusive slices, one per file.
+
+const size_t BLOCK_SIZE = 8 << 20;
+
+struct Options {
+    double sizeGB = 20;          // total size, split evenly between files
+    size_t numFiles = 0;         // 0 = a single file at `output`
+    string output = "random_words.txt";
+    string wordListFilename = "words.csv";
+    size_t syntheticWords = 0;   // > 0 = generated vocabulary instead of the csv
+    uint64_t seed = 42;
+    double zipf = 0;             // 0 = uniform, otherwise the Zipf exponent
+    double shared = 0.6;
+    size_t numThreads = max(1u, thread::hardware_concurrency());
+};
+
 vector<string> readWords(const string& csvFilename) {
     vector<string> words;
     ifstream file(csvFilename);
-    
+
     if (!file.is_open()) {
         cerr << "Error opening the file: " << csvFilename << endl;
         return {"the", "be", "to", "of", "and", "a", "in", "that", "have", "it", "for"};
-    } 
+    }
     string line;
     while (getline(file, line)) {
         // Trim whitespace
         line.erase(0, line.find_first_not_of(" \t\r\n"));
-        line.erase(line.find_last_not_of(" \t\r\n") + 1);    
+        line.erase(line.find_last_not_of(" \t\r\n") + 1);
         if (!line.empty()) {
             words.push_back(line);
         }
-    } 
-    file.close(); 
+    }
+    file.close();
     if (words.empty()) {
         cerr << "Empty csv file." << endl;
         return {"the", "be", "to", "of", "and", "a", "in", "that", "have", "it", "for"};
-    } 
+    }
     return words;
 }
 
-void generateRandomText(const string& filename, size_t targetSizeGB, const vector<string>& wordList) {
+// Vocabulary of each file: the shared words plus its exclusive slice, in a
+// seeded order (the order is the Zipf rank)
+vector<vector<string>> splitVocabulary(vector<string> words, const Options& options) {
+    size_t numFiles = max<size_t>(1, options.numFiles);
+    mt19937_64 gen(derive_seed(options.seed, ~0ull));
+    shuffle(words.begin(), words.end(), gen);
+    if (numFiles == 1) return {words};
+
+    size_t numShared = size_t(words.size() * options.shared);
+    size_t remaining = words.size() - numShared;
+    size_t chunkSize = (remaining + numFiles - 1) / numFiles;
+    vector<vector<string>> vocabularies(numFiles);
+    for (size_t f = 0; f < numFiles; ++f) {
+        auto& vocabulary = vocabularies[f];
+        vocabulary.assign(words.begin(), words.begin() + numShared);
+        size_t first = min(words.size(), numShared + f * chunkSize);
+        size_t last = min(words.size(), first + chunkSize);
+        vocabulary.insert(vocabulary.end(), words.begin() + first, words.begin() + last);
+        shuffle(vocabulary.begin(), vocabulary.end(), gen);
+    }
+    return vocabularies;
+}
+
+bool writeAll(int fd, const char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= size_t(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool generate(const Options& options, const vector<string>& paths, const vector<vector<string>>& vocabularies) {
     const size_t GB = 1024 * 1024 * 1024;
-    const size_t targetSizeBytes = targetSizeGB * GB;
-    // Output
-    ofstream outFile(filename, ios::binary);
-    if (!outFile) {
-        cerr << "Error opening output file: " << filename << endl;
-        return;
+    uint64_t totalBytes = uint64_t(options.sizeGB * GB);
+    uint64_t fileBytes = totalBytes / paths.size();
+
+    vector<int> fds;
+    vector<WordSampler> samplers;
+    for (size_t f = 0; f < paths.size(); ++f) {
+        int fd = open(paths[f].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ftruncate(fd, off_t(fileBytes)) != 0) {
+            cerr << "Error opening output file: " << paths[f] << " (" << strerror(errno) << ")" << endl;
+            for (int opened : fds) close(opened);
+            if (fd >= 0) close(fd);
+            return false;
+        }
+        fds.push_back(fd);
+        samplers.emplace_back(vocabularies[f].size(), options.zipf);
     }
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_int_distribution<> wordDist(0, wordList.size() - 1);
-    size_t bytesWritten = 0;
-    size_t lastReportedPercent = 0;
-    size_t reportInterval = GB / 10;
+
+    // One task per block of every file
+    uint64_t blocksPerFile = (fileBytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    atomic<uint64_t> bytesWritten{0};
+    atomic<bool> failed{false};
+    mutex reportMutex;
+    uint64_t reportInterval = max<uint64_t>(1, totalBytes / 100);
     auto startTime = high_resolution_clock::now();
-    const size_t bufferSize = 8192; // Buffer size for writing
-    string buffer;
-    buffer.reserve(bufferSize * 2);
-    
-    while (bytesWritten < targetSizeBytes) {
-        // Fill buffer with random words
-        buffer.clear();
-        while (buffer.size() < bufferSize && bytesWritten + buffer.size() < targetSizeBytes) {
-            string word = wordList[wordDist(gen)];
-            buffer += word + " "; 
-            // Occasionally add line breaks
-            if (gen() % 15 == 0) {
-                buffer += "\n";
-            }
+
+    run_work_stealing(paths.size() * blocksPerFile, options.numThreads, [&](size_t task, size_t) {
+        size_t file = task / blocksPerFile;
+        uint64_t block = task % blocksPerFile;
+        uint64_t offset = block * BLOCK_SIZE;
+        size_t size = size_t(min<uint64_t>(BLOCK_SIZE, fileBytes - offset));
+
+        thread_local vector<char> buffer(BLOCK_SIZE);
+        mt19937_64 gen(derive_seed(options.seed, task));
+        fill_block(buffer.data(), size, vocabularies[file], samplers[file], gen);
+        if (!writeAll(fds[file], buffer.data(), size, off_t(offset))) {
+            failed = true;
+            return;
         }
-        
-        // Write buffer to file
-        outFile.write(buffer.data(), buffer.size());
-        bytesWritten += buffer.size(); 
-        // Report progress
-        if (bytesWritten / reportInterval > lastReportedPercent) {
-            lastReportedPercent = bytesWritten / reportInterval;
-            auto currentTime = high_resolution_clock::now();
-            auto elapsed = duration_cast<seconds>(currentTime - startTime).count(); 
-            double percentComplete = (static_cast<double>(bytesWritten) / targetSizeBytes) * 100.0;
-            double mbWritten = bytesWritten / (1024.0 * 1024.0);
-            double mbPerSecond = elapsed > 0 ? mbWritten / elapsed : 0;
-            cout << "\rProgress: " << percentComplete << "% (" << mbWritten << " MB, " 
-                      << mbPerSecond << " MB/s)";
+
+        // Report progress every percent
+        uint64_t before = bytesWritten.fetch_add(size);
+        if ((before + size) / reportInterval > before / reportInterval) {
+            lock_guard<mutex> lock(reportMutex);
+            duration<double> elapsed = high_resolution_clock::now() - startTime;
+            double mbWritten = (before + size) / (1024.0 * 1024.0);
+            cout << "\rProgress: " << 100.0 * (before + size) / totalBytes << "% (" << mbWritten << " MB, "
+                 << (elapsed.count() > 0 ? mbWritten / elapsed.count() : 0) << " MB/s)";
             cout.flush();
         }
-    } 
-    outFile.close();
-    cout << "\nFile generation complete: " << filename << " (" << bytesWritten << " bytes)" << endl;
+    });
+
+    for (int fd : fds) close(fd);
+    cout << endl;
+    if (failed) {
+        cerr << "Error writing the output files" << endl;
+        return false;
+    }
+    return true;
+}
+
+void usage(const char* program) {
+    cerr << "Usage: " << program << " [--size GB] [--files N] [--output path] [--words words.csv]\n"
+         << "       [--synthetic WORDS] [--seed S] [--zipf EXPONENT] [--shared FRACTION] [--threads T]\n"
+         << "With --files N, --output is a directory that gets file_1.txt .. file_N.txt." << endl;
 }
+
 int main(int argc, char* argv[]) {
-    string outputFilename = "random_words.txt";
-    string wordListFilename = "words.csv";
-    size_t sizeGB = 20; 
-    // Parse command line arguments
-    if (argc >= 2) {
-        sizeGB = stoi(argv[1]); if (sizeGB > 9) {
-            cout << "Warning: Limiting size to 9 GB" << endl;
-            sizeGB = 9;
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        string flag = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        string value = argv[++i];
+        if (flag == "--size") options.sizeGB = stod(value);
+        else if (flag == "--files") options.numFiles = stoul(value);
+        else if (flag == "--output") options.output = value;
+        else if (flag == "--words") options.wordListFilename = value;
+        else if (flag == "--synthetic") options.syntheticWords = stoul(value);
+        else if (flag == "--seed") options.seed = stoull(value);
+        else if (flag == "--zipf") options.zipf = stod(value);
+        else if (flag == "--shared") options.shared = clamp(stod(value), 0.0, 1.0);
+        else if (flag == "--threads") options.numThreads = max(1ul, stoul(value));
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    vector<string> wordList = options.syntheticWords > 0
+                                  ? synthetic_vocabulary(options.syntheticWords, options.seed)
+                                  : readWords(options.wordListFilename);
+    vector<vector<string>> vocabularies = splitVocabulary(wordList, options);
+    for (const auto& vocabulary : vocabularies) {
+        if (vocabulary.empty()) {
+            cerr << "Fewer words than files: lower --files or raise --shared." << endl;
+            return 1;
+        }
+    }
+
+    vector<string> paths;
+    if (options.numFiles == 0) {
+        paths.push_back(options.output);
+    } else {
+        filesystem::create_directories(options.output);
+        for (size_t f = 0; f < options.numFiles; ++f) {
+            paths.push_back(options.output + "/file_" + to_string(f + 1) + ".txt");
         }
-    } 
-    if (argc >= 3) {
-        outputFilename = argv[2];
-    } 
-    if (argc >= 4) {
-        wordListFilename = argv[3];
-    } 
-    // Read words from CSV file
-    vector<string> wordList = readWords(wordListFilename); 
-    cout << "Generating " << sizeGB << " GB of random words to " << outputFilename << endl; 
-    // Record start time
-    auto startTime = high_resolution_clock::now(); 
-    // Generate the file
-    generateRandomText(outputFilename, sizeGB, wordList); 
-    // Calculate and display elapsed time
+    }
+
+    cout << "Generating " << options.sizeGB << " GB of random words in " << paths.size() << " file(s) at "
+         << options.output << " (seed " << options.seed << ", "
+         << (options.zipf > 0 ? "zipf " + to_string(options.zipf) : string("uniform")) << ", "
+         << options.numThreads << " threads)" << endl;
+    if (paths.size() > 1) {
+        cout << " -> Shared words: " << size_t(wordList.size() * options.shared) << " of " << wordList.size()
+             << endl;
+    }
+
+    auto startTime = high_resolution_clock::now();
+    if (!generate(options, paths, vocabularies)) return 1;
     auto endTime = high_resolution_clock::now();
-    auto elapsed = duration_cast<seconds>(endTime - startTime).count();
-    cout << "Time taken: " << elapsed << " seconds" << endl; 
+    duration<double> elapsed = endTime - startTime;
+    cout << "File generation complete: " << options.output << endl;
+    cout << "Time taken: " << elapsed.count() << " seconds" << endl;
     return 0;
 }
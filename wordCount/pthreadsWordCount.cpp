@@ -1,92 +1,220 @@
 #include <bits/stdc++.h>
+#include "../common/instrument.h"
+#include "../common/mapped_file.h"
+#include "../common/tokenizer.h"
+#include "../common/top_k.h"
+#include "../common/word_table.h"
 using namespace std;
 using namespace chrono;
-//  Sanitize - Lowercase/Pucntuation
-inline string clean_word(const string& word) {
-    string cleaned;
-    cleaned.reserve(word.length());
-    
-    for (char c : word) {
-        if (isalnum(c)) {
-            cleaned += tolower(c);
-        }
-    }
-    
-    return cleaned;
+
+// Flat table keyed by string_view; only words seen for the first time are
+// copied, into the arena of the thread that saw them
+using WordCounts = WordTable<uint64_t>;
+using WordCount = pair<string_view, uint64_t>;
+
+// Per-thread counts: one table per shard, all interning into the same arena.
+// A word always lands in shard_of(hash(word)).
+struct ShardedCounts {
+    Arena arena;
+    vector<WordCounts> shards;
+};
+
+inline size_t shard_of(uint64_t h, size_t num_shards) {
+    // Top bits, so the shard does not correlate with the table's probe start
+    return (h >> 48) % num_shards;
+}
+
+// Frequency descending, then word ascending
+inline bool by_frequency(const WordCount& a, const WordCount& b) {
+    return a.second > b.second || (a.second == b.second && a.first < b.first);
 }
-// Function to count words in a specific chunk of a file
+
+// Function to count words in a specific chunk of the mapped file.
+// The chunk boundaries are already snapped to whitespace, so every word
+// belongs to exactly one chunk. Counts are kept split by shard so no
+// other thread ever touches them.
 void count_words_in_chunk(
-    const string& filename,
-    streampos start_pos,
-    streampos end_pos,
-    unordered_map<string, size_t>& local_counts,
-    mutex& map_mutex
+    string_view chunk,
+    ShardedCounts& partials
 ) {
-    ifstream file(filename, ios::in);
-    if (!file) {
-        cerr << "Thread could not open file: " << filename << endl;
-        return;
+    size_t num_shards = partials.shards.size();
+    {
+        // Fault the chunk's pages in first so disk time is counted as read
+        instr::Scope read(instr::Stage::Read);
+        fault_in(chunk);
+        instr::add_bytes(chunk.size());
     }
+    instr::Scope tokenize(instr::Stage::Tokenize);
 
-    // Start file pointer
-    file.seekg(start_pos);
+    //  Sanitize - Lowercase/Pucntuation (shared tokenizer), hash computed once per token
+    tok::Tokenizer tokenizer;
+    uint64_t tokens = 0;
+    tokenizer.for_each_hashed_word(chunk, [&](string_view word, uint64_t hash) {
+        partials.shards[shard_of(hash, num_shards)].add_hashed(word, hash);
+        tokens++;
+    });
+    instr::add_tokens(tokens);
+    for (const auto& shard : partials.shards) instr::add_unique_keys(shard.size());
+}
 
-    // Manage partial words if not at the beginning
-    if (start_pos > 0) {
-        string partial_word;
-        file >> partial_word;
+// Approximate mode: Space-Saving summary of one chunk, fixed memory
+void summarize_chunk(string_view chunk, SpaceSaving& summary) {
+    {
+        instr::Scope read(instr::Stage::Read);
+        fault_in(chunk);
+        instr::add_bytes(chunk.size());
     }
+    instr::Scope tokenize(instr::Stage::Tokenize);
+    tok::Tokenizer tokenizer;
+    tokenizer.for_each_word(chunk, [&](string_view word) {
+        summary.add(word);
+    });
+    instr::add_tokens(summary.total());
+}
 
-    // Read and count words
-    string word;
-    unordered_map<string, size_t> thread_local_counts;
-    thread_local_counts.reserve(1000); // Pre-allocate space
+// Reduce shard `shard` of every thread's partials into one sorted vector.
+// Only the owner of the shard reads those tables, so no lock is needed.
+// The stored hashes are reused and keys are copied into merged's arena once.
+void reduce_shard(
+    size_t shard,
+    vector<ShardedCounts>& partials,
+    WordCounts& merged,
+    vector<WordCount>& out,
+    size_t top_k
+) {
+    instr::Scope merge(instr::Stage::Merge);
+    size_t largest = 0;
+    for (const auto& part : partials) largest = max(largest, part.shards[shard].size());
+    merged.reserve(largest);
+    for (const auto& part : partials) {
+        merged.merge(part.shards[shard]);
+    }
 
-    while (file >> word && file.tellg() <= end_pos) {
-        string cleaned = clean_word(word);
-        if (!cleaned.empty()) {
-            thread_local_counts[cleaned]++;
+    out.clear();
+    out.reserve(merged.size());
+    merged.for_each([&](string_view word, uint64_t count) {
+        out.emplace_back(word, count);
+    });
+    // With --top only this shard's K best can reach the final output
+    keep_top(out, top_k, by_frequency);
+}
+
+// Parallel k-way merge of the sorted shards. Splitters sampled from the
+// shards cut the output into num_parts ranges; each range is merged with a
+// heap by its own thread and written straight to its final offset.
+vector<WordCount> merge_sorted_shards(vector<vector<WordCount>>& shards, size_t num_parts) {
+    size_t total = 0;
+    for (const auto& shard : shards) total += shard.size();
+    vector<WordCount> merged(total);
+    if (total == 0) return merged;
+    num_parts = max<size_t>(1, min(num_parts, total));
+
+    // Regular sampling: num_parts samples per shard, pick num_parts - 1 splitters
+    vector<WordCount> samples;
+    for (const auto& shard : shards) {
+        for (size_t j = 1; j <= num_parts && !shard.empty(); ++j) {
+            samples.push_back(shard[(shard.size() * j) / (num_parts + 1)]);
         }
     }
+    sort(samples.begin(), samples.end(), by_frequency);
+    vector<WordCount> splitters;
+    for (size_t p = 1; p < num_parts; ++p) {
+        splitters.push_back(samples[samples.size() * p / num_parts]);
+    }
 
-    // If we're not at the end of the file, read the last partial word
-    if (file && file.tellg() < filesystem::file_size(filename)) {
-        file >> word;
-        string cleaned = clean_word(word);
-        if (!cleaned.empty()) {
-            thread_local_counts[cleaned]++;
+    // bounds[p][s] = first element of shard s that belongs to part p
+    vector<vector<size_t>> bounds(num_parts + 1, vector<size_t>(shards.size()));
+    for (size_t s = 0; s < shards.size(); ++s) {
+        bounds[0][s] = 0;
+        bounds[num_parts][s] = shards[s].size();
+        for (size_t p = 1; p < num_parts; ++p) {
+            bounds[p][s] = lower_bound(shards[s].begin(), shards[s].end(),
+                                       splitters[p - 1], by_frequency) - shards[s].begin();
         }
     }
 
-    // Merge local / Shared w mutex
-    {
-        lock_guard<mutex> lock(map_mutex);
-        for (const auto& [word, count] : thread_local_counts) {
-            local_counts[word] += count;
+    auto merge_part = [&](size_t p) {
+        instr::Scope merge(instr::Stage::Merge);
+        size_t out = 0;
+        for (size_t s = 0; s < shards.size(); ++s) out += bounds[p][s];
+
+        // Min-heap of (shard, cursor) ordered by the element under the cursor
+        vector<pair<size_t, size_t>> heap;
+        auto after = [&](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) {
+            return by_frequency(shards[b.first][b.second], shards[a.first][a.second]);
+        };
+        for (size_t s = 0; s < shards.size(); ++s) {
+            if (bounds[p][s] < bounds[p + 1][s]) heap.emplace_back(s, bounds[p][s]);
         }
+        make_heap(heap.begin(), heap.end(), after);
+        while (!heap.empty()) {
+            pop_heap(heap.begin(), heap.end(), after);
+            auto& [s, i] = heap.back();
+            merged[out++] = shards[s][i];
+            if (++i < bounds[p + 1][s]) {
+                push_heap(heap.begin(), heap.end(), after);
+            } else {
+                heap.pop_back();
+            }
+        }
+    };
+
+    vector<future<void>> futures;
+    for (size_t p = 0; p < num_parts; ++p) {
+        futures.push_back(async(launch::async, merge_part, p));
+    }
+    for (auto& future : futures) {
+        future.wait();
     }
+    return merged;
 }
 
 int main(int argc, char* argv[]) {
-    auto start_time = high_resolution_clock::now(); 
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <filename> [num_threads]" << endl;
+    auto usage = [&] {
+        cerr << "Usage: " << argv[0] << " <filename> [num_threads] [--top K] [--approx M]" << endl;
         return 1;
-    }
+    };
+
+    if (argc < 2) return usage();
     
     string filename = argv[1];
     
     // Determine thread number
     unsigned int num_threads = thread::hardware_concurrency();
-    if (argc >= 3) {
+    size_t top_k = 0;        // 0 = print every word
+    size_t approx_slots = 0; // 0 = exact counts
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--top" || arg == "--approx") {
+            if (i + 1 >= argc) {
+                cerr << "Missing value for " << arg << endl;
+                return usage();
+            }
+            try {
+                (arg == "--top" ? top_k : approx_slots) = stoul(argv[++i]);
+            } catch (const invalid_argument&) {
+                cerr << "Invalid value for " << arg << ": " << argv[i] << endl;
+                return usage();
+            } catch (const out_of_range&) {
+                cerr << "Value out of range for " << arg << ": " << argv[i] << endl;
+                return usage();
+            }
+            continue;
+        }
+        if (arg.size() > 1 && arg[0] == '-') {
+            cerr << "Unknown option: " << arg << endl;
+            return usage();
+        }
         try {
-            num_threads = stoi(argv[2]);
+            num_threads = stoi(arg);
             if (num_threads == 0) num_threads = 1;
         } catch (...) {
             cerr << "Not enough threads, using default: " << num_threads << endl;
         }
     }
     
+    auto start_time = high_resolution_clock::now();
+
     // Get file size
     filesystem::path file_path(filename);
     if (!filesystem::exists(file_path)) {
@@ -94,62 +222,118 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    uintmax_t file_size = filesystem::file_size(file_path);
+    MappedFile input;
+    {
+        instr::Scope read(instr::Stage::Read);
+        input.open(filename);
+    }
+    if (!input.is_open()) {
+        cerr << "Error: " << filename << endl;
+        return 1;
+    }
+    uintmax_t file_size = input.size();
     cout << "Procesando archivo: " << filename << " (" << file_size << " bytes)" << endl;
     cout << "Usando " << num_threads << " threads" << endl;
     
-    // Chunk size
-    streampos chunk_size = file_size / num_threads;
-    
-    // Shared ds
-    unordered_map<string, size_t> word_counts;
-    word_counts.reserve(10000);
-    mutex map_mutex;
+    // Chunk boundaries snapped to whitespace
+    vector<size_t> cuts = split_at_whitespace(input.view(), num_threads);
     
-    // Vector to hold all thread futures
     vector<future<void>> futures;
+
+    // Approximate streaming mode: one Space-Saving summary per thread, merged
+    // at the end. Memory is approx_slots counters per thread whatever the vocabulary.
+    if (approx_slots > 0) {
+        vector<SpaceSaving> summaries(num_threads, SpaceSaving(approx_slots));
+        for (unsigned int i = 0; i < num_threads; ++i) {
+            string_view chunk = input.view().substr(cuts[i], cuts[i + 1] - cuts[i]);
+            futures.push_back(async(launch::async, summarize_chunk, chunk, ref(summaries[i])));
+        }
+        for (auto& future : futures) {
+            future.wait();
+        }
+        {
+            instr::Scope merge(instr::Stage::Merge);
+            for (unsigned int i = 1; i < num_threads; ++i) {
+                summaries[0].merge(summaries[i]);
+            }
+        }
+
+        auto end_time = high_resolution_clock::now();
+        auto duration = duration_cast<milliseconds>(end_time - start_time);
+
+        instr::Scope serialize(instr::Stage::Serialize);
+        vector<SpaceSaving::Counter> counters = summaries[0].counters();
+        if (top_k > 0 && top_k < counters.size()) counters.resize(top_k);
+
+        cout << "Resultados aproximados (Space-Saving, " << approx_slots << " contadores):" << endl;
+        cout << "Word\t\tCount\t\tError" << endl;
+        cout << "------------------------" << endl;
+        for (const auto& c : counters) {
+            cout << c.word << "\t\t" << c.count << "\t\t" << c.error << endl;
+        }
+        cout << "\nPalabras procesadas: " << summaries[0].total() << endl;
+        cout << "Error maximo por palabra: " << summaries[0].max_error()
+             << " (count - error <= real <= count)" << endl;
+        cout << "Tiempo: " << duration.count() << " milisegundos" << endl;
+        return 0;
+    }
+
+    // One shard per thread; partials[t][s] is written only by thread t
+    // and read only by the owner of shard s
+    size_t num_shards = num_threads;
+    vector<ShardedCounts> partials(num_threads);
+    for (auto& part : partials) {
+        for (size_t s = 0; s < num_shards; ++s) {
+            part.shards.emplace_back(&part.arena);
+        }
+    }
     
     // Creating threads
     for (unsigned int i = 0; i < num_threads; ++i) {
-        streampos start_pos = i * chunk_size;
-        streampos end_pos = (i == num_threads - 1) ? streampos(file_size) : start_pos + chunk_size;
+        string_view chunk = input.view().substr(cuts[i], cuts[i + 1] - cuts[i]);
         
         futures.push_back(
             async(launch::async, 
                        count_words_in_chunk, 
-                       filename, 
-                       start_pos, 
-                       end_pos, 
-                       ref(word_counts), 
-                       ref(map_mutex))
+                       chunk, 
+                       ref(partials[i]))
         );
     }
     
+    for (auto& future : futures) {
+        future.wait();
+    }
+    futures.clear();
+
+    // Reduce every shard in parallel, each by its owner thread
+    vector<WordCounts> reduced(num_shards);
+    vector<vector<WordCount>> shards(num_shards);
+    for (size_t s = 0; s < num_shards; ++s) {
+        futures.push_back(
+            async(launch::async, reduce_shard, s, ref(partials), ref(reduced[s]), ref(shards[s]), top_k)
+        );
+    }
     for (auto& future : futures) {
         future.wait();
     }
      
     auto end_time = high_resolution_clock::now();
     auto duration = duration_cast<milliseconds>(end_time - start_time);
-    // ToVector
-    vector<pair<string, size_t>> sorted_counts(
-        word_counts.begin(), word_counts.end()
-    );
-    
-    // Sort
-    sort(sorted_counts.begin(), sorted_counts.end(),
-        [](const auto& a, const auto& b) {
-            return a.second > b.second || (a.second == b.second && a.first < b.first);
-        }
-    );
+
+    // Sort: parallel k-way merge of the sorted shards
+    size_t distinct = 0;
+    for (const auto& shard : reduced) distinct += shard.size();
+    vector<WordCount> sorted_counts = merge_sorted_shards(shards, num_threads);
+    if (top_k > 0 && top_k < sorted_counts.size()) sorted_counts.resize(top_k);
     
+    instr::Scope serialize(instr::Stage::Serialize);
     cout << "Resultados:" << endl;
     cout << "Word\t\tCount" << endl;
     cout << "------------------------" << endl; 
     for (const auto& [word, count] : sorted_counts) {
         cout << word << "\t\t" << count << endl;
     }
-    cout << "\nTotal de palabras distintas: " << word_counts.size() << endl;    
+    cout << "\nTotal de palabras distintas: " << distinct << endl;    
     cout << "Tiempo: " << duration.count() << " milisegundos" << endl; 
     return 0;
 }
@@ -1,70 +1,132 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <unordered_map>
 #include <algorithm>
 #include <cctype>
 #include <vector>
+#include <stdexcept>
 #include <chrono>
+#include "../common/instrument.h"
+#include "../common/mapped_file.h"
+#include "../common/tokenizer.h"
+#include "../common/top_k.h"
+#include "../common/word_table.h"
 using namespace std;
 using namespace chrono;
-// Helper function to clean a word (remove punctuation, convert to lowercase)
-string clean_word(const string& word) {
-    string cleaned;
-    cleaned.reserve(word.length());
+
+int main(int argc, char* argv[]) {
+    auto usage = [&] {
+        cerr << "Usage: " << argv[0] << " <filename> [--top K] [--approx M]" << endl;
+        return 1;
+    };
+
+    // Check if filename is provided
+    if (argc < 2) return usage();
     
-    for (char c : word) {
-        if (isalnum(c)) {
-            cleaned += tolower(c);
+    string filename = argv[1];
+    size_t top_k = 0;        // 0 = print every word
+    size_t approx_slots = 0; // 0 = exact counts
+    for (int i = 2; i < argc; i += 2) {
+        string option = argv[i];
+        if (option != "--top" && option != "--approx") {
+            cerr << "Unknown option: " << option << endl;
+            return usage();
+        }
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << option << endl;
+            return usage();
+        }
+        try {
+            (option == "--top" ? top_k : approx_slots) = stoul(argv[i + 1]);
+        } catch (const invalid_argument&) {
+            cerr << "Invalid value for " << option << ": " << argv[i + 1] << endl;
+            return usage();
+        } catch (const out_of_range&) {
+            cerr << "Value out of range for " << option << ": " << argv[i + 1] << endl;
+            return usage();
         }
     }
-    
-    return cleaned;
-}
 
-int main(int argc, char* argv[]) {
-    // Start timing
+    // Start timing once the arguments are parsed
     auto start_time = high_resolution_clock::now();
-    
-    // Check if filename is provided
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <filename>" << endl;
-        return 1;
+
+    // The pages are faulted in here so the read stage covers the disk I/O
+    MappedFile file;
+    {
+        instr::Scope read(instr::Stage::Read);
+        if (file.open(filename)) fault_in(file.view());
     }
     
-    string filename = argv[1];
-    ifstream file(filename);
-    
     if (!file.is_open()) {
         cerr << "Error: " << filename << endl;
         return 1;
     }
+    instr::add_bytes(file.size());
+
+    tok::Tokenizer tokenizer;
+
+    // Approximate streaming mode: fixed number of Space-Saving counters,
+    // memory does not grow with the vocabulary
+    if (approx_slots > 0) {
+        SpaceSaving summary(approx_slots);
+        {
+            instr::Scope tokenize(instr::Stage::Tokenize);
+            tokenizer.for_each_word(file.view(), [&](string_view word) {
+                summary.add(word);
+            });
+        }
+        instr::add_tokens(summary.total());
+
+        auto end_time = high_resolution_clock::now();
+        auto duration = duration_cast<milliseconds>(end_time - start_time);
+
+        instr::Scope serialize(instr::Stage::Serialize);
+        vector<SpaceSaving::Counter> counters = summary.counters();
+        if (top_k > 0 && top_k < counters.size()) counters.resize(top_k);
+
+        cout << "Resultados aproximados (Space-Saving, " << summary.capacity() << " contadores):" << endl;
+        cout << "Word\t\tCount\t\tError" << endl;
+        cout << "------------------------" << endl;
+        for (const auto& c : counters) {
+            cout << c.word << "\t\t" << c.count << "\t\t" << c.error << endl;
+        }
+        cout << "\nPalabras procesadas: " << summary.total() << endl;
+        cout << "Error maximo por palabra: " << summary.max_error()
+             << " (count - error <= real <= count)" << endl;
+        cout << "Tiempo de ejecucion: " << duration.count() << " milisegundos" << endl;
+        return 0;
+    }
     
-    // Use unordered_map for O(1) lookups and inserts
-    unordered_map<string, size_t> word_counts;
-    
-    // Reserve space to avoid rehashing (improves performance if we have a rough estimate)
-    word_counts.reserve(10000);
+    // Flat hash table; keys are copied into its arena only the first time they are seen
+    // and it grows without rehashing keys, so no size guess is needed
+    WordTable<size_t> word_counts;
     
-    string word;
-    // Read word by word
-    while (file >> word) {
-        string cleaned = clean_word(word);
-        if (!cleaned.empty()) {
-            word_counts[cleaned]++;
-        }
+    // Words come out of the shared tokenizer already lowercased, without punctuation and hashed
+    uint64_t tokens = 0;
+    {
+        instr::Scope tokenize(instr::Stage::Tokenize);
+        tokenizer.for_each_hashed_word(file.view(), [&](string_view word, uint64_t hash) {
+            word_counts.add_hashed(word, hash);
+            tokens++;
+        });
     }
+    instr::add_tokens(tokens);
+    instr::add_unique_keys(word_counts.size());
 
     auto end_time = high_resolution_clock::now();
     auto duration = duration_cast<milliseconds>(end_time - start_time);
 
+    instr::Scope serialize(instr::Stage::Serialize);
+
     // Convert to vector for sorting by frequency
-    vector<pair<string, size_t>> sorted_counts(
-        word_counts.begin(), word_counts.end()
-    );
+    vector<pair<string_view, size_t>> sorted_counts;
+    sorted_counts.reserve(word_counts.size());
+    word_counts.for_each([&](string_view word, size_t count) {
+        sorted_counts.emplace_back(word, count);
+    });
     
-    // Sort by frequency (descending)
-    sort(sorted_counts.begin(), sorted_counts.end(),
+    // Sort by frequency (descending); with --top only the first K are selected and sorted
+    keep_top(sorted_counts, top_k,
         [](const auto& a, const auto& b) {
             return a.second > b.second;
         }
@@ -86,4 +148,3 @@ int main(int argc, char* argv[]) {
     
     return 0;
 }
-